@@ -0,0 +1,132 @@
+// WebSocket 推播壓縮 Benchmark
+// 比較各代表性 payload 在 JSON 文字 / permessage-deflate / 二進位 / 二進位 + deflate(字典) 下的
+// 每則大小與編碼 CPU 時間 (不含網路)
+//
+//   lpsm_bench_compression [--json]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "server/WsProtocol.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Payload {
+    std::string name;
+    std::function<WsFrame()> make;
+};
+
+struct Result {
+    std::string name;
+    size_t text_bytes = 0, text_deflate_bytes = 0, bin_bytes = 0, bin_wire_bytes = 0;
+    double text_ns = 0, text_deflate_ns = 0, bin_ns = 0, bin_wire_ns = 0;
+};
+
+json offline_records(int n) {
+    json arr = json::array();
+    for (int i = 0; i < n; ++i) {
+        arr.push_back({
+            {"barcode", "42409" + std::to_string(12013144 + i)},
+            {"result", i % 17 == 0 ? "NG" : "OK"},
+            {"station", "10.8.32.64"},
+            {"work_order", "WO2410" + std::to_string(1000 + i / 50)},
+            {"timestamp", "2024-10-18T08:" + std::to_string(10 + i % 50) + ":00"},
+        });
+    }
+    return {{"type", "OFFLINE_CACHE_LOADED"}, {"data", arr}};
+}
+
+json panel_list(int n) {
+    json arr = json::array();
+    for (int i = 0; i < n; ++i) {
+        arr.push_back({{"panel", "P" + std::to_string(i + 1)}, {"model", "LPSM-A12"},
+                       {"status", i % 3 ? "DONE" : "WAIT"}, {"barcode", "42409120" + std::to_string(10000 + i)}});
+    }
+    return {{"type", "WORK_ORDER_PANELS"}, {"work_order", "WO24101001"}, {"panels", arr}};
+}
+
+// 每則 Frame 都重新建立 (避免量到快取)，建立成本不計入
+template <typename F>
+double time_per_frame(const Payload& p, int iterations, F&& encode) {
+    std::vector<WsFrame> frames;
+    frames.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        frames.push_back(p.make());
+        frames.back().set_seq((uint32_t)i + 1);
+    }
+    auto t0 = Clock::now();
+    size_t sink = 0;
+    for (auto& f : frames) sink += encode(f);
+    auto t1 = Clock::now();
+    if (sink == 0) std::puts("");
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+}
+
+Result run(const Payload& p) {
+    Result r;
+    r.name = p.name;
+
+    WsFrame sample = p.make();
+    sample.set_seq(1);
+    r.text_bytes = sample.text().size();
+    r.bin_bytes = sample.binary().size();
+    r.bin_wire_bytes = sample.binary_wire().size();
+    // COMPRESS_MIN_BYTES 以下 (或壓不下去) 實際上不壓縮，以原大小計
+    r.text_deflate_bytes = sample.text_wire().empty() ? r.text_bytes : sample.text_wire().size();
+
+    int iterations = (int)std::max<size_t>(50, 2000000 / std::max<size_t>(r.text_bytes, 1));
+    iterations = std::min(iterations, 20000);
+
+    r.text_ns = time_per_frame(p, iterations, [](WsFrame& f) { return f.text().size(); });
+    // permessage-deflate：WsServer 送出的 WsFrame::text_wire (每則 Frame 壓縮一次，所有文字 Client 共用)
+    r.text_deflate_ns = time_per_frame(p, iterations, [](WsFrame& f) {
+        return f.text_wire().empty() ? f.text().size() : f.text_wire().size();
+    });
+    r.bin_ns = time_per_frame(p, iterations, [](WsFrame& f) { return f.binary().size(); });
+    r.bin_wire_ns = time_per_frame(p, iterations, [](WsFrame& f) { return f.binary_wire().size(); });
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool as_json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    std::vector<Payload> payloads = {
+        {"plc_state", [] { return WsFrame::plc_state(Sources::PLC_MONITOR, 0x15); }},
+        {"barcode", [] { return WsFrame::data(Sources::id_of("CAMERA_LEFT_1"), "4240912013144"); }},
+        {"panel_list_50", [p = panel_list(50)] { return WsFrame::data(Sources::SYS, p); }},
+        {"offline_cache_200", [p = offline_records(200)] { return WsFrame::data(Sources::SYS, p); }},
+        {"offline_cache_2000", [p = offline_records(2000)] { return WsFrame::data(Sources::SYS, p); }},
+    };
+
+    std::vector<Result> results;
+    for (const auto& p : payloads) results.push_back(run(p));
+
+    if (as_json) {
+        json out = json::array();
+        for (const auto& r : results) {
+            out.push_back({{"payload", r.name},
+                           {"text_bytes", r.text_bytes}, {"text_deflate_bytes", r.text_deflate_bytes},
+                           {"bin_bytes", r.bin_bytes}, {"bin_wire_bytes", r.bin_wire_bytes},
+                           {"text_ns", r.text_ns}, {"text_deflate_ns", r.text_deflate_ns},
+                           {"bin_ns", r.bin_ns}, {"bin_wire_ns", r.bin_wire_ns}});
+        }
+        std::printf("%s\n", out.dump(2).c_str());
+        return 0;
+    }
+
+    std::printf("threshold: %zu bytes (smaller frames are sent uncompressed)\n\n", COMPRESS_MIN_BYTES);
+    std::printf("%-20s %10s %10s %10s %10s | %12s %12s %12s %12s\n", "payload",
+                "text B", "text+pmd B", "bin B", "bin+dfl B", "text ns", "text+pmd ns", "bin ns", "bin+dfl ns");
+    for (const auto& r : results) {
+        std::printf("%-20s %10zu %10zu %10zu %10zu | %12.0f %12.0f %12.0f %12.0f\n", r.name.c_str(),
+                    r.text_bytes, r.text_deflate_bytes, r.bin_bytes, r.bin_wire_bytes,
+                    r.text_ns, r.text_deflate_ns, r.bin_ns, r.bin_wire_ns);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,549 @@
+// Hub 熱路徑 Benchmark
+// 只使用與平台無關的 header，在 Linux 建置執行；每個案例輸出每次操作的 ns：
+//   bus.*      MessageBus 多生產者 push / Controller 執行緒 pop
+//   plc.*      Controller 處理 PLC 讀取結果 (Bit 解析 + 比對，狀態變更時推播)
+//   mc.*       MC Protocol 封包建立 / 讀取回應解析
+//   cam.*      相機條碼分框 (每個條碼)
+//   scanner.*  掃碼槍按鍵解碼 (每個按鍵事件)：掃碼槍連續輸入 / 人手打字
+//   history.*  訊號歷史記錄 (每次 PLC 讀取 / 相機條碼) 與 5 分鐘範圍查詢
+//   ws.*       推播封裝：JSON 文字 / 二進位 / 二進位 + deflate
+//   offline.*  離線快取附加 / 載入 (每筆)
+//
+//   lpsm_bench [--json] [--quick] [--repeat N] [--filter substr]
+//              [--baseline results.json] [--threshold 15]
+//   lpsm_bench --check-scanner
+//
+// --json 輸出可直接存成 baseline；--baseline 與其比較，任一案例變慢超過 threshold (%) 即回傳 1
+// --check-scanner 以合成按鍵序列驗證掃碼槍解碼結果 (不跑 Benchmark)，任一項不符即回傳 1
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/MessageBus.hpp"
+#include "driver/BarcodeFramer.hpp"
+#include "driver/McProtocol.hpp"
+#include "driver/ScannerDecoder.hpp"
+#include "logic/Controller.hpp"
+#include "logic/OfflineCache.hpp"
+#include "logic/SignalHistory.hpp"
+#include "server/WsProtocol.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 避免編譯器把結果未使用的計算整段移除
+volatile uint64_t g_sink = 0;
+
+struct Case {
+    std::string name;
+    bool full_only = false;            // --quick 時略過
+    std::function<double()> run;       // 回傳每次操作的 ns
+};
+
+struct Result {
+    std::string name;
+    double ns_per_op = 0;
+};
+
+double elapsed_ns(Clock::time_point t0, Clock::time_point t1) {
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+// PLC 讀取結果訊息 (逐一指定欄位，其餘成員維持預設值)
+Message plc_status(const json& payload) {
+    Message msg;
+    msg.source = Sources::PLC;
+    msg.type = MsgType::STATUS;
+    msg.payload = payload;
+    return msg;
+}
+
+// ---- Stub 輸出端 (只計數，不做 I/O) ----
+class NullPlc : public PlcSink {
+public:
+    uint64_t writes = 0;
+    void reset_safe_signals() override {}
+    void write_pulse_pair(int, bool, int, bool, uint64_t, WriteCallback on_done) override {
+        ++writes;
+        if (on_done) on_done({PlcWriteResult::OK});
+    }
+};
+
+class NullWs : public WsSink {
+public:
+    uint64_t published = 0;
+    void publish(std::string, WsFrame, const TraceStamps&, Delivery) override { ++published; }
+    void complete_request(std::string, json) override {}
+};
+
+// ---- MessageBus ----
+double bench_bus(int producers, int total) {
+    MessageBus bus;
+    int per_producer = total / producers;
+    int expected = per_producer * producers;
+    json payload = {{"raw", std::vector<uint8_t>(60, 0x11)}, {"start_addr", 500}};
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (int i = 0; i < per_producer; ++i) bus.push(plc_status(payload));
+        });
+    }
+    auto t0 = Clock::now();
+    go.store(true, std::memory_order_release);
+    Message msg;
+    for (int i = 0; i < expected; ++i) {
+        bus.pop(msg);
+        g_sink += msg.source;
+    }
+    auto t1 = Clock::now();
+    for (auto& t : threads) t.join();
+    return elapsed_ns(t0, t1) / expected;
+}
+
+// ---- Controller PLC 狀態 ----
+// changed = true：每筆輪流切換 up_in，都會推播；false：狀態不變，只做解析與比對
+double bench_plc_update(bool changed, int iterations) {
+    Config::publish(Config::AppConfig{});
+    const auto& pts = Config::get()->points;
+    int start_addr = (std::min({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start}) / 100) * 100;
+    int count = std::max({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start}) - start_addr + 20;
+
+    std::vector<uint8_t> off((count + 1) / 2, 0x00);
+    std::vector<uint8_t> on = off;
+    int offset = pts.up_in - start_addr;
+    on[offset / 2] |= (offset % 2 == 0) ? 0x10 : 0x01;
+    json payloads[2] = {{{"raw", off}, {"start_addr", start_addr}}, {{"raw", on}, {"start_addr", start_addr}}};
+
+    auto plc = std::make_shared<NullPlc>();
+    auto ws = std::make_shared<NullWs>();
+    std::string cache_file = "bench_offline_data.json";
+    Controller controller(std::make_shared<MessageBus>(), plc, ws, cache_file);
+
+    std::vector<Message> msgs;
+    msgs.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        msgs.push_back(plc_status(payloads[changed ? (i & 1) : 0]));
+    }
+    auto t0 = Clock::now();
+    for (auto& m : msgs) {
+        uint64_t now = trace_now_ns();
+        m.trace = TraceStamps{now, now, now, 0};
+        controller.process(m);
+    }
+    auto t1 = Clock::now();
+    g_sink += ws->published;
+    return elapsed_ns(t0, t1) / iterations;
+}
+
+// ---- MC Protocol ----
+double bench_mc_build(int iterations) {
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        auto read = McProtocol::build_read_packet(500 + (i & 7), 100);
+        auto write = McProtocol::build_write_packet(86, i & 1);
+        g_sink += read.size() + write.size();
+    }
+    return elapsed_ns(t0, Clock::now()) / iterations;
+}
+
+// 讀取回應：End Code 檢查 + 擷取資料區段 + 5 點 Bit 解析 (與 PlcClient / Controller 相同)
+double bench_mc_parse(int iterations) {
+    int count = 100;
+    std::vector<uint8_t> response(McProtocol::read_response_len(count), 0);
+    response[0] = 0xD0;
+    for (size_t i = McProtocol::RESPONSE_HEADER; i < response.size(); ++i) response[i] = (uint8_t)(i * 37);
+    const auto& pts = Config::get()->points;
+
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        if (McProtocol::end_code(response.data(), response.size()) != 0) continue;
+        std::vector<uint8_t> data(response.begin() + McProtocol::RESPONSE_HEADER, response.end());
+        int bits = 0;
+        for (int addr : {pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start}) {
+            bits = (bits << 1) | McProtocol::bit(data, 500, addr);
+        }
+        g_sink += bits;
+    }
+    return elapsed_ns(t0, Clock::now()) / iterations;
+}
+
+// ---- 相機條碼分框 ----
+// chunks 依序餵入；回傳每個條碼的 ns
+double bench_framing(const std::vector<std::string>& chunks, int rounds) {
+    BarcodeFramer framer;
+    uint64_t barcodes = 0;
+    auto t0 = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto& c : chunks) {
+            framer.feed(c.data(), c.size(), [&](std::string&& b) { barcodes += b.size() ? 1 : 0; });
+        }
+    }
+    auto t1 = Clock::now();
+    g_sink += barcodes;
+    return barcodes ? elapsed_ns(t0, t1) / barcodes : 0.0;
+}
+
+// ---- 掃碼槍按鍵解碼 ----
+// 合成按鍵序列：每個字元 down / up 各一筆，大寫字母前後加 Shift，最後 Enter
+std::vector<KeyEvent> key_stream(const std::string& text, uint64_t gap_ns, int repeat) {
+    std::vector<KeyEvent> events;
+    uint64_t t = 1000000000ULL;
+    for (int r = 0; r < repeat; ++r) {
+        for (char c : text) {
+            bool upper = c >= 'A' && c <= 'Z';
+            uint32_t vk = (c == '-') ? ScannerDecoder::KEY_MINUS : (uint32_t)c;
+            if (upper) events.push_back({ScannerDecoder::KEY_LSHIFT, 0, t, true});
+            events.push_back({vk, 0, t, true});
+            events.push_back({vk, 0, t + gap_ns / 2, false});
+            if (upper) events.push_back({ScannerDecoder::KEY_LSHIFT, 0, t + gap_ns / 2, false});
+            t += gap_ns;
+        }
+        events.push_back({ScannerDecoder::KEY_ENTER, 0, t, true});
+        t += gap_ns * 20;
+    }
+    return events;
+}
+
+double bench_scanner(const std::vector<KeyEvent>& events) {
+    ScannerDecoder decoder;
+    uint64_t chars = 0;
+    auto t0 = Clock::now();
+    for (const auto& ev : events) decoder.feed(ev, [&](ScannerDecoder::Result&& r) { chars += r.text.size(); });
+    auto t1 = Clock::now();
+    g_sink += chars;
+    return elapsed_ns(t0, t1) / events.size();
+}
+
+// 合成按鍵序列的解碼結果 (人手輸入是否送出由 KeyboardHook 依 LPSM_SCANNER_ACCEPT_TYPED 決定)
+bool check_scanner() {
+    struct Check {
+        const char* name;
+        std::vector<KeyEvent> events;
+        std::string expect_text; // 空字串 = 預期沒有結果
+        ScannerDecoder::Kind expect_kind;
+    };
+    const std::string code = "4240912013144";
+    std::vector<Check> checks;
+    checks.push_back({"burst (4 ms/key)", key_stream("Y04900132-" + code, 4000000ULL, 1), "Y04900132-" + code,
+                      ScannerDecoder::Kind::SCANNER});
+    checks.push_back({"typed (150 ms/key)", key_stream(code, 150000000ULL, 1), code, ScannerDecoder::Kind::TYPED});
+
+    // 人手打了 "ab" 沒按 Enter，800 ms 後掃碼：殘留內容丟棄，不黏到條碼前面
+    auto prefix = key_stream("ab", 100000000ULL, 1);
+    prefix.pop_back(); // 去掉 Enter
+    uint64_t t = prefix.back().t_ns + 800000000ULL;
+    for (auto ev : key_stream(code, 4000000ULL, 1)) {
+        ev.t_ns += t - 1000000000ULL;
+        prefix.push_back(ev);
+    }
+    checks.push_back({"stale prefix + burst", prefix, code, ScannerDecoder::Kind::SCANNER});
+
+    // 掃碼槍速度連續 200 個字元 (800 ms) 未按 Enter：整筆丟棄
+    checks.push_back({"overlong burst", key_stream(std::string(200, '7'), 4000000ULL, 1), "", ScannerDecoder::Kind::SCANNER});
+
+    bool ok = true;
+    for (const auto& c : checks) {
+        ScannerDecoder decoder;
+        std::vector<ScannerDecoder::Result> results;
+        for (const auto& ev : c.events) decoder.feed(ev, [&](ScannerDecoder::Result&& r) { results.push_back(std::move(r)); });
+        bool pass = c.expect_text.empty() ? results.empty()
+                                          : results.size() == 1 && results[0].text == c.expect_text && results[0].kind == c.expect_kind;
+        ok = ok && pass;
+        const auto& st = decoder.stats();
+        std::printf("%-24s %s  results=%zu", c.name, pass ? "PASS" : "FAIL", results.size());
+        if (!results.empty()) {
+            std::printf(" kind=%s text=%s", results[0].kind == ScannerDecoder::Kind::SCANNER ? "SCANNER" : "TYPED",
+                        results[0].text.c_str());
+        }
+        std::printf("  scans=%llu typed=%llu stale=%llu overlong=%llu\n", (unsigned long long)st.scans,
+                    (unsigned long long)st.typed, (unsigned long long)st.stale, (unsigned long long)st.overlong);
+    }
+    return ok;
+}
+
+// ---- 訊號歷史 ----
+// PLC 讀取 150 點 (10 個 Word)，每次讀取都有一個監看點位與一個 Word 變化
+double bench_history_plc(int iterations) {
+    SignalHistory history;
+    Config::PlcPoints pts;
+    std::vector<uint8_t> raw(75, 0);
+    uint64_t t = trace_now_ns();
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        raw[1] ^= 0x01; // M503 (up_in)
+        history.record_plc(raw, 500, pts, t);
+        t += 200000000ULL;
+    }
+    auto t1 = Clock::now();
+    g_sink += history.names().size();
+    return elapsed_ns(t0, t1) / iterations;
+}
+
+double bench_history_camera(int iterations) {
+    SignalHistory history;
+    SourceId cams[] = {Sources::id_of("CAMERA_LEFT_1"), Sources::id_of("CAMERA_RIGHT_1")};
+    const std::string code = "4240912013144";
+    uint64_t t = trace_now_ns();
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        history.record_camera(cams[i & 1], code, false, t);
+        t += 50000000ULL;
+    }
+    auto t1 = Clock::now();
+    g_sink += history.names().size();
+    return elapsed_ns(t0, t1) / iterations;
+}
+
+// 填滿 ring 後查詢最近 5 分鐘 (每次查詢)
+double bench_history_query(int iterations) {
+    SignalHistory history;
+    Config::PlcPoints pts;
+    std::vector<uint8_t> raw(75, 0);
+    SourceId cam = Sources::id_of("CAMERA_LEFT_1");
+    uint64_t t = trace_now_ns() - 20000ULL * 100000000ULL;
+    for (int i = 0; i < 20000; ++i) {
+        raw[1] ^= 0x01;
+        history.record_plc(raw, 500, pts, t);
+        if (i % 4 == 0) history.record_camera(cam, "4240912013144", false, t);
+        t += 100000000ULL;
+    }
+    int64_t now = history.now_ms();
+    auto t0 = Clock::now();
+    size_t bytes = 0;
+    for (int i = 0; i < iterations; ++i) bytes += history.query(now - 5 * 60 * 1000, now).size();
+    auto t1 = Clock::now();
+    g_sink += bytes;
+    return elapsed_ns(t0, t1) / iterations;
+}
+
+// ---- 推播封裝 ----
+json panel_list(int n) {
+    json arr = json::array();
+    for (int i = 0; i < n; ++i) {
+        arr.push_back({{"panel", "P" + std::to_string(i + 1)}, {"model", "LPSM-A12"},
+                       {"status", i % 3 ? "DONE" : "WAIT"}, {"barcode", "42409120" + std::to_string(10000 + i)}});
+    }
+    return {{"type", "WORK_ORDER_PANELS"}, {"work_order", "WO24101001"}, {"panels", arr}};
+}
+
+// 每則 Frame 都重新建立 (避免量到快取)，建立成本不計入
+template <typename Make, typename Encode>
+double bench_frame(Make&& make, Encode&& encode, int iterations) {
+    std::vector<WsFrame> frames;
+    frames.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        frames.push_back(make());
+        frames.back().set_seq((uint32_t)i + 1);
+    }
+    auto t0 = Clock::now();
+    size_t bytes = 0;
+    for (auto& f : frames) bytes += encode(f);
+    auto t1 = Clock::now();
+    g_sink += bytes;
+    return elapsed_ns(t0, t1) / iterations;
+}
+
+// ---- 離線快取 ----
+json offline_record(int i) {
+    return {{"barcode", "42409" + std::to_string(12013144 + i)}, {"result", i % 17 == 0 ? "NG" : "OK"},
+            {"station", "10.8.32.64"}, {"work_order", "WO2410" + std::to_string(1000 + i / 50)},
+            {"timestamp", "2024-10-18T08:" + std::to_string(10 + i % 50) + ":00"}};
+}
+
+const char* OFFLINE_BENCH_FILE = "bench_offline_cache.jsonl";
+
+double bench_offline_append(int records) {
+    OfflineCache cache(OFFLINE_BENCH_FILE);
+    cache.clear();
+    std::vector<json> items;
+    items.reserve(records);
+    for (int i = 0; i < records; ++i) items.push_back(offline_record(i));
+    auto t0 = Clock::now();
+    for (const auto& item : items) cache.append(item);
+    return elapsed_ns(t0, Clock::now()) / records;
+}
+
+double bench_offline_load(int records) {
+    OfflineCache cache(OFFLINE_BENCH_FILE);
+    {
+        // 直接一次寫入，準備時間不計
+        std::ofstream o(OFFLINE_BENCH_FILE, std::ios::trunc);
+        for (int i = 0; i < records; ++i) o << offline_record(i).dump(-1) << "\n";
+    }
+    auto t0 = Clock::now();
+    json loaded = cache.load();
+    auto t1 = Clock::now();
+    g_sink += loaded.size();
+    return elapsed_ns(t0, t1) / std::max<size_t>(loaded.size(), 1);
+}
+
+std::vector<Case> make_cases(bool quick) {
+    int scale = quick ? 10 : 1;
+    std::vector<Case> cases;
+
+    for (int producers : {1, 2, 4}) {
+        cases.push_back({"bus.push_pop.p" + std::to_string(producers), false,
+                         [=] { return bench_bus(producers, 400000 / scale); }});
+    }
+
+    cases.push_back({"plc.update.unchanged", false, [=] { return bench_plc_update(false, 200000 / scale); }});
+    cases.push_back({"plc.update.changed", false, [=] { return bench_plc_update(true, 200000 / scale); }});
+
+    cases.push_back({"mc.build.read_write", false, [=] { return bench_mc_build(1000000 / scale); }});
+    cases.push_back({"mc.parse.read_response", false, [=] { return bench_mc_parse(1000000 / scale); }});
+
+    const std::string code = "4240912013144";
+    cases.push_back({"cam.frame.single", false, [=] { return bench_framing({code + "\r\n"}, 500000 / scale); }});
+    cases.push_back({"cam.frame.split", false,
+                     [=] { return bench_framing({code.substr(0, 5), code.substr(5) + "\r\n"}, 500000 / scale); }});
+    std::string batch;
+    for (int i = 0; i < 8; ++i) batch += code + "\r\n";
+    cases.push_back({"cam.frame.batch8", false, [=] { return bench_framing({batch}, 100000 / scale); }});
+
+    auto burst = std::make_shared<std::vector<KeyEvent>>(key_stream("Y04900132-4240912013144", 4000000ULL, 20000 / scale));
+    auto typed = std::make_shared<std::vector<KeyEvent>>(key_stream("WO24101001", 150000000ULL, 20000 / scale));
+    cases.push_back({"scanner.decode.burst", false, [=] { return bench_scanner(*burst); }});
+    cases.push_back({"scanner.decode.typed", false, [=] { return bench_scanner(*typed); }});
+
+    cases.push_back({"history.record.plc", false, [=] { return bench_history_plc(200000 / scale); }});
+    cases.push_back({"history.record.camera", false, [=] { return bench_history_camera(500000 / scale); }});
+    cases.push_back({"history.query.5min", false, [=] { return bench_history_query(std::max(10, 200 / scale)); }});
+
+    struct Payload {
+        std::string name;
+        std::function<WsFrame()> make;
+        int iterations;
+    };
+    std::vector<Payload> payloads = {
+        {"plc_state", [] { return WsFrame::plc_state(Sources::PLC_MONITOR, 0x15); }, 200000},
+        {"barcode", [] { return WsFrame::data(Sources::id_of("CAMERA_LEFT_1"), "4240912013144"); }, 200000},
+        {"panel_list_50", [p = panel_list(50)] { return WsFrame::data(Sources::SYS, p); }, 5000},
+    };
+    for (const auto& p : payloads) {
+        int n = std::max(100, p.iterations / scale);
+        cases.push_back({"ws." + p.name + ".text", false,
+                         [=] { return bench_frame(p.make, [](WsFrame& f) { return f.text().size(); }, n); }});
+        cases.push_back({"ws." + p.name + ".binary", false,
+                         [=] { return bench_frame(p.make, [](WsFrame& f) { return f.binary().size(); }, n); }});
+        cases.push_back({"ws." + p.name + ".binary_wire", false,
+                         [=] { return bench_frame(p.make, [](WsFrame& f) { return f.binary_wire().size(); }, n); }});
+    }
+
+    for (int records : {10000, 100000, 1000000}) {
+        std::string label = records >= 1000000 ? std::to_string(records / 1000000) + "m"
+                                                : std::to_string(records / 1000) + "k";
+        bool full_only = records > 100000;
+        cases.push_back({"offline.append." + label, full_only, [=] { return bench_offline_append(records); }});
+        cases.push_back({"offline.load." + label, full_only, [=] { return bench_offline_load(records); }});
+    }
+    return cases;
+}
+
+struct Options {
+    bool as_json = false;
+    bool quick = false;
+    int repeat = 3;
+    double threshold = 15.0;
+    std::string filter;
+    std::string baseline;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) opt.as_json = true;
+        else if (std::strcmp(argv[i], "--quick") == 0) opt.quick = true;
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) opt.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) opt.threshold = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) opt.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) opt.baseline = argv[++i];
+        else if (std::strcmp(argv[i], "--check-scanner") == 0) return check_scanner() ? 0 : 1;
+        else {
+            std::fprintf(stderr, "usage: lpsm_bench [--json] [--quick] [--repeat N] [--filter substr] "
+                                 "[--baseline results.json] [--threshold 15] | --check-scanner\n");
+            return 2;
+        }
+    }
+    spdlog::set_level(spdlog::level::warn); // Controller 每筆 info Log 不計入
+
+    json baseline = json::object();
+    if (!opt.baseline.empty()) {
+        std::ifstream i(opt.baseline);
+        json doc = json::parse(i, nullptr, false);
+        if (doc.is_discarded() || !doc.contains("results")) {
+            std::fprintf(stderr, "cannot read baseline %s\n", opt.baseline.c_str());
+            return 2;
+        }
+        for (const auto& r : doc["results"]) baseline[r.value("name", "")] = r.value("ns_per_op", 0.0);
+    }
+
+    // 每個案例執行 repeat 次取中位數
+    std::vector<Result> results;
+    for (const auto& c : make_cases(opt.quick)) {
+        if (opt.quick && c.full_only) continue;
+        if (!opt.filter.empty() && c.name.find(opt.filter) == std::string::npos) continue;
+        std::vector<double> samples;
+        for (int r = 0; r < opt.repeat; ++r) samples.push_back(c.run());
+        std::sort(samples.begin(), samples.end());
+        results.push_back({c.name, samples[samples.size() / 2]});
+        if (!opt.as_json) std::fprintf(stderr, ".");
+    }
+    if (!opt.as_json) std::fprintf(stderr, "\n");
+    std::remove(OFFLINE_BENCH_FILE);
+    std::remove("bench_offline_data.json");
+
+    int regressions = 0;
+    json out_results = json::array();
+    for (const auto& r : results) {
+        json entry = {{"name", r.name}, {"ns_per_op", r.ns_per_op}};
+        if (baseline.contains(r.name) && baseline[r.name].get<double>() > 0) {
+            double base = baseline[r.name].get<double>();
+            double delta = (r.ns_per_op - base) / base * 100.0;
+            bool regressed = delta > opt.threshold;
+            regressions += regressed;
+            entry["baseline_ns_per_op"] = base;
+            entry["delta_pct"] = delta;
+            entry["regressed"] = regressed;
+        }
+        out_results.push_back(std::move(entry));
+    }
+
+    if (opt.as_json) {
+        json out = {{"quick", opt.quick}, {"repeat", opt.repeat}, {"results", out_results}};
+        if (!opt.baseline.empty()) {
+            out["baseline"] = opt.baseline;
+            out["threshold_pct"] = opt.threshold;
+            out["regressions"] = regressions;
+        }
+        std::printf("%s\n", out.dump(2).c_str());
+    } else {
+        std::printf("%-28s %14s", "case", "ns/op");
+        if (!opt.baseline.empty()) std::printf(" %14s %9s", "baseline", "delta");
+        std::printf("\n");
+        for (const auto& e : out_results) {
+            std::printf("%-28s %14.1f", e["name"].get<std::string>().c_str(), e["ns_per_op"].get<double>());
+            if (e.contains("baseline_ns_per_op")) {
+                std::printf(" %14.1f %+8.1f%%%s", e["baseline_ns_per_op"].get<double>(), e["delta_pct"].get<double>(),
+                            e["regressed"].get<bool>() ? "  REGRESSION" : "");
+            }
+            std::printf("\n");
+        }
+        if (!opt.baseline.empty()) {
+            std::printf("\n%d regression(s) over %.0f%% vs %s\n", regressions, opt.threshold, opt.baseline.c_str());
+        }
+    }
+    return regressions ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,448 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+#include "core/Lifecycle.hpp"
+
+// ==============================================================================
+// 結構化二進位 Log
+// 熱路徑 (條碼、PLC 寫入、WS 發送) 改用 LPSM_LOG：
+//   - 每個呼叫點只登錄一次格式字串 (format id)，之後每筆只寫 64 bytes 固定長度紀錄
+//     (時間戳 + format id + 原始參數)，不做字串格式化
+//   - 紀錄寫入各執行緒自己的無鎖 ring (SPSC)，背景執行緒定期寫入 gzip 檔並輪替；
+//     ring 滿了直接丟棄並計數，永遠不會讓設備執行緒等待
+//   - 各模組可在執行中調整等級 (WS SET_LOG_LEVEL)，每個呼叫點每秒有筆數上限
+// 預設 (LPSM_LOG_MODE 未設定) 仍以 spdlog 輸出文字，等級與限流規則相同；
+// 設定 LPSM_LOG_MODE=binary 時寫入 logs/*.blog.gz，以 tools/lpsm_logdump 解碼
+//
+// 檔案格式 (little-endian)
+//   "LPSMBLG1"
+//   'F' u16 id, u8 module, u8 level, u16 len, format, u16 len, "file:line"   (格式定義，出現在引用它的紀錄之前)
+//   'R' Record (64 bytes)
+//   參數編碼：u8 tag + 值 (I64/U64/F64 = 8 bytes，BOOL = 1 byte，STR = u8 len + bytes)
+// ==============================================================================
+
+enum class LogModule : uint8_t { SYS = 0, PLC, CAM, WS, CTRL, SCANNER, COUNT };
+
+class BinLog {
+public:
+    static constexpr size_t RING_SIZE = 4096;        // 每個執行緒的紀錄數 (2 的次方)
+    static constexpr uint32_t RATE_PER_SEC = 200;     // 每個呼叫點每秒上限
+    static constexpr uint64_t FILE_BYTES = 32ULL << 20; // 未壓縮大小超過時輪替
+    static constexpr int KEEP_FILES = 20;
+    static constexpr int ARG_BYTES = 48;
+
+    enum Tag : uint8_t { END = 0, I64, U64, F64, BOOL, STR };
+
+    struct Record {
+        uint64_t ts_ns;  // Unix epoch (ns)
+        uint16_t fmt;
+        uint8_t level;
+        uint8_t module;
+        uint8_t thread;  // ring 編號
+        uint8_t truncated;
+        uint16_t reserved;
+        uint8_t args[ARG_BYTES];
+    };
+    static_assert(sizeof(Record) == 64, "Record must stay 64 bytes");
+
+    // 呼叫點 (由 LPSM_LOG 以 static 建立，只登錄一次)
+    class Site {
+    public:
+        Site(LogModule module, spdlog::level::level_enum level, const char* fmt, const char* file, int line)
+            : module_(module), level_(level), fmt_(fmt), where_(short_file(file) + ":" + std::to_string(line)) {
+            id_ = register_site(this);
+        }
+
+        // 等級檢查 + 限流：超過每秒上限的紀錄丟棄，下一秒開頭補一筆摘要
+        bool enabled() {
+            if (level_ < BinLog::level(module_)) return false;
+            uint64_t sec = (uint64_t)std::time(nullptr);
+            uint64_t window = window_.load(std::memory_order_relaxed);
+            if (sec != window && window_.compare_exchange_strong(window, sec, std::memory_order_relaxed)) {
+                count_.store(0, std::memory_order_relaxed);
+                if (uint32_t n = suppressed_.exchange(0, std::memory_order_relaxed)) report_suppressed(*this, n);
+            }
+            // 降載中 (core/LoadShed.hpp) info 以下每 N 筆只取 1 筆，上限仍以實際輸出的筆數計算
+            uint32_t every = level_ <= spdlog::level::info ? BinLog::info_sample() : 1;
+            uint32_t n = count_.fetch_add(1, std::memory_order_relaxed);
+            if (n % every == 0 && n / every < RATE_PER_SEC) return true;
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint16_t id() const { return id_; }
+        LogModule module() const { return module_; }
+        spdlog::level::level_enum level() const { return level_; }
+        const char* fmt() const { return fmt_; }
+        const std::string& where() const { return where_; }
+
+    private:
+        LogModule module_;
+        spdlog::level::level_enum level_;
+        const char* fmt_;
+        std::string where_;
+        uint16_t id_ = 0;
+        std::atomic<uint64_t> window_{0};
+        std::atomic<uint32_t> count_{0};
+        std::atomic<uint32_t> suppressed_{0};
+
+        static std::string short_file(const char* file) {
+            std::string_view f(file);
+            auto pos = f.find("src/");
+            return std::string(pos == std::string_view::npos ? f : f.substr(pos + 4));
+        }
+    };
+
+    static bool binary() { return state().binary.load(std::memory_order_relaxed); }
+
+    static spdlog::level::level_enum level(LogModule m) {
+        return (spdlog::level::level_enum)state().levels[(int)m].load(std::memory_order_relaxed);
+    }
+
+    static void set_level(LogModule m, spdlog::level::level_enum level) {
+        state().levels[(int)m].store((uint8_t)level, std::memory_order_relaxed);
+        // 文字模式仍由 spdlog 過濾：全域等級取各模組最低者 (至少 info)
+        auto lowest = spdlog::level::info;
+        for (int i = 0; i < (int)LogModule::COUNT; ++i) lowest = std::min(lowest, BinLog::level((LogModule)i));
+        spdlog::set_level(lowest);
+    }
+
+    // info 以下的取樣間隔 (1 = 全部輸出)，由 LoadShed 在降載時調整
+    static uint32_t info_sample() { return state().info_sample.load(std::memory_order_relaxed); }
+    static void set_info_sample(uint32_t every) { state().info_sample.store(std::max<uint32_t>(1, every), std::memory_order_relaxed); }
+
+    static const char* module_name(LogModule m) {
+        static const char* names[] = {"SYS", "PLC", "CAM", "WS", "CTRL", "SCANNER"};
+        return names[(int)m];
+    }
+
+    static bool module_from_name(std::string_view name, LogModule& out) {
+        for (int i = 0; i < (int)LogModule::COUNT; ++i) {
+            if (name == module_name((LogModule)i)) { out = (LogModule)i; return true; }
+        }
+        return false;
+    }
+
+    // spdlog::level::from_str 對不認得的名稱回傳 off，這裡只接受真正的等級名稱 (含 warn / err 別名)
+    static bool level_from_name(std::string_view name, spdlog::level::level_enum& out) {
+        auto level = spdlog::level::from_str(std::string(name));
+        if (level == spdlog::level::off && name != "off") return false;
+        out = level;
+        return true;
+    }
+
+    // 各模組目前等級 (SET_LOG_LEVEL 回覆用)
+    static std::vector<std::pair<std::string, std::string>> levels() {
+        std::vector<std::pair<std::string, std::string>> out;
+        for (int i = 0; i < (int)LogModule::COUNT; ++i) {
+            auto name = spdlog::level::to_string_view(level((LogModule)i));
+            out.emplace_back(module_name((LogModule)i), std::string(name.data(), name.size()));
+        }
+        return out;
+    }
+
+    // 啟用二進位模式並啟動背景寫檔執行緒
+    static void start(const std::string& dir) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.writer_mutex);
+        if (s.writer.joinable()) return;
+        s.dir = dir;
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        s.running = true;
+        s.binary.store(true, std::memory_order_relaxed);
+        s.writer = std::thread([]() {
+            ThreadTopology::apply(ThreadRole::BACKGROUND);
+            writer_loop();
+        });
+    }
+
+    // 寫出剩餘紀錄並關檔
+    static void stop() {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.writer_mutex);
+        if (!s.writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> wake_lock(s.wake_mutex);
+            s.running = false;
+        }
+        s.wake.notify_all();
+        s.writer.join();
+    }
+
+    static uint64_t dropped() { return state().dropped.load(std::memory_order_relaxed); }
+
+    // 由 LPSM_LOG 呼叫 (二進位模式)
+    template <typename... Args>
+    static void write(const Site& site, const Args&... args) {
+        Ring& ring = local_ring();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= RING_SIZE) {
+            state().dropped.fetch_add(1, std::memory_order_relaxed); // ring 滿：丟棄，不等待
+            return;
+        }
+        Record& r = ring.slots[head & (RING_SIZE - 1)];
+        r.ts_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        r.fmt = site.id();
+        r.level = (uint8_t)site.level();
+        r.module = (uint8_t)site.module();
+        r.thread = ring.index;
+        r.truncated = 0;
+        r.reserved = 0;
+        size_t pos = 0;
+        (encode(r, pos, args), ...);
+        if (pos < ARG_BYTES) r.args[pos] = END;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+private:
+    struct Ring {
+        std::array<Record, RING_SIZE> slots;
+        std::atomic<uint64_t> head{0}; // 生產者 (寫 Log 的執行緒)
+        std::atomic<uint64_t> tail{0}; // 消費者 (背景寫檔)
+        uint8_t index = 0;
+    };
+
+    struct State {
+        std::array<std::atomic<uint8_t>, (int)LogModule::COUNT> levels;
+        std::atomic<bool> binary{false};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint32_t> info_sample{1};
+
+        std::mutex sites_mutex;
+        std::vector<const Site*> sites; // index = format id
+        std::vector<std::shared_ptr<Ring>> rings; // 執行緒結束後保留到寫完
+
+        std::mutex writer_mutex;
+        std::thread writer;
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        bool running = false;
+        std::string dir;
+
+        State() {
+            for (auto& l : levels) l.store((uint8_t)spdlog::level::info, std::memory_order_relaxed);
+        }
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    static uint16_t register_site(const Site* site) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.sites_mutex);
+        s.sites.push_back(site);
+        return (uint16_t)(s.sites.size() - 1);
+    }
+
+    static Ring& local_ring() {
+        thread_local std::shared_ptr<Ring> ring;
+        if (!ring) {
+            ring = std::make_shared<Ring>();
+            auto& s = state();
+            std::lock_guard<std::mutex> lock(s.sites_mutex);
+            ring->index = (uint8_t)s.rings.size();
+            s.rings.push_back(ring);
+        }
+        return *ring;
+    }
+
+    static void report_suppressed(const Site& site, uint32_t n) {
+        static Site summary(LogModule::SYS, spdlog::level::warn, "[Log] Rate limit: {} records suppressed at {}", __FILE__, __LINE__);
+        if (binary()) write(summary, n, site.where());
+        else spdlog::warn("[Log] Rate limit: {} records suppressed at {}", n, site.where());
+    }
+
+    // ---- 參數編碼 ----
+    static bool reserve(Record& r, size_t& pos, size_t n) {
+        if (pos + n > ARG_BYTES) { r.truncated = 1; return false; }
+        return true;
+    }
+
+    static void put_raw(Record& r, size_t& pos, Tag tag, const void* v, size_t n) {
+        if (!reserve(r, pos, 1 + n)) return;
+        r.args[pos++] = tag;
+        std::memcpy(r.args + pos, v, n);
+        pos += n;
+    }
+
+    static void put_str(Record& r, size_t& pos, std::string_view v) {
+        if (!reserve(r, pos, 2)) return;
+        size_t len = std::min(v.size(), std::min<size_t>(255, ARG_BYTES - pos - 2));
+        if (len < v.size()) r.truncated = 1;
+        r.args[pos++] = STR;
+        r.args[pos++] = (uint8_t)len;
+        std::memcpy(r.args + pos, v.data(), len);
+        pos += len;
+    }
+
+    template <typename T>
+    static void encode(Record& r, size_t& pos, const T& v) {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            uint8_t b = v ? 1 : 0;
+            put_raw(r, pos, BOOL, &b, 1);
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            int64_t x = v;
+            put_raw(r, pos, I64, &x, 8);
+        } else if constexpr (std::is_integral_v<U>) {
+            uint64_t x = v;
+            put_raw(r, pos, U64, &x, 8);
+        } else if constexpr (std::is_enum_v<U>) {
+            int64_t x = (int64_t)v;
+            put_raw(r, pos, I64, &x, 8);
+        } else if constexpr (std::is_floating_point_v<U>) {
+            double x = v;
+            put_raw(r, pos, F64, &x, 8);
+        } else {
+            put_str(r, pos, std::string_view(v));
+        }
+    }
+
+    // ---- 背景寫檔 ----
+    struct Writer {
+        gzFile file = nullptr;
+        uint64_t bytes = 0;
+        size_t formats_written = 0; // 本檔已寫出的格式定義數
+        int seq = 0;
+
+        ~Writer() { close(); }
+
+        void close() {
+            if (file) gzclose(file);
+            file = nullptr;
+        }
+
+        bool open(const std::string& dir) {
+            close();
+            std::time_t now = std::time(nullptr);
+            char stamp[32];
+            std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+            std::string path = dir + "/lpsm-" + stamp + "-" + std::to_string(seq++) + ".blog.gz";
+            file = gzopen(path.c_str(), "wb1"); // 壓縮等級 1：速度優先
+            if (!file) return false;
+            gzwrite(file, "LPSMBLG1", 8);
+            bytes = 8;
+            formats_written = 0;
+            prune(dir);
+            return true;
+        }
+
+        void write(const void* data, size_t n) {
+            gzwrite(file, data, (unsigned)n);
+            bytes += n;
+        }
+
+        // 只保留最新的 KEEP_FILES 個檔案 (檔名含時間，字典序即時間序)
+        static void prune(const std::string& dir) {
+            std::vector<std::filesystem::path> files;
+            std::error_code ec;
+            for (auto& e : std::filesystem::directory_iterator(dir, ec)) {
+                if (e.path().extension() == ".gz" && e.path().stem().extension() == ".blog") files.push_back(e.path());
+            }
+            if ((int)files.size() <= KEEP_FILES) return;
+            std::sort(files.begin(), files.end());
+            for (size_t i = 0; i + KEEP_FILES < files.size(); ++i) std::filesystem::remove(files[i], ec);
+        }
+    };
+
+    static void writer_loop() {
+        auto& s = state();
+        Writer out;
+        std::vector<Record> batch;
+        batch.reserve(RING_SIZE);
+        bool running = true;
+
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(s.wake_mutex);
+                s.wake.wait_for(lock, std::chrono::milliseconds(50), [&s] { return !s.running; });
+                running = s.running;
+            }
+
+            // 先取出紀錄，再寫格式定義：紀錄引用的 Site 一定已經登錄
+            std::vector<std::shared_ptr<Ring>> rings;
+            {
+                std::lock_guard<std::mutex> lock(s.sites_mutex);
+                rings = s.rings;
+            }
+            batch.clear();
+            for (auto& ring : rings) {
+                uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) batch.push_back(ring->slots[tail & (RING_SIZE - 1)]);
+                ring->tail.store(tail, std::memory_order_release);
+            }
+            if (batch.empty()) continue;
+
+            if (!out.file || out.bytes >= FILE_BYTES) {
+                if (!out.open(s.dir)) {
+                    spdlog::error("[Log] Cannot open binary log in {}", s.dir);
+                    continue;
+                }
+            }
+            write_formats(out);
+            for (const auto& r : batch) {
+                out.write("R", 1);
+                out.write(&r, sizeof(r));
+            }
+            gzflush(out.file, Z_SYNC_FLUSH); // 程式被強制結束時最多遺失一個週期
+        }
+    }
+
+    static void write_formats(Writer& out) {
+        auto& s = state();
+        std::vector<const Site*> sites;
+        {
+            std::lock_guard<std::mutex> lock(s.sites_mutex);
+            if (out.formats_written == s.sites.size()) return;
+            sites.assign(s.sites.begin() + out.formats_written, s.sites.end());
+        }
+        std::string buf;
+        for (const Site* site : sites) {
+            uint16_t id = site->id();
+            uint16_t fmt_len = (uint16_t)std::strlen(site->fmt());
+            uint16_t where_len = (uint16_t)site->where().size();
+            buf.push_back('F');
+            buf.append((const char*)&id, 2);
+            buf.push_back((char)site->module());
+            buf.push_back((char)site->level());
+            buf.append((const char*)&fmt_len, 2);
+            buf.append(site->fmt(), fmt_len);
+            buf.append((const char*)&where_len, 2);
+            buf.append(site->where());
+        }
+        out.write(buf.data(), buf.size());
+        out.formats_written += sites.size();
+    }
+};
+
+// 熱路徑 Log：LPSM_LOG(LogModule::CAM, spdlog::level::info, "[CAM] {} Recv: {}", role, barcode)
+// 參數須為整數 / 浮點數 / bool / 字串 (二進位模式以原始值保存)
+#define LPSM_LOG(module, lvl, fmt, ...)                                                      \
+    do {                                                                                     \
+        static BinLog::Site lpsm_log_site_(module, lvl, fmt, __FILE__, __LINE__);            \
+        if (lpsm_log_site_.enabled()) {                                                      \
+            if (BinLog::binary()) BinLog::write(lpsm_log_site_, ##__VA_ARGS__);              \
+            else spdlog::log(lvl, fmt, ##__VA_ARGS__);                                       \
+        }                                                                                    \
+    } while (0)
@@ -0,0 +1,309 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/Config.hpp"
+#include "core/Lifecycle.hpp"
+#include "core/MessageBus.hpp"
+#include "core/Sources.hpp"
+
+// ==============================================================================
+// Bus 擷取 (Capture)
+// 開啟後 Controller 取出的每則 Message 連同時間戳寫入擷取檔，供離線重播 (tools/lpsm_replay)：
+//   - Controller 執行緒只做編碼並放入記憶體緩衝，寫檔由背景執行緒負責；
+//     緩衝超過 MAX_PENDING_BYTES 時丟棄並計數，不讓 Controller 等待
+//   - 磁碟上為固定數量的分段檔 (ring)：每段 SEGMENT_BYTES，只保留最新 KEEP_SEGMENTS 段
+//   - 每段開頭都帶當時的設定與來源名稱表，任一段都可單獨重播
+//
+// 分段格式 (little-endian)
+//   "LPSMCAP1"
+//   'C' u32 len + 設定 (Config::encode)                 段開頭與設定變更時
+//   'S' u16 id, u8 len, name                            來源名稱 (出現在引用它的訊息之前)
+//   'M' u32 len + u64 rx, u64 enq, u64 deq, u16 source, u8 type, u8 command,
+//       u32 client_id, u8 len + request_id, CBOR payload
+// ==============================================================================
+
+class CaptureWriter {
+public:
+    static constexpr uint64_t SEGMENT_BYTES = 16ULL << 20;
+    static constexpr int KEEP_SEGMENTS = 8;
+    static constexpr size_t MAX_PENDING_BYTES = 8 << 20;
+
+    explicit CaptureWriter(std::string dir) : dir_(std::move(dir)) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        Config::subscribe([this](const Config::Snapshot& cfg) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            append_config(pending_, *cfg);
+        });
+        running_ = true;
+        writer_ = std::thread([this]() {
+            ThreadTopology::apply(ThreadRole::BACKGROUND);
+            writer_loop();
+        });
+        spdlog::info("[Capture] Recording bus traffic to {}", dir_);
+    }
+
+    ~CaptureWriter() { stop(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (writer_.joinable()) writer_.join();
+    }
+
+    // Controller 執行緒呼叫
+    void record(const Message& msg) {
+        std::string body;
+        body.reserve(48 + msg.request_id.size());
+        put_u64(body, msg.trace.rx);
+        put_u64(body, msg.trace.enq);
+        put_u64(body, msg.trace.deq);
+        put_u16(body, msg.source);
+        body.push_back((char)msg.type);
+        body.push_back((char)msg.command);
+        put_u32(body, msg.client_id);
+        size_t rid_len = std::min<size_t>(msg.request_id.size(), 255);
+        body.push_back((char)rid_len);
+        body.append(msg.request_id, 0, rid_len);
+        json::to_cbor(msg.payload, body);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.size() + body.size() > MAX_PENDING_BYTES) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        pending_.push_back('M');
+        put_u32(pending_, (uint32_t)body.size());
+        pending_ += body;
+        recorded_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // ---- 編碼工具 (CaptureReader 共用) ----
+    static void put_u16(std::string& s, uint16_t v) { s.push_back((char)(v & 0xFF)); s.push_back((char)(v >> 8)); }
+    static void put_u32(std::string& s, uint32_t v) { put_u16(s, (uint16_t)(v & 0xFFFF)); put_u16(s, (uint16_t)(v >> 16)); }
+    static void put_u64(std::string& s, uint64_t v) { put_u32(s, (uint32_t)(v & 0xFFFFFFFF)); put_u32(s, (uint32_t)(v >> 32)); }
+
+private:
+    std::string dir_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_ = false;
+    std::string pending_; // 待寫入的紀錄 (mutex_ 保護)
+    std::thread writer_;
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // 背景執行緒專用
+    std::ofstream out_;
+    uint64_t segment_bytes_ = 0;
+    size_t sources_written_ = 0; // 本段已寫出的來源 ID 數 (ID 連續配發)
+    int seq_ = 0;
+
+    static void append_config(std::string& buf, const Config::AppConfig& cfg) {
+        std::string payload = Config::encode(cfg);
+        buf.push_back('C');
+        put_u32(buf, (uint32_t)payload.size());
+        buf += payload;
+    }
+
+    void writer_loop() {
+        std::string chunk;
+        bool running = true;
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait_for(lock, std::chrono::milliseconds(100), [this] { return !running_; });
+                running = running_;
+                chunk.swap(pending_);
+            }
+            if (chunk.empty()) continue;
+
+            if (!out_.is_open() || segment_bytes_ >= SEGMENT_BYTES) {
+                if (!open_segment()) {
+                    chunk.clear();
+                    continue;
+                }
+            }
+            // 先補上新登錄的來源名稱：chunk 內引用的 ID 在 record() 前就已登錄
+            write_sources();
+            out_.write(chunk.data(), (std::streamsize)chunk.size());
+            out_.flush();
+            segment_bytes_ += chunk.size();
+            chunk.clear();
+        }
+        if (out_.is_open()) out_.close();
+    }
+
+    bool open_segment() {
+        if (out_.is_open()) out_.close();
+        std::time_t now = std::time(nullptr);
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+        std::string path = dir_ + "/capture-" + stamp + "-" + std::to_string(seq_++) + ".lcap";
+        out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!out_.is_open()) {
+            spdlog::error("[Capture] Cannot open {}", path);
+            return false;
+        }
+        std::string header = "LPSMCAP1";
+        append_config(header, *Config::get());
+        out_.write(header.data(), (std::streamsize)header.size());
+        segment_bytes_ = header.size();
+        sources_written_ = 0;
+        prune();
+        return true;
+    }
+
+    void write_sources() {
+        size_t count = Sources::version();
+        if (sources_written_ >= count) return;
+        std::string buf;
+        for (size_t id = sources_written_; id < count; ++id) {
+            const std::string& name = Sources::name((SourceId)id);
+            size_t len = std::min<size_t>(name.size(), 255);
+            buf.push_back('S');
+            put_u16(buf, (uint16_t)id);
+            buf.push_back((char)len);
+            buf.append(name, 0, len);
+        }
+        out_.write(buf.data(), (std::streamsize)buf.size());
+        segment_bytes_ += buf.size();
+        sources_written_ = count;
+    }
+
+    // 只保留最新的 KEEP_SEGMENTS 段 (檔名含時間，字典序即時間序)
+    void prune() {
+        std::vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (auto& e : std::filesystem::directory_iterator(dir_, ec)) {
+            if (e.path().extension() == ".lcap") files.push_back(e.path());
+        }
+        if ((int)files.size() <= KEEP_SEGMENTS) return;
+        std::sort(files.begin(), files.end());
+        for (size_t i = 0; i + KEEP_SEGMENTS < files.size(); ++i) std::filesystem::remove(files[i], ec);
+    }
+};
+
+// 讀取擷取分段：來源依名稱重新登錄為本程序的 ID
+class CaptureReader {
+public:
+    enum class Kind { MESSAGE, CONFIG };
+
+    struct Event {
+        Kind kind = Kind::MESSAGE;
+        Message msg;
+        Config::AppConfig config;
+    };
+
+    bool open(const std::string& path) {
+        std::ifstream i(path, std::ios::binary);
+        if (!i.is_open()) return false;
+        data_.assign(std::istreambuf_iterator<char>(i), std::istreambuf_iterator<char>());
+        pos_ = 8;
+        remap_.clear();
+        truncated_ = false;
+        return data_.size() >= 8 && data_.compare(0, 8, "LPSMCAP1") == 0;
+    }
+
+    // 讀到結尾 (或不完整的最後一筆) 回傳 false
+    bool next(Event& ev) {
+        while (pos_ < data_.size()) {
+            char kind = data_[pos_++];
+            if (kind == 'S') {
+                uint16_t id = 0;
+                if (!get_u16(id) || pos_ >= data_.size()) return fail();
+                size_t len = (uint8_t)data_[pos_++];
+                if (pos_ + len > data_.size()) return fail();
+                if (id >= remap_.size()) remap_.resize(id + 1, Sources::NONE);
+                remap_[id] = Sources::id_of(std::string_view(data_).substr(pos_, len));
+                pos_ += len;
+                continue;
+            }
+            uint32_t len = 0;
+            if (!get_u32(len) || pos_ + len > data_.size()) return fail();
+            size_t end = pos_ + len;
+            if (kind == 'C') {
+                ev.kind = Kind::CONFIG;
+                ev.config = Config::AppConfig{};
+                std::string payload = data_.substr(pos_, len);
+                size_t p = 0;
+                pos_ = end;
+                if (!Config::decode(payload, p, ev.config)) return fail();
+                return true;
+            }
+            if (kind != 'M') return fail();
+
+            ev.kind = Kind::MESSAGE;
+            ev.msg = Message{};
+            uint16_t source = 0;
+            uint8_t rid_len = 0;
+            if (!get_u64(ev.msg.trace.rx) || !get_u64(ev.msg.trace.enq) || !get_u64(ev.msg.trace.deq) ||
+                !get_u16(source) || pos_ + 7 > end) return fail();
+            ev.msg.type = (MsgType)data_[pos_++];
+            ev.msg.command = (Command)data_[pos_++];
+            get_u32(ev.msg.client_id);
+            rid_len = (uint8_t)data_[pos_++];
+            if (pos_ + rid_len > end) return fail();
+            ev.msg.request_id = data_.substr(pos_, rid_len);
+            pos_ += rid_len;
+            ev.msg.source = source < remap_.size() ? remap_[source] : Sources::NONE;
+            ev.msg.payload = json::from_cbor(data_.begin() + pos_, data_.begin() + end, true, false);
+            pos_ = end;
+            if (ev.msg.payload.is_discarded()) return fail();
+            return true;
+        }
+        return false;
+    }
+
+    // 最後一筆不完整 (錄製中被強制結束)
+    bool truncated() const { return truncated_; }
+
+private:
+    std::string data_;
+    size_t pos_ = 0;
+    std::vector<SourceId> remap_; // 檔案內 ID -> 本程序 ID
+    bool truncated_ = false;
+
+    bool fail() {
+        truncated_ = true;
+        pos_ = data_.size();
+        return false;
+    }
+
+    bool get_u16(uint16_t& v) {
+        if (pos_ + 2 > data_.size()) return false;
+        v = (uint16_t)((uint8_t)data_[pos_] | ((uint8_t)data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return true;
+    }
+    bool get_u32(uint32_t& v) {
+        uint16_t lo = 0, hi = 0;
+        if (!get_u16(lo) || !get_u16(hi)) return false;
+        v = (uint32_t)lo | ((uint32_t)hi << 16);
+        return true;
+    }
+    bool get_u64(uint64_t& v) {
+        uint32_t lo = 0, hi = 0;
+        if (!get_u32(lo) || !get_u32(hi)) return false;
+        v = (uint64_t)lo | ((uint64_t)hi << 32);
+        return true;
+    }
+};
\ No newline at end of file
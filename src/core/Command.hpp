@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 前端指令 (WS "command" 欄位)
+// WsServer 解析一次後以列舉型別放入 Message，Controller 不再比對字串
+enum class Command : uint8_t {
+    NONE = 0,
+    UNKNOWN,              // 未定義的指令 (仍照常轉發 / 回音)
+    // WsServer 直接處理，不進 Bus
+    HEARTBEAT,
+    SUBSCRIBE,
+    UNSUBSCRIBE,
+    RESUME,
+    LATENCY_STATS,
+    SET_LOG_LEVEL,
+    // 交給 Controller
+    GO_NOGO,
+    STEP_UPDATE,
+    RELOAD_CONFIG,
+    APPEND_OFFLINE_CACHE,
+    CLEAR_OFFLINE_CACHE,
+    LOAD_OFFLINE_CACHE,
+    SIGNAL_HISTORY,
+};
+
+inline Command command_from_name(std::string_view name) {
+    struct Entry { std::string_view name; Command cmd; };
+    static constexpr Entry table[] = {
+        {"HEARTBEAT", Command::HEARTBEAT},
+        {"SUBSCRIBE", Command::SUBSCRIBE},
+        {"UNSUBSCRIBE", Command::UNSUBSCRIBE},
+        {"RESUME", Command::RESUME},
+        {"LATENCY_STATS", Command::LATENCY_STATS},
+        {"SET_LOG_LEVEL", Command::SET_LOG_LEVEL},
+        {"GO_NOGO", Command::GO_NOGO},
+        {"STEP_UPDATE", Command::STEP_UPDATE},
+        {"RELOAD_CONFIG", Command::RELOAD_CONFIG},
+        {"APPEND_OFFLINE_CACHE", Command::APPEND_OFFLINE_CACHE},
+        {"CLEAR_OFFLINE_CACHE", Command::CLEAR_OFFLINE_CACHE},
+        {"LOAD_OFFLINE_CACHE", Command::LOAD_OFFLINE_CACHE},
+        {"SIGNAL_HISTORY", Command::SIGNAL_HISTORY},
+    };
+    if (name.empty()) return Command::NONE;
+    for (const auto& e : table) {
+        if (e.name == name) return e.cmd;
+    }
+    return Command::UNKNOWN;
+}
\ No newline at end of file
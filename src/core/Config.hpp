@@ -3,14 +3,20 @@
 #include <unordered_map>
 #include <vector>
 #include <algorithm> // for std::min, std::max
-#include <mysql.h>   // MySQL C API
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <ctime>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <zlib.h>    // crc32 (快照完整性檢查)
 #include "core/Logger.hpp"
 
-// DB 連線設定
-const char* CFG_DB_HOST = "10.8.32.64";
-const char* CFG_DB_USER = "sfuser";
-const char* CFG_DB_PASS = "1q2w3e4R";
-const char* CFG_DB_NAME = "sfdb4070";
+// 本機設定快照 (DB 斷線時仍可啟動)
+const char* CFG_SNAPSHOT_FILE = "state/config_snapshot.bin";
 
 class Config {
 public:
@@ -23,90 +29,267 @@ public:
         // ✅ [修正] 拆分寫入點位
         int write_result = 87;  // M87
         int write_trigger = 86; // M86
+
+        bool operator==(const PlcPoints& o) const {
+            return up_in == o.up_in && up_out == o.up_out && dn_in == o.dn_in && dn_out == o.dn_out &&
+                   start == o.start && write_result == o.write_result && write_trigger == o.write_trigger;
+        }
+        bool operator!=(const PlcPoints& o) const { return !(*this == o); }
     };
 
     struct AppConfig {
-        std::string hub_ip = ""; 
+        std::string hub_ip = "";
         std::string plc_ip = "10.8.142.137";
         int plc_port = 1285;
         PlcPoints points;
         std::unordered_map<std::string, std::string> camera_mapping;
+
+        bool operator==(const AppConfig& o) const {
+            return hub_ip == o.hub_ip && plc_ip == o.plc_ip && plc_port == o.plc_port &&
+                   points == o.points && camera_mapping == o.camera_mapping;
+        }
+        bool operator!=(const AppConfig& o) const { return !(*this == o); }
     };
 
-    static AppConfig& get() {
-        static AppConfig instance;
-        return instance;
+    // ==========================================================================
+    // RCU 式設定快照
+    // 讀取端：一次 atomic load 取得不可變快照，持有期間內容不會被改動
+    // 寫入端：建立新快照後整個換掉，再通知訂閱者 (訂閱者需自行 post 回所屬執行緒)
+    // ==========================================================================
+    using Snapshot = std::shared_ptr<const AppConfig>;
+    using Listener = std::function<void(const Snapshot&)>;
+
+    static Snapshot get() {
+        return std::atomic_load_explicit(&slot(), std::memory_order_acquire);
     }
 
-    // 唯一的載入入口：從 DB 讀取
-    static bool load_from_db(const std::string& local_ip) {
-        MYSQL* con = mysql_init(NULL);
-        if (con == NULL) {
-            spdlog::error("[Config] MySQL init failed");
-            return false;
+    static void publish(AppConfig cfg) {
+        Snapshot next = std::make_shared<const AppConfig>(std::move(cfg));
+        std::atomic_store_explicit(&slot(), next, std::memory_order_release);
+
+        std::vector<Listener> listeners;
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            listeners = registry().listeners;
         }
+        for (auto& fn : listeners) fn(next);
+    }
 
-        // ✅ [新增] 設定超時與關閉 SSL 驗證 (解決 0x800B0109)
-        int timeout = 3;
-        mysql_options(con, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
-        
-        my_bool ssl_verify = 0; 
-        mysql_options(con, MYSQL_OPT_SSL_VERIFY_SERVER_CERT, &ssl_verify);
+    static void subscribe(Listener fn) {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().listeners.push_back(std::move(fn));
+    }
 
-        if (!mysql_real_connect(con, CFG_DB_HOST, CFG_DB_USER, CFG_DB_PASS, CFG_DB_NAME, 3306, NULL, 0)) {
-            spdlog::error("[Config] DB Connection Failed: {}", mysql_error(con));
-            mysql_close(con);
-            return false;
+    // 要求背景 Watcher 立即重新向 DB 拉取 (例如前端下達 RELOAD_CONFIG)
+    static void request_reload() {
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().reload_requested = true;
         }
+        registry().cond.notify_all();
+    }
 
-        auto& cfg = get();
-        cfg.hub_ip = local_ip;
-
-        // 1. 讀取 PLC 配置
-        std::string sql = "SELECT plc_ip, plc_port, addr_up_in, addr_up_out, addr_dn_in, addr_dn_out, addr_start, addr_write_result, addr_write_trigger FROM 2did_machine_config WHERE hub_ip = '" + local_ip + "'";
-        if (mysql_query(con, sql.c_str()) == 0) {
-            MYSQL_RES* res = mysql_store_result(con);
-            if (MYSQL_ROW row = mysql_fetch_row(res)) {
-                if(row[0]) cfg.plc_ip = row[0];
-                if(row[1]) cfg.plc_port = std::stoi(row[1]);
-                if(row[2]) cfg.points.up_in = std::stoi(row[2]);
-                if(row[3]) cfg.points.up_out = std::stoi(row[3]);
-                if(row[4]) cfg.points.dn_in = std::stoi(row[4]);
-                if(row[5]) cfg.points.dn_out = std::stoi(row[5]);
-                if(row[6]) cfg.points.start = std::stoi(row[6]);
-                // ✅ [修正] 讀取 M87 和 M86
-                if(row[7]) cfg.points.write_result = std::stoi(row[7]);
-                if(row[8]) cfg.points.write_trigger = std::stoi(row[8]);
-                
-                spdlog::info("[Config] PLC Loaded from DB. PLC IP: {}, Port: {}", cfg.plc_ip, cfg.plc_port);
-            } else {
-                spdlog::error("[Config] CRITICAL: No config found for this Hub IP: {} in table 2did_machine_config", local_ip);
-                mysql_free_result(res);
-                mysql_close(con);
-                return false; 
-            }
-            mysql_free_result(res);
-        } else {
-            spdlog::error("[Config] Query PLC Failed: {}", mysql_error(con));
-            mysql_close(con);
+    // Watcher 用：等待 timeout 或 reload 要求；回傳是否為主動要求
+    static bool wait_reload_request(std::chrono::milliseconds timeout) {
+        auto& r = registry();
+        std::unique_lock<std::mutex> lock(r.mutex);
+        bool requested = r.cond.wait_for(lock, timeout, [&r]{ return r.reload_requested; });
+        r.reload_requested = false;
+        return requested;
+    }
+
+    // ==========================================================================
+    // 本機快照 (Local Snapshot)
+    // 格式 (Little-Endian):
+    //   "LPSC" | u16 version | u16 reserved | u64 saved_at | u32 payload_len | u32 crc32 | payload
+    //   payload = str hub_ip, str plc_ip, i32 plc_port, i32 x7 points, u16 cam_count, (str ip, str role) x N
+    //   str = u16 len + bytes
+    // ==========================================================================
+    static constexpr uint16_t SNAPSHOT_VERSION = 1;
+
+    // 啟動時優先讀取：不需網路，成功即可直接啟動
+    static bool load_snapshot(const std::string& local_ip, const std::string& path = CFG_SNAPSHOT_FILE) {
+        AppConfig cfg;
+        uint64_t saved_at = 0;
+        if (!read_snapshot(path, cfg, saved_at)) return false;
+
+        // 快照屬於別台電腦 (例如整包複製過來)，不可使用
+        if (cfg.hub_ip != local_ip) {
+            spdlog::warn("[Config] Snapshot belongs to {}, not {}. Ignored.", cfg.hub_ip, local_ip);
             return false;
         }
 
-        // 2. 讀取相機配置
-        sql = "SELECT camera_ip, camera_role FROM 2did_machine_cameras WHERE hub_ip = '" + local_ip + "'";
-        if (mysql_query(con, sql.c_str()) == 0) {
-            MYSQL_RES* res = mysql_store_result(con);
-            cfg.camera_mapping.clear();
-            while (MYSQL_ROW row = mysql_fetch_row(res)) {
-                if (row[0] && row[1]) {
-                    cfg.camera_mapping[row[0]] = row[1];
-                    spdlog::info("[Config] Camera Mapped: {} -> {}", row[0], row[1]);
+        spdlog::info("[Config] Loaded local snapshot (saved {}s ago). PLC IP: {}, Port: {}, Cameras: {}",
+                     (uint64_t)std::time(nullptr) - saved_at, cfg.plc_ip, cfg.plc_port, cfg.camera_mapping.size());
+        publish(std::move(cfg));
+        return true;
+    }
+
+    // 寫入暫存檔後再 rename，避免寫到一半斷電造成壞檔
+    static bool save_snapshot(const AppConfig& cfg, const std::string& path = CFG_SNAPSHOT_FILE) {
+        try {
+            std::string payload = encode(cfg);
+
+            std::string file = "LPSC";
+            put_u16(file, SNAPSHOT_VERSION);
+            put_u16(file, 0);
+            put_u64(file, (uint64_t)std::time(nullptr));
+            put_u32(file, (uint32_t)payload.size());
+            put_u32(file, (uint32_t)crc32(0L, (const Bytef*)payload.data(), (uInt)payload.size()));
+            file += payload;
+
+            std::filesystem::path target(path);
+            if (target.has_parent_path()) std::filesystem::create_directories(target.parent_path());
+            std::string tmp = path + ".tmp";
+            {
+                std::ofstream o(tmp, std::ios::binary | std::ios::trunc);
+                if (!o.is_open()) {
+                    spdlog::error("[Config] Failed to write snapshot: {}", tmp);
+                    return false;
                 }
+                o.write(file.data(), (std::streamsize)file.size());
+                if (!o) return false;
             }
-            mysql_free_result(res);
+            std::filesystem::rename(tmp, target);
+            return true;
+        } catch (const std::exception& e) {
+            spdlog::error("[Config] Save Snapshot Exception: {}", e.what());
+            return false;
+        }
+    }
+
+    static bool read_snapshot(const std::string& path, AppConfig& out, uint64_t& saved_at) {
+        std::ifstream i(path, std::ios::binary);
+        if (!i.is_open()) return false;
+        std::string file((std::istreambuf_iterator<char>(i)), std::istreambuf_iterator<char>());
+
+        const size_t header_len = 4 + 2 + 2 + 8 + 4 + 4;
+        if (file.size() < header_len || file.compare(0, 4, "LPSC") != 0) {
+            spdlog::warn("[Config] Snapshot {} is not a valid snapshot file.", path);
+            return false;
+        }
+
+        size_t pos = 4;
+        uint16_t version = 0, reserved = 0;
+        uint32_t len = 0, crc = 0;
+        get_u16(file, pos, version);
+        get_u16(file, pos, reserved);
+        get_u64(file, pos, saved_at);
+        get_u32(file, pos, len);
+        get_u32(file, pos, crc);
+
+        if (version != SNAPSHOT_VERSION) {
+            spdlog::warn("[Config] Snapshot version {} unsupported (expect {}).", version, SNAPSHOT_VERSION);
+            return false;
+        }
+        if (file.size() - header_len != len ||
+            crc32(0L, (const Bytef*)file.data() + header_len, (uInt)len) != crc) {
+            spdlog::warn("[Config] Snapshot {} is corrupted (CRC mismatch).", path);
+            return false;
+        }
+
+        AppConfig cfg;
+        if (!decode(file, pos, cfg)) {
+            spdlog::warn("[Config] Snapshot {} is truncated.", path);
+            return false;
+        }
+
+        out = std::move(cfg);
+        return true;
+    }
+
+    // 快照 payload 編碼 (Bus 擷取檔也以此格式記錄當時的設定)
+    static std::string encode(const AppConfig& cfg) {
+        std::string payload;
+        put_str(payload, cfg.hub_ip);
+        put_str(payload, cfg.plc_ip);
+        put_i32(payload, cfg.plc_port);
+        const auto& p = cfg.points;
+        for (int v : {p.up_in, p.up_out, p.dn_in, p.dn_out, p.start, p.write_result, p.write_trigger}) {
+            put_i32(payload, v);
         }
+        put_u16(payload, (uint16_t)cfg.camera_mapping.size());
+        for (const auto& [ip, role] : cfg.camera_mapping) {
+            put_str(payload, ip);
+            put_str(payload, role);
+        }
+        return payload;
+    }
+
+    static bool decode(const std::string& buf, size_t& pos, AppConfig& cfg) {
+        auto& p = cfg.points;
+        uint16_t cam_count = 0;
+        bool ok = get_str(buf, pos, cfg.hub_ip) && get_str(buf, pos, cfg.plc_ip) && get_i32(buf, pos, cfg.plc_port);
+        for (int* v : {&p.up_in, &p.up_out, &p.dn_in, &p.dn_out, &p.start, &p.write_result, &p.write_trigger}) {
+            ok = ok && get_i32(buf, pos, *v);
+        }
+        ok = ok && get_u16(buf, pos, cam_count);
+        for (uint16_t n = 0; ok && n < cam_count; ++n) {
+            std::string ip, role;
+            ok = get_str(buf, pos, ip) && get_str(buf, pos, role);
+            if (ok) cfg.camera_mapping[ip] = role;
+        }
+        return ok;
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<Listener> listeners;
+        bool reload_requested = false;
+    };
 
-        mysql_close(con);
+    static Snapshot& slot() {
+        static Snapshot instance = std::make_shared<const AppConfig>();
+        return instance;
+    }
+
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    static void put_u16(std::string& s, uint16_t v) { s.push_back((char)(v & 0xFF)); s.push_back((char)(v >> 8)); }
+    static void put_u32(std::string& s, uint32_t v) { put_u16(s, (uint16_t)(v & 0xFFFF)); put_u16(s, (uint16_t)(v >> 16)); }
+    static void put_u64(std::string& s, uint64_t v) { put_u32(s, (uint32_t)(v & 0xFFFFFFFF)); put_u32(s, (uint32_t)(v >> 32)); }
+    static void put_i32(std::string& s, int v) { put_u32(s, (uint32_t)v); }
+    // 長度欄位只有 16 bit：超過的部分截斷，長度與內容一致，後面的欄位才不會錯位
+    static void put_str(std::string& s, const std::string& v) {
+        size_t n = std::min<size_t>(v.size(), 0xFFFF);
+        put_u16(s, (uint16_t)n);
+        s.append(v, 0, n);
+    }
+
+    static bool get_u16(const std::string& s, size_t& pos, uint16_t& v) {
+        if (pos + 2 > s.size()) return false;
+        v = (uint16_t)((uint8_t)s[pos] | ((uint8_t)s[pos + 1] << 8));
+        pos += 2;
+        return true;
+    }
+    static bool get_u32(const std::string& s, size_t& pos, uint32_t& v) {
+        uint16_t lo = 0, hi = 0;
+        if (!get_u16(s, pos, lo) || !get_u16(s, pos, hi)) return false;
+        v = (uint32_t)lo | ((uint32_t)hi << 16);
+        return true;
+    }
+    static bool get_u64(const std::string& s, size_t& pos, uint64_t& v) {
+        uint32_t lo = 0, hi = 0;
+        if (!get_u32(s, pos, lo) || !get_u32(s, pos, hi)) return false;
+        v = (uint64_t)lo | ((uint64_t)hi << 32);
+        return true;
+    }
+    static bool get_i32(const std::string& s, size_t& pos, int& v) {
+        uint32_t u = 0;
+        if (!get_u32(s, pos, u)) return false;
+        v = (int)u;
+        return true;
+    }
+    static bool get_str(const std::string& s, size_t& pos, std::string& v) {
+        uint16_t len = 0;
+        if (!get_u16(s, pos, len) || pos + len > s.size()) return false;
+        v.assign(s, pos, len);
+        pos += len;
         return true;
     }
 };
\ No newline at end of file
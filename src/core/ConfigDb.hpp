@@ -0,0 +1,258 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mysql.h>   // MySQL C API
+#include "core/Config.hpp"
+#include "core/Logger.hpp"
+#include "core/Lifecycle.hpp"
+
+// DB 連線設定
+const char* CFG_DB_HOST = "10.8.32.64";
+const char* CFG_DB_USER = "sfuser";
+const char* CFG_DB_PASS = "1q2w3e4R";
+const char* CFG_DB_NAME = "sfdb4070";
+
+// 從 DB 拉取 Hub 設定
+// 兩張表以 LEFT JOIN 一次取回 (單一 Round Trip)，並使用 Prepared Statement 避免字串拼接
+class ConfigDb {
+    MYSQL* con_ = nullptr;
+    MYSQL_STMT* stmt_ = nullptr;
+
+    static constexpr const char* FETCH_SQL =
+        "SELECT c.plc_ip, c.plc_port, c.addr_up_in, c.addr_up_out, c.addr_dn_in, c.addr_dn_out, "
+        "c.addr_start, c.addr_write_result, c.addr_write_trigger, m.camera_ip, m.camera_role "
+        "FROM 2did_machine_config c "
+        "LEFT JOIN 2did_machine_cameras m ON m.hub_ip = c.hub_ip "
+        "WHERE c.hub_ip = ?";
+
+public:
+    ConfigDb() = default;
+    ConfigDb(const ConfigDb&) = delete;
+    ConfigDb& operator=(const ConfigDb&) = delete;
+    ~ConfigDb() { disconnect(); }
+
+    // 讀取 local_ip 對應的設定到 out；失敗時 out 不變
+    bool fetch(const std::string& local_ip, Config::AppConfig& out) {
+        if (!ensure_connected()) return false;
+
+        int rc = run_fetch(local_ip, out);
+        if (rc < 0) {
+            // 連線可能已被 Server 端關閉，重連後再試一次
+            disconnect();
+            if (!ensure_connected()) return false;
+            rc = run_fetch(local_ip, out);
+        }
+        return rc > 0;
+    }
+
+    // 同步載入 (無快照時使用)：成功後套用並寫入快照
+    static bool load(const std::string& local_ip) {
+        ConfigDb db;
+        Config::AppConfig cfg;
+        if (!db.fetch(local_ip, cfg)) return false;
+
+        Config::save_snapshot(cfg);
+        Config::publish(std::move(cfg));
+        return true;
+    }
+
+    // 列出兩份設定的差異 (Log 用)
+    static std::string describe_diff(const Config::AppConfig& a, const Config::AppConfig& b) {
+        std::string diff;
+        if (a.plc_ip != b.plc_ip || a.plc_port != b.plc_port) {
+            diff += "PLC " + a.plc_ip + ":" + std::to_string(a.plc_port) + " -> " + b.plc_ip + ":" + std::to_string(b.plc_port) + "; ";
+        }
+        if (a.points != b.points) diff += "PLC points changed; ";
+        for (const auto& [ip, role] : b.camera_mapping) {
+            auto it = a.camera_mapping.find(ip);
+            if (it == a.camera_mapping.end()) diff += "+cam " + ip + "=" + role + "; ";
+            else if (it->second != role) diff += "cam " + ip + " " + it->second + " -> " + role + "; ";
+        }
+        for (const auto& [ip, role] : a.camera_mapping) {
+            if (!b.camera_mapping.count(ip)) diff += "-cam " + ip + "; ";
+        }
+        return diff;
+    }
+private:
+    bool ensure_connected() {
+        if (con_ && stmt_) return true;
+
+        con_ = mysql_init(NULL);
+        if (con_ == NULL) {
+            spdlog::error("[Config] MySQL init failed");
+            return false;
+        }
+
+        // ✅ [新增] 設定超時與關閉 SSL 驗證 (解決 0x800B0109)
+        int timeout = 3;
+        mysql_options(con_, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+
+        my_bool ssl_verify = 0;
+        mysql_options(con_, MYSQL_OPT_SSL_VERIFY_SERVER_CERT, &ssl_verify);
+
+        if (!mysql_real_connect(con_, CFG_DB_HOST, CFG_DB_USER, CFG_DB_PASS, CFG_DB_NAME, 3306, NULL, 0)) {
+            spdlog::error("[Config] DB Connection Failed: {}", mysql_error(con_));
+            disconnect();
+            return false;
+        }
+
+        stmt_ = mysql_stmt_init(con_);
+        if (!stmt_ || mysql_stmt_prepare(stmt_, FETCH_SQL, (unsigned long)std::strlen(FETCH_SQL)) != 0) {
+            spdlog::error("[Config] Prepare Failed: {}", stmt_ ? mysql_stmt_error(stmt_) : mysql_error(con_));
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    void disconnect() {
+        if (stmt_) { mysql_stmt_close(stmt_); stmt_ = nullptr; }
+        if (con_) { mysql_close(con_); con_ = nullptr; }
+    }
+
+    // 回傳: 1 = 成功, 0 = 查無此 Hub, -1 = 查詢錯誤
+    int run_fetch(const std::string& local_ip, Config::AppConfig& out) {
+        // 1. 綁定參數 (hub_ip)
+        MYSQL_BIND param[1];
+        std::memset(param, 0, sizeof(param));
+        unsigned long ip_len = (unsigned long)local_ip.size();
+        param[0].buffer_type = MYSQL_TYPE_STRING;
+        param[0].buffer = (void*)local_ip.data();
+        param[0].buffer_length = ip_len;
+        param[0].length = &ip_len;
+
+        if (mysql_stmt_bind_param(stmt_, param) != 0 || mysql_stmt_execute(stmt_) != 0) {
+            spdlog::error("[Config] Query Config Failed: {}", mysql_stmt_error(stmt_));
+            return -1;
+        }
+
+        // 2. 綁定結果欄位
+        char plc_ip[64] = {0}, cam_ip[64] = {0}, cam_role[64] = {0};
+        int ints[8] = {0}; // plc_port + 7 個點位
+        unsigned long str_len[3] = {0};
+        my_bool is_null[11] = {0};
+
+        MYSQL_BIND result[11];
+        std::memset(result, 0, sizeof(result));
+        auto bind_str = [&](int col, char* buf, size_t cap, unsigned long* len) {
+            result[col].buffer_type = MYSQL_TYPE_STRING;
+            result[col].buffer = buf;
+            result[col].buffer_length = (unsigned long)cap;
+            result[col].length = len;
+            result[col].is_null = &is_null[col];
+        };
+        bind_str(0, plc_ip, sizeof(plc_ip), &str_len[0]);
+        for (int n = 0; n < 8; ++n) {
+            result[n + 1].buffer_type = MYSQL_TYPE_LONG;
+            result[n + 1].buffer = &ints[n];
+            result[n + 1].is_null = &is_null[n + 1];
+        }
+        bind_str(9, cam_ip, sizeof(cam_ip), &str_len[1]);
+        bind_str(10, cam_role, sizeof(cam_role), &str_len[2]);
+
+        if (mysql_stmt_bind_result(stmt_, result) != 0 || mysql_stmt_store_result(stmt_) != 0) {
+            spdlog::error("[Config] Fetch Config Failed: {}", mysql_stmt_error(stmt_));
+            return -1;
+        }
+
+        // 3. 逐行讀取 (每台相機一行，PLC 欄位每行相同)
+        Config::AppConfig cfg;
+        cfg.hub_ip = local_ip;
+        auto& p = cfg.points;
+        int* targets[8] = {&cfg.plc_port, &p.up_in, &p.up_out, &p.dn_in, &p.dn_out, &p.start, &p.write_result, &p.write_trigger};
+
+        int rows = 0;
+        int rc = 0;
+        while ((rc = mysql_stmt_fetch(stmt_)) == 0 || rc == MYSQL_DATA_TRUNCATED) {
+            if (rows++ == 0) {
+                if (!is_null[0]) cfg.plc_ip.assign(plc_ip, std::min<unsigned long>(str_len[0], sizeof(plc_ip)));
+                for (int n = 0; n < 8; ++n) {
+                    if (!is_null[n + 1]) *targets[n] = ints[n];
+                }
+            }
+            if (!is_null[9] && !is_null[10]) {
+                cfg.camera_mapping[std::string(cam_ip, std::min<unsigned long>(str_len[1], sizeof(cam_ip)))] =
+                    std::string(cam_role, std::min<unsigned long>(str_len[2], sizeof(cam_role)));
+            }
+        }
+        mysql_stmt_free_result(stmt_);
+
+        if (rc == 1) {
+            spdlog::error("[Config] Fetch Config Failed: {}", mysql_stmt_error(stmt_));
+            return -1;
+        }
+        if (rows == 0) {
+            spdlog::error("[Config] CRITICAL: No config found for this Hub IP: {} in table 2did_machine_config", local_ip);
+            return 0;
+        }
+
+        spdlog::info("[Config] PLC Loaded from DB. PLC IP: {}, Port: {}", cfg.plc_ip, cfg.plc_port);
+        for (const auto& [ip, role] : cfg.camera_mapping) {
+            spdlog::info("[Config] Camera Mapped: {} -> {}", ip, role);
+        }
+
+        out = std::move(cfg);
+        return 1;
+    }
+};
+
+// 背景設定監看：定期 (或收到 Config::request_reload 時) 向 DB 比對，
+// 有差異才發布新快照並更新本機快照檔
+class ConfigWatcher {
+    std::string local_ip_;
+    std::chrono::milliseconds interval_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+public:
+    ConfigWatcher(std::string local_ip, std::chrono::milliseconds interval = std::chrono::seconds(60))
+        : local_ip_(std::move(local_ip)), interval_(interval) {}
+
+    ~ConfigWatcher() { stop(); }
+
+    // refresh_now: 由快照啟動時立即比對一次
+    void start(bool refresh_now) {
+        running_ = true;
+        thread_ = std::thread([this, refresh_now](){
+            ThreadTopology::apply(ThreadRole::BACKGROUND);
+            ConfigDb db; // 連線與 Prepared Statement 重複使用
+            bool due = refresh_now;
+            while (running_) {
+                if (due) poll(db);
+                due = true;
+                if (Config::wait_reload_request(interval_)) {
+                    spdlog::info("[Config] Reload requested.");
+                }
+            }
+        });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) return;
+        Config::request_reload(); // 喚醒等待中的執行緒
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    void poll(ConfigDb& db) {
+        Config::AppConfig cfg;
+        if (!db.fetch(local_ip_, cfg)) {
+            spdlog::warn("[Config] DB refresh failed. Keep running on current config.");
+            return;
+        }
+
+        auto current = Config::get();
+        if (cfg == *current) {
+            spdlog::debug("[Config] DB refresh: no change.");
+            return;
+        }
+
+        spdlog::warn("[Config] Hot reload: {}", ConfigDb::describe_diff(*current, cfg));
+        Config::save_snapshot(cfg);
+        Config::publish(std::move(cfg));
+    }
+};
\ No newline at end of file
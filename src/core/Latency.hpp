@@ -0,0 +1,176 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// 端到端延遲追蹤
+// 每個 Message 帶著各階段的 monotonic 時間戳 (ns)，在經過時記錄到對應階段的 Histogram
+// ==============================================================================
+
+inline uint64_t trace_now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceStamps {
+    uint64_t rx = 0;   // 設備/前端收到資料
+    uint64_t enq = 0;  // 推入 MessageBus
+    uint64_t deq = 0;  // Controller 取出
+    uint64_t done = 0; // Controller 處理完成 (交給 WsServer)
+};
+
+// Log-Linear Histogram (HDR 風格，約 6% 精度)，記錄單位為 us
+// record() 只有 relaxed atomic 累加，可由任意執行緒同時呼叫
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS; // 每個 2 的次方區間切 16 格
+    static constexpr int BUCKETS = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+    using Counts = std::array<uint64_t, BUCKETS>;
+
+    void record(uint64_t us) {
+        counts_[index_of(us)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = max_.load(std::memory_order_relaxed);
+        while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    }
+
+    void record_ns(uint64_t from_ns, uint64_t to_ns) {
+        if (from_ns == 0 || to_ns < from_ns) return;
+        record((to_ns - from_ns) / 1000);
+    }
+
+    uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const {
+        uint64_t n = count();
+        return n ? (double)sum_.load(std::memory_order_relaxed) / (double)n : 0.0;
+    }
+
+    // 複製目前的計數 (可用兩次快照相減取得區間分佈)
+    Counts snapshot() const {
+        Counts c{};
+        for (int i = 0; i < BUCKETS; ++i) c[i] = counts_[i].load(std::memory_order_relaxed);
+        return c;
+    }
+
+    // bucket 上界可能超過實際最大值，回報時以 max 為上限
+    double percentile(double q) const { return std::min(percentile_of(snapshot(), q), (double)max()); }
+
+    // q: 0 ~ 100，回傳該 bucket 的上界 (us)
+    static double percentile_of(const Counts& c, double q) {
+        uint64_t total = 0;
+        for (auto v : c) total += v;
+        if (total == 0) return 0.0;
+
+        uint64_t rank = (uint64_t)((q / 100.0) * (double)total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += c[i];
+            if (seen >= rank) return (double)upper_of(i);
+        }
+        return (double)upper_of(BUCKETS - 1);
+    }
+
+    static int index_of(uint64_t v) {
+        if (v < (uint64_t)SUB_COUNT) return (int)v;
+        int msb = 63 - clz64(v);
+        int sub = (int)((v >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+        return SUB_COUNT + (msb - SUB_BITS) * SUB_COUNT + sub;
+    }
+
+    static uint64_t upper_of(int idx) {
+        if (idx < SUB_COUNT) return (uint64_t)idx;
+        int msb = (idx - SUB_COUNT) / SUB_COUNT + SUB_BITS;
+        int sub = (idx - SUB_COUNT) % SUB_COUNT;
+        return ((uint64_t)(SUB_COUNT + sub + 1) << (msb - SUB_BITS)) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+
+    static int clz64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(v);
+#else
+        int n = 0;
+        for (uint64_t bit = 1ULL << 63; bit && !(v & bit); bit >>= 1) ++n;
+        return n;
+#endif
+    }
+};
+
+// 各追蹤階段
+enum class Stage : int {
+    DEVICE_TO_BUS = 0, // 設備收到 -> 推入 Bus
+    BUS_WAIT,          // Bus 排隊
+    CONTROLLER,        // Controller 處理
+    WS_DEFER,          // Controller 完成 -> WS 執行緒發送 (loop defer)
+    WS_SEND,           // uWS publish 本身
+    END_TO_END,        // 設備收到 -> WS 發送
+    PLC_READ_RTT,      // PLC 讀取 Request -> Response
+    PLC_CYCLE,         // 相鄰兩次 PLC 讀取完成的間隔 (輪詢週期)
+    PLC_WRITE_RTT,     // PLC 寫入 Request -> Response
+    CMD_TO_PLC_ACK,    // 反向路徑：WS 收到指令 -> PLC 寫入回應
+    COUNT
+};
+
+class Latency {
+public:
+    static LatencyHistogram& stage(Stage s) {
+        static std::array<LatencyHistogram, (int)Stage::COUNT> stages;
+        return stages[(int)s];
+    }
+
+    static const char* name(Stage s) {
+        static const char* names[] = {
+            "device_to_bus", "bus_wait", "controller", "ws_defer", "ws_send",
+            "end_to_end", "plc_read_rtt", "plc_cycle", "plc_write_rtt", "cmd_to_plc_ack"
+        };
+        return names[(int)s];
+    }
+
+    // 各階段百分位數 (us)，供 WS LATENCY_STATS 查詢
+    static json to_json() {
+        json out = json::object();
+        for (int i = 0; i < (int)Stage::COUNT; ++i) {
+            auto& h = stage((Stage)i);
+            out[name((Stage)i)] = {
+                {"count", h.count()},
+                {"mean_us", (uint64_t)h.mean()},
+                {"p50_us", h.percentile(50)},
+                {"p90_us", h.percentile(90)},
+                {"p99_us", h.percentile(99)},
+                {"p999_us", h.percentile(99.9)},
+                {"max_us", h.max()}
+            };
+        }
+        return out;
+    }
+
+    // 單行摘要 (定期 Log 用)，只列出有資料的階段
+    static std::string summary() {
+        std::string out;
+        for (int i = 0; i < (int)Stage::COUNT; ++i) {
+            auto& h = stage((Stage)i);
+            if (h.count() == 0) continue;
+            out += std::string(name((Stage)i)) + " p50=" + std::to_string((uint64_t)h.percentile(50)) +
+                   " p99=" + std::to_string((uint64_t)h.percentile(99)) +
+                   " max=" + std::to_string(h.max()) + "us; ";
+        }
+        return out.empty() ? "no samples" : out;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // 避免 windows.h 先於 boost::asio 引入 winsock.h
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ==============================================================================
+// 執行緒拓撲與生命週期
+//   - 每條執行緒宣告角色 (ThreadRole)，啟動時由 ThreadTopology::apply 套用 CPU Affinity 與優先權
+//   - ManagedThread：可限時 join 的執行緒 (關閉流程不能被卡住的執行緒拖住)
+//   - ShutdownSequence：依序執行的關閉階段，每階段有逾時，總時間有上限
+//   - Lifecycle：關閉請求事件 (主執行緒阻塞等待，不再輪詢)
+// 環境變數 (皆可省略)，<ROLE> 為 IO / LOGIC / WS / HEARTBEAT / HOOK / DECODE / BACKGROUND：
+//   LPSM_THREAD_<ROLE>_CPUS      e.g. "2,3" 或 "0-3" (預設不限制)
+//   LPSM_THREAD_<ROLE>_PRIORITY  lowest / below_normal / normal / above_normal / highest 或 -2..2
+// ==============================================================================
+
+enum class ThreadRole {
+    IO,         // boost::asio io_context：PLC 輪詢 / 寫入、相機連線 (預設 above_normal)
+    LOGIC,      // Controller (Bus 消費端)
+    WS,         // uWS Event Loop
+    HEARTBEAT,  // WS 心跳 / 指令逾時檢查、延遲 Watchdog (預設 below_normal)
+    HOOK,       // Low-level Keyboard Hook 的 Message Loop (預設 above_normal，避免超過 LowLevelHooksTimeout)
+    DECODE,     // 掃碼槍按鍵解碼
+    BACKGROUND, // 二進位 Log / 擷取寫檔、DB 設定監看 (預設 below_normal)
+    COUNT
+};
+
+class ThreadTopology {
+public:
+    struct Policy {
+        uint64_t cpus = 0; // bit i = CPU i；0 = 不限制
+        int priority = 0;  // -2 (lowest) .. 2 (highest)
+    };
+
+    static const char* role_name(ThreadRole role) {
+        static const char* names[] = {"io", "logic", "ws", "heartbeat", "hook", "decode", "background"};
+        return names[(int)role];
+    }
+
+    static const char* priority_name(int priority) {
+        static const char* names[] = {"lowest", "below_normal", "normal", "above_normal", "highest"};
+        return names[std::clamp(priority, -2, 2) + 2];
+    }
+
+    // 角色預設值 + 環境變數
+    static Policy policy(ThreadRole role) {
+        Policy p;
+        if (role == ThreadRole::IO || role == ThreadRole::HOOK) p.priority = 1;
+        if (role == ThreadRole::HEARTBEAT || role == ThreadRole::BACKGROUND) p.priority = -1;
+
+        std::string prefix = "LPSM_THREAD_" + upper(role_name(role));
+        if (const char* v = std::getenv((prefix + "_CPUS").c_str())) {
+            if (!parse_cpus(v, p.cpus)) spdlog::warn("[Thread] Invalid {}_CPUS '{}' ignored", prefix, v);
+        }
+        if (const char* v = std::getenv((prefix + "_PRIORITY").c_str())) {
+            if (!parse_priority(v, p.priority)) spdlog::warn("[Thread] Invalid {}_PRIORITY '{}' ignored", prefix, v);
+        }
+        return p;
+    }
+
+    // 在執行緒本身呼叫 (作用於目前執行緒)
+    static void apply(ThreadRole role) {
+        Policy p = policy(role);
+        bool ok = set_priority(p.priority);
+        if (p.cpus) ok = set_affinity(p.cpus) && ok;
+        if (!ok) {
+            spdlog::warn("[Thread] {}: could not apply priority {} / cpus {}", role_name(role), priority_name(p.priority), format_cpus(p.cpus));
+        } else if (p.priority != 0 || p.cpus) {
+            spdlog::info("[Thread] {}: priority {}, cpus {}", role_name(role), priority_name(p.priority), format_cpus(p.cpus));
+        }
+    }
+
+    // "0,2-3" -> 0b1101
+    static bool parse_cpus(const std::string& text, uint64_t& out) {
+        uint64_t mask = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find(',', pos);
+            if (end == std::string::npos) end = text.size();
+            std::string item = text.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.empty()) continue;
+            size_t dash = item.find('-');
+            int first = 0, last = 0;
+            try {
+                first = std::stoi(item.substr(0, dash));
+                last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            } catch (...) {
+                return false;
+            }
+            if (first < 0 || last < first || last >= 64) return false;
+            for (int cpu = first; cpu <= last; ++cpu) mask |= 1ULL << cpu;
+        }
+        if (!mask) return false;
+        out = mask;
+        return true;
+    }
+
+    static bool parse_priority(const std::string& text, int& out) {
+        for (int p = -2; p <= 2; ++p) {
+            if (text == priority_name(p)) {
+                out = p;
+                return true;
+            }
+        }
+        try {
+            size_t used = 0;
+            int p = std::stoi(text, &used);
+            if (used != text.size() || p < -2 || p > 2) return false;
+            out = p;
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    static std::string format_cpus(uint64_t mask) {
+        if (!mask) return "any";
+        std::string out;
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (!(mask & (1ULL << cpu))) continue;
+            if (!out.empty()) out += ',';
+            out += std::to_string(cpu);
+        }
+        return out;
+    }
+
+private:
+    static std::string upper(std::string s) {
+        for (auto& c : s) c = (char)std::toupper((unsigned char)c);
+        return s;
+    }
+
+#ifdef _WIN32
+    static bool set_priority(int priority) {
+        static const int levels[] = {THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL,
+                                     THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_HIGHEST};
+        return SetThreadPriority(GetCurrentThread(), levels[std::clamp(priority, -2, 2) + 2]) != 0;
+    }
+
+    static bool set_affinity(uint64_t cpus) {
+        return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpus) != 0;
+    }
+#else
+    // Linux：以 nice 值近似 (提高優先權需要 CAP_SYS_NICE，失敗只記錄警告)
+    static bool set_priority(int priority) {
+        if (priority == 0) return true;
+        return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -5 * std::clamp(priority, -2, 2)) == 0;
+    }
+
+    static bool set_affinity(uint64_t cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (cpus & (1ULL << cpu)) CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+#endif
+};
+
+// 啟動時套用角色設定；關閉時可限時等待結束 (逾時則 detach，交給行程結束處理)
+class ManagedThread {
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool done = false;
+    };
+
+    std::thread thread_;
+    std::shared_ptr<State> state_;
+    ThreadRole role_ = ThreadRole::BACKGROUND;
+
+public:
+    ManagedThread() = default;
+    ManagedThread(const ManagedThread&) = delete;
+    ManagedThread& operator=(const ManagedThread&) = delete;
+    ~ManagedThread() {
+        if (thread_.joinable()) thread_.detach();
+    }
+
+    void start(ThreadRole role, std::function<void()> body) {
+        role_ = role;
+        state_ = std::make_shared<State>();
+        thread_ = std::thread([role, body = std::move(body), state = state_]() {
+            ThreadTopology::apply(role);
+            body();
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done = true;
+            }
+            state->cond.notify_all();
+        });
+    }
+
+    bool running() const { return thread_.joinable(); }
+
+    // 回傳 false 表示逾時 (執行緒仍在執行，已 detach)
+    bool join_for(std::chrono::milliseconds timeout) {
+        if (!thread_.joinable()) return true;
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            done = state_->cond.wait_for(lock, timeout, [this]{ return state_->done; });
+        }
+        if (done) {
+            thread_.join();
+            return true;
+        }
+        spdlog::warn("[Thread] {} did not stop within {} ms", ThreadTopology::role_name(role_), timeout.count());
+        thread_.detach();
+        return false;
+    }
+};
+
+// 依加入順序執行的關閉階段
+// 每個階段拿到 min(自身逾時, 總剩餘時間) 作為預算，必須自行在預算內返回；
+// 某階段失敗 / 逾時只記錄，後續階段照常執行 (盡量把能保存的都保存下來)
+class ShutdownSequence {
+public:
+    using Action = std::function<bool(std::chrono::milliseconds budget)>;
+
+    void add(std::string name, std::chrono::milliseconds timeout, Action action) {
+        stages_.push_back({std::move(name), timeout, std::move(action)});
+    }
+
+    // 回傳是否所有階段都在時間內完成
+    bool run(std::chrono::milliseconds total) {
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        auto deadline = t0 + total;
+        bool all_ok = true;
+
+        for (auto& stage : stages_) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+            if (remaining.count() <= 0) {
+                spdlog::error("[Shutdown] {} skipped (shutdown budget of {} ms exhausted)", stage.name, total.count());
+                all_ok = false;
+                continue;
+            }
+
+            auto begin = clock::now();
+            bool ok = false;
+            try {
+                ok = stage.action(std::min(stage.timeout, remaining));
+            } catch (const std::exception& e) {
+                spdlog::error("[Shutdown] {} threw: {}", stage.name, e.what());
+            }
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - begin).count();
+            if (ok) {
+                spdlog::info("[Shutdown] {} done in {} ms", stage.name, ms);
+            } else {
+                spdlog::warn("[Shutdown] {} incomplete after {} ms", stage.name, ms);
+                all_ok = false;
+            }
+        }
+        spdlog::info("[Shutdown] Completed in {} ms ({})",
+                     std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - t0).count(),
+                     all_ok ? "clean" : "INCOMPLETE");
+        return all_ok;
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        std::chrono::milliseconds timeout;
+        Action action;
+    };
+    std::vector<Stage> stages_;
+};
+
+// 行程層級的關閉事件：Console Handler 發出請求，主執行緒阻塞等待並執行 ShutdownSequence，
+// 完成後通知 (CTRL_CLOSE_EVENT 時 Handler 必須等到關閉完成才能返回，否則 Windows 直接結束行程)
+class Lifecycle {
+public:
+    static void request_shutdown() {
+        auto& s = state();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.requested = true;
+        }
+        s.cond.notify_all();
+    }
+
+    static bool shutdown_requested() {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.requested;
+    }
+
+    static void wait_for_shutdown() {
+        auto& s = state();
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.cond.wait(lock, [&s]{ return s.requested; });
+    }
+
+    static void notify_stopped() {
+        auto& s = state();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.stopped = true;
+        }
+        s.cond.notify_all();
+    }
+
+    static bool wait_stopped(std::chrono::milliseconds timeout) {
+        auto& s = state();
+        std::unique_lock<std::mutex> lock(s.mutex);
+        return s.cond.wait_for(lock, timeout, [&s]{ return s.stopped; });
+    }
+
+    // 預設 4000 ms：低於 Windows 對 CTRL_CLOSE_EVENT 的 5 秒寬限
+    static std::chrono::milliseconds shutdown_budget() {
+        if (const char* v = std::getenv("LPSM_SHUTDOWN_TIMEOUT_MS")) {
+            int ms = std::atoi(v);
+            if (ms > 0) return std::chrono::milliseconds(ms);
+        }
+        return std::chrono::milliseconds(4000);
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool requested = false;
+        bool stopped = false;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "core/BinLog.hpp"
+
+// ==============================================================================
+// 過載降載 (Load Shedding)
+// logic/Watchdog.hpp 在 SLO 違反時啟動、恢復時解除；各模組在熱路徑只讀一個 relaxed atomic
+//   LOGS       info 以下的 LPSM_LOG 每個呼叫點每 N 筆取 1 筆 (LPSM_SHED_LOG_SAMPLE，預設 10)
+//   MONITOR    相機監控事件 (TIMEOUT_BLANK) 每個來源每 LPSM_SHED_MONITOR_MS (預設 1000) 只推播最新一筆
+//   HEARTBEAT  WS 心跳推入 Bus 的間隔 2 秒 -> LPSM_SHED_HEARTBEAT_SEC (預設 10)
+//   CACHE      LOAD_OFFLINE_CACHE 的廣播延到恢復後 (CMD_ACK 回覆 DEFERRED)
+// LPSM_SHED_ACTIONS=logs,monitor,heartbeat,cache 只啟用列出的項目 (預設全部，空字串 = 只監看不降載)
+// 安全相關路徑 (GO_NOGO、前端斷線復歸、PLC 寫入) 不在降載範圍內
+// ==============================================================================
+
+enum class Shed : uint8_t { LOGS = 0, MONITOR, HEARTBEAT, CACHE, COUNT };
+
+class LoadShed {
+public:
+    static bool active(Shed s) { return (state().active.load(std::memory_order_relaxed) >> (int)s) & 1u; }
+    static bool any() { return state().active.load(std::memory_order_relaxed) != 0; }
+
+    static const char* name(Shed s) {
+        static const char* names[] = {"logs", "monitor", "heartbeat", "cache"};
+        return names[(int)s];
+    }
+
+    // 目前生效中的項目名稱
+    static std::vector<std::string> active_names() {
+        std::vector<std::string> out;
+        for (int i = 0; i < (int)Shed::COUNT; ++i) {
+            if (active((Shed)i)) out.emplace_back(name((Shed)i));
+        }
+        return out;
+    }
+
+    // 啟動降載 (只有 Watchdog 呼叫)
+    static void engage() {
+        auto& s = state();
+        s.active.store(s.enabled, std::memory_order_relaxed);
+        if (active(Shed::LOGS)) BinLog::set_info_sample(s.log_sample);
+    }
+
+    static void release() {
+        state().active.store(0, std::memory_order_relaxed);
+        BinLog::set_info_sample(1);
+    }
+
+    static std::chrono::seconds heartbeat_interval() {
+        return active(Shed::HEARTBEAT) ? state().heartbeat : std::chrono::seconds(2);
+    }
+
+    static std::chrono::milliseconds monitor_window() { return state().monitor_window; }
+
+private:
+    struct State {
+        std::atomic<uint32_t> active{0}; // bit i = Shed i
+        uint32_t enabled = (1u << (int)Shed::COUNT) - 1;
+        uint32_t log_sample = 10;
+        std::chrono::seconds heartbeat{10};
+        std::chrono::milliseconds monitor_window{1000};
+
+        State() {
+            if (const char* v = std::getenv("LPSM_SHED_ACTIONS")) enabled = parse_actions(v);
+            if (const char* v = std::getenv("LPSM_SHED_LOG_SAMPLE")) log_sample = (uint32_t)std::max(1, std::atoi(v));
+            if (const char* v = std::getenv("LPSM_SHED_HEARTBEAT_SEC")) heartbeat = std::chrono::seconds(std::max(2, std::atoi(v)));
+            if (const char* v = std::getenv("LPSM_SHED_MONITOR_MS")) monitor_window = std::chrono::milliseconds(std::max(50, std::atoi(v)));
+        }
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    // "logs,monitor" -> bit mask；不認得的名稱略過並警告
+    static uint32_t parse_actions(const std::string& list) {
+        uint32_t mask = 0;
+        size_t pos = 0;
+        while (pos <= list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            std::string item = list.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.empty()) continue;
+            bool known = false;
+            for (int i = 0; i < (int)Shed::COUNT; ++i) {
+                if (item == name((Shed)i)) { mask |= 1u << i; known = true; }
+            }
+            if (!known) spdlog::warn("[Watchdog] Unknown LPSM_SHED_ACTIONS item '{}' ignored", item);
+        }
+        return mask;
+    }
+};
\ No newline at end of file
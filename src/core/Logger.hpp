@@ -2,18 +2,34 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/async.h>
+#include <cstdlib>
 #include <memory>
+#include <string>
+#include "core/BinLog.hpp"
 
 class Logger {
 public:
     static void init() {
         // 使用異步 Logger 以避免 I/O 阻塞主執行緒
+        // ✅ Console 太慢時丟棄最舊的訊息 (overrun_oldest)，不讓 io / logic 執行緒被 Log 卡住
         auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
         spdlog::init_thread_pool(8192, 1);
-        auto logger = std::make_shared<spdlog::async_logger>("app", console_sink, spdlog::thread_pool(), spdlog::async_overflow_policy::block);
+        auto logger = std::make_shared<spdlog::async_logger>("app", console_sink, spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
         
         spdlog::set_default_logger(logger);
         spdlog::set_pattern("[%H:%M:%S.%e] [%^%l%$] [thread %t] %v");
         spdlog::set_level(spdlog::level::info);
+
+        // LPSM_LOG_MODE=binary：熱路徑 Log 改寫入 logs/*.blog.gz (見 core/BinLog.hpp)
+        const char* mode = std::getenv("LPSM_LOG_MODE");
+        if (mode && std::string(mode) == "binary") {
+            BinLog::start("logs");
+            spdlog::info("[Log] Binary log enabled (logs/*.blog.gz)");
+        }
+    }
+
+    static void shutdown() {
+        BinLog::stop();
+        spdlog::shutdown();
     }
 };
\ No newline at end of file
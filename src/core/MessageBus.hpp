@@ -1,45 +1,131 @@
 // src/core/MessageBus.hpp
 #pragma once
-#include <queue>
+#include <array>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <atomic>
+#include <chrono>
 #include <nlohmann/json.hpp>
+#include "core/Latency.hpp"
+#include "core/Metrics.hpp"
+#include "core/Command.hpp"
+#include "core/Sources.hpp"
 
 using json = nlohmann::json;
 
 struct Message {
-    std::string source;  // "PLC", "CAM_L", "WS"
-    std::string type;    // "DATA", "CMD", "LOG"
+    SourceId source = Sources::NONE; // 來源 ID (名稱見 Sources::name)
+    MsgType type = MsgType::DATA;
     json payload;        // 統一使用 JSON 傳遞數據
+    TraceStamps trace;   // 延遲追蹤時間戳 (由 Bus 與各階段填入)
+    Command command = Command::NONE; // WS 指令類型 (type == CMD 時有效)
+    uint32_t client_id = 0;          // 發出指令的 WS Client (0 = 非 WS 來源)
+    std::string request_id;          // 帶 request_id 的指令：WsServer 的追蹤 key (已加上 Client 範圍，complete_request 原樣傳回；空 = 不需回覆 CMD_ACK)
 };
 
+// ==============================================================================
+// 優先權通道 (Lane)：pop 時永遠先取高優先權通道
+//   CONTROL    安全相關 (前端斷線 -> reset_safe_signals、GO_NOGO)
+//   COMMAND    其餘前端指令
+//   DEVICE     PLC 狀態、條碼 (不可遺失，不設上限)
+//   TELEMETRY  心跳、相機監控 (TIMEOUT_BLANK)；有容量上限，
+//              同來源同類型的訊息排隊中時直接以新值取代 (conflate)，滿了丟最舊的一筆
+// ==============================================================================
+enum class Lane : uint8_t { CONTROL = 0, COMMAND, DEVICE, TELEMETRY, COUNT };
+
 class MessageBus {
+public:
+    static constexpr size_t TELEMETRY_CAPACITY = 256;
+
+    static const char* lane_name(Lane lane) {
+        static const char* names[] = {"control", "command", "device", "telemetry"};
+        return names[(int)lane];
+    }
+
+    static Lane lane_of(const Message& msg) {
+        if (msg.type == MsgType::DISCONNECTED) return Lane::CONTROL;
+        if (msg.type == MsgType::CMD) return msg.command == Command::GO_NOGO ? Lane::CONTROL : Lane::COMMAND;
+        if (msg.type == MsgType::HEARTBEAT || Sources::kind(msg.source) == SourceKind::CAMERA_MONITOR) return Lane::TELEMETRY;
+        return Lane::DEVICE;
+    }
+
 private:
-    std::queue<Message> queue_;
+    struct LaneState {
+        std::deque<Message> queue;
+        size_t capacity = 0;  // 0 = 不設上限
+        bool conflate = false;
+        std::atomic<size_t> depth{0}; // 以下供 Metrics 無鎖讀取
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> conflated{0};
+        LatencyHistogram wait; // 推入 -> 取出 (us)
+    };
+
+    std::array<LaneState, (int)Lane::COUNT> lanes_;
     std::mutex mutex_;
     std::condition_variable cond_;
     bool stop_ = false;
+    std::atomic<size_t> depth_{0}; // 供 Metrics 無鎖讀取
 
 public:
-    void push(const Message& msg) {
+    MessageBus() {
+        auto& telemetry = lanes_[(int)Lane::TELEMETRY];
+        telemetry.capacity = TELEMETRY_CAPACITY;
+        telemetry.conflate = true;
+    }
+
+    void push(Message msg) {
+        msg.trace.enq = trace_now_ns();
+        if (msg.trace.rx == 0) msg.trace.rx = msg.trace.enq; // 未標記收到時間的來源 (e.g. SYS)
+        auto& lane = lanes_[(int)lane_of(msg)];
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            queue_.push(msg);
+            if (!enqueue(lane, std::move(msg))) return; // conflate：原本排隊中的那筆已更新，不需喚醒
         }
+        Metrics::inc(Counter::BUS_ENQUEUED);
         cond_.notify_one();
     }
 
     // 阻塞式獲取，適合 Logic Thread 使用
     bool pop(Message& msg) {
         std::unique_lock<std::mutex> lock(mutex_);
-        cond_.wait(lock, [this]{ return !queue_.empty() || stop_; });
-        
-        if (stop_ && queue_.empty()) return false;
+        cond_.wait(lock, [this]{ return depth_.load(std::memory_order_relaxed) > 0 || stop_; });
         
-        msg = queue_.front();
-        queue_.pop();
-        return true;
+        if (stop_ && depth_.load(std::memory_order_relaxed) == 0) return false;
+        return take(msg);
+    }
+
+    // 最多等待 timeout：Controller 有定時工作 (降載期間累積的推播) 時使用
+    enum class Pop : uint8_t { MESSAGE, TIMEOUT, STOPPED };
+    Pop pop_for(Message& msg, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cond_.wait_for(lock, timeout, [this]{ return depth_.load(std::memory_order_relaxed) > 0 || stop_; })) return Pop::TIMEOUT;
+        if (stop_ && depth_.load(std::memory_order_relaxed) == 0) return Pop::STOPPED;
+        return take(msg) ? Pop::MESSAGE : Pop::TIMEOUT;
+    }
+
+    size_t size() const { return depth_.load(std::memory_order_relaxed); }
+    size_t size(Lane lane) const { return lanes_[(int)lane].depth.load(std::memory_order_relaxed); }
+    const LatencyHistogram& wait(Lane lane) const { return lanes_[(int)lane].wait; }
+
+    // 各通道深度、丟棄 / 合併次數、排隊時間 (us)
+    json lane_stats() const {
+        json out = json::object();
+        for (int i = 0; i < (int)Lane::COUNT; ++i) {
+            const auto& lane = lanes_[i];
+            out[lane_name((Lane)i)] = {
+                {"depth", lane.depth.load(std::memory_order_relaxed)},
+                {"capacity", lane.capacity},
+                {"dropped", lane.dropped.load(std::memory_order_relaxed)},
+                {"conflated", lane.conflated.load(std::memory_order_relaxed)},
+                {"wait_count", lane.wait.count()},
+                {"wait_p50_us", lane.wait.percentile(50)},
+                {"wait_p99_us", lane.wait.percentile(99)},
+                {"wait_max_us", lane.wait.max()}
+            };
+        }
+        return out;
     }
 
     void stop() {
@@ -49,4 +135,46 @@ public:
         }
         cond_.notify_all();
     }
+
+private:
+    // 呼叫端持有 mutex_ 且 depth_ > 0：依優先權取出一筆
+    bool take(Message& msg) {
+        for (auto& lane : lanes_) {
+            if (lane.queue.empty()) continue;
+            msg = std::move(lane.queue.front());
+            lane.queue.pop_front();
+            lane.depth.store(lane.queue.size(), std::memory_order_relaxed);
+            depth_.fetch_sub(1, std::memory_order_relaxed);
+            msg.trace.deq = trace_now_ns();
+            lane.wait.record_ns(msg.trace.enq, msg.trace.deq);
+            return true;
+        }
+        return false;
+    }
+
+    // 呼叫端持有 mutex_；回傳 false 表示沒有新增排隊筆數
+    bool enqueue(LaneState& lane, Message msg) {
+        if (lane.conflate) {
+            for (auto& queued : lane.queue) {
+                if (queued.source == msg.source && queued.type == msg.type) {
+                    msg.trace.enq = queued.trace.enq; // 排隊時間從第一筆開始算
+                    queued = std::move(msg);
+                    lane.conflated.fetch_add(1, std::memory_order_relaxed);
+                    Metrics::inc(Counter::BUS_CONFLATED);
+                    return false;
+                }
+            }
+        }
+        if (lane.capacity && lane.queue.size() >= lane.capacity) {
+            lane.queue.pop_front();
+            lane.dropped.fetch_add(1, std::memory_order_relaxed);
+            Metrics::inc(Counter::BUS_DROPPED);
+            lane.queue.push_back(std::move(msg));
+            return false;
+        }
+        lane.queue.push_back(std::move(msg));
+        lane.depth.store(lane.queue.size(), std::memory_order_relaxed);
+        depth_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,289 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include "core/Latency.hpp"
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// 系統指標 (Prometheus / JSON)
+// 計數器採 per-thread 分片：熱路徑只寫自己執行緒的 slot (無鎖、無 RMW 競爭)，
+// 抓取 (scrape) 時才把所有分片加總
+// ==============================================================================
+
+enum class Counter : int {
+    BUS_ENQUEUED = 0,
+    BUS_DROPPED,
+    BUS_CONFLATED,
+    PLC_READS,
+    PLC_WRITES,
+    PLC_ERRORS,
+    PLC_RECONNECTS,
+    WS_MESSAGES_SENT,
+    WS_BYTES_SENT,
+    WS_BACKPRESSURE_DROPS,
+    WS_COMMANDS_RECEIVED,
+    WS_CONFLATED,
+    WS_SLOW_CLIENT_CLOSED,
+    WS_COMPRESSED_FRAMES,
+    COUNT
+};
+
+class Metrics {
+public:
+    // 每台相機 (依角色) 的計數，Session 取得指標後快取使用
+    struct CameraStats {
+        std::atomic<uint64_t> barcodes{0};
+        std::atomic<uint64_t> timeouts{0};
+    };
+
+    static void inc(Counter c, uint64_t n = 1) {
+        auto& slot = local().values[(int)c];
+        // 只有本執行緒會寫入這個 slot，load + store 即可 (不需 lock 前綴指令)
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static uint64_t total(Counter c) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        uint64_t sum = 0;
+        for (auto& shard : r.shards) sum += shard->values[(int)c].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    static CameraStats& camera(const std::string& role) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto& slot = r.cameras[role];
+        if (!slot) slot = std::make_unique<CameraStats>();
+        return *slot;
+    }
+
+    // PLC End Code != 0 (錯誤路徑，頻率低，直接加鎖)
+    static void plc_end_code(int code) {
+        inc(Counter::PLC_ERRORS);
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.end_codes[code]++;
+    }
+
+    // Gauge 於 scrape 時才計算 (e.g. Bus 深度、Client 數、快取檔大小)
+    static void gauge(std::string name, std::string help, std::function<double()> fn) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.gauges.push_back({std::move(name), std::move(help), std::move(fn)});
+    }
+
+    static std::string prometheus() {
+        auto snap = collect();
+        std::string out;
+        out.reserve(4096);
+
+        for (int i = 0; i < (int)Counter::COUNT; ++i) {
+            const auto& info = counter_info((Counter)i);
+            out += "# HELP " + std::string(info.name) + " " + info.help + "\n";
+            out += "# TYPE " + std::string(info.name) + " counter\n";
+            out += std::string(info.name) + " " + std::to_string(snap.counters[i]) + "\n";
+        }
+
+        out += "# HELP lpsm_plc_end_code_total PLC responses with a non-zero end code\n";
+        out += "# TYPE lpsm_plc_end_code_total counter\n";
+        for (auto& [code, n] : snap.end_codes) {
+            out += "lpsm_plc_end_code_total{code=\"" + hex_code(code) + "\"} " + std::to_string(n) + "\n";
+        }
+
+        out += "# HELP lpsm_camera_barcodes_total Barcodes received per camera role\n";
+        out += "# TYPE lpsm_camera_barcodes_total counter\n";
+        for (auto& [role, c] : snap.cameras) {
+            out += "lpsm_camera_barcodes_total{role=\"" + role + "\"} " + std::to_string(c.first) + "\n";
+        }
+        out += "# HELP lpsm_camera_timeouts_total Read timeouts (TIMEOUT_BLANK) per camera role\n";
+        out += "# TYPE lpsm_camera_timeouts_total counter\n";
+        for (auto& [role, c] : snap.cameras) {
+            out += "lpsm_camera_timeouts_total{role=\"" + role + "\"} " + std::to_string(c.second) + "\n";
+        }
+
+        for (auto& g : snap.gauges) {
+            out += "# HELP " + g.name + " " + g.help + "\n";
+            out += "# TYPE " + g.name + " gauge\n";
+            out += g.name + " " + fmt_double(g.value) + "\n";
+        }
+
+        out += "# HELP lpsm_latency_us Per-stage latency (see LATENCY_STATS)\n";
+        out += "# TYPE lpsm_latency_us summary\n";
+        for (int i = 0; i < (int)Stage::COUNT; ++i) {
+            auto& h = Latency::stage((Stage)i);
+            std::string label = std::string("stage=\"") + Latency::name((Stage)i) + "\"";
+            for (double q : {50.0, 90.0, 99.0}) {
+                out += "lpsm_latency_us{" + label + ",quantile=\"" + fmt_double(q / 100.0) + "\"} " +
+                       fmt_double(h.percentile(q)) + "\n";
+            }
+            out += "lpsm_latency_us_count{" + label + "} " + std::to_string(h.count()) + "\n";
+        }
+
+        out += "# HELP lpsm_uptime_seconds Process uptime\n";
+        out += "# TYPE lpsm_uptime_seconds gauge\n";
+        out += "lpsm_uptime_seconds " + fmt_double(snap.uptime_s) + "\n";
+        return out;
+    }
+
+    // JSON 版本：另外附上與上一次 JSON 抓取之間的每秒速率
+    static json to_json() {
+        auto snap = collect();
+        json out = json::object();
+
+        static std::mutex rate_mutex;
+        static std::array<uint64_t, (int)Counter::COUNT> last_counters{};
+        static double last_uptime = 0;
+        std::lock_guard<std::mutex> lock(rate_mutex);
+        double dt = snap.uptime_s - last_uptime;
+
+        json counters = json::object(), rates = json::object();
+        for (int i = 0; i < (int)Counter::COUNT; ++i) {
+            const char* name = counter_info((Counter)i).name;
+            counters[name] = snap.counters[i];
+            rates[name] = dt > 0 ? (double)(snap.counters[i] - last_counters[i]) / dt : 0.0;
+            last_counters[i] = snap.counters[i];
+        }
+        last_uptime = snap.uptime_s;
+
+        json end_codes = json::object();
+        for (auto& [code, n] : snap.end_codes) end_codes[hex_code(code)] = n;
+
+        json cameras = json::object();
+        for (auto& [role, c] : snap.cameras) cameras[role] = {{"barcodes", c.first}, {"timeouts", c.second}};
+
+        json gauges = json::object();
+        for (auto& g : snap.gauges) gauges[g.name] = g.value;
+
+        out["uptime_s"] = snap.uptime_s;
+        out["counters"] = counters;
+        out["rates_per_s"] = rates;
+        out["plc_end_codes"] = end_codes;
+        out["cameras"] = cameras;
+        out["gauges"] = gauges;
+        out["latency"] = Latency::to_json();
+        return out;
+    }
+
+private:
+    struct Shard {
+        std::array<std::atomic<uint64_t>, (int)Counter::COUNT> values{};
+    };
+
+    struct Gauge {
+        std::string name;
+        std::string help;
+        std::function<double()> fn;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards; // 執行緒結束後保留，數值不遺失
+        std::map<std::string, std::unique_ptr<CameraStats>> cameras;
+        std::map<int, uint64_t> end_codes;
+        std::vector<Gauge> gauges;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    struct CounterInfo {
+        const char* name;
+        const char* help;
+    };
+
+    struct GaugeValue {
+        std::string name;
+        std::string help;
+        double value;
+    };
+
+    struct Snapshot {
+        std::array<uint64_t, (int)Counter::COUNT> counters{};
+        std::map<int, uint64_t> end_codes;
+        std::map<std::string, std::pair<uint64_t, uint64_t>> cameras;
+        std::vector<GaugeValue> gauges;
+        double uptime_s = 0;
+    };
+
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    static Shard& local() {
+        thread_local Shard* shard = nullptr;
+        if (!shard) {
+            auto owned = std::make_unique<Shard>();
+            shard = owned.get();
+            auto& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.shards.push_back(std::move(owned));
+        }
+        return *shard;
+    }
+
+    static const CounterInfo& counter_info(Counter c) {
+        static const CounterInfo infos[] = {
+            {"lpsm_bus_enqueued_total", "Messages pushed onto the MessageBus"},
+            {"lpsm_bus_dropped_total", "Telemetry messages dropped because the lane was full (drop-oldest)"},
+            {"lpsm_bus_conflated_total", "Telemetry messages that replaced a queued message from the same source"},
+            {"lpsm_plc_reads_total", "PLC batch read cycles completed"},
+            {"lpsm_plc_writes_total", "PLC bit writes completed"},
+            {"lpsm_plc_errors_total", "PLC responses with a non-zero end code"},
+            {"lpsm_plc_reconnects_total", "PLC connection resets (timeout or socket error)"},
+            {"lpsm_ws_messages_sent_total", "WebSocket frames sent (per client)"},
+            {"lpsm_ws_bytes_sent_total", "WebSocket payload bytes sent (per client)"},
+            {"lpsm_ws_backpressure_drops_total", "WebSocket frames dropped due to client backpressure"},
+            {"lpsm_ws_commands_received_total", "WebSocket commands received from clients"},
+            {"lpsm_ws_conflated_total", "State frames replaced by a newer value while a client was backlogged"},
+            {"lpsm_ws_slow_client_closed_total", "Clients disconnected for exceeding the pending event limit"},
+            {"lpsm_ws_compressed_frames_total", "WebSocket frames sent compressed (permessage-deflate or binary deflate)"},
+        };
+        return infos[(int)c];
+    }
+
+    // Gauge 在鎖外計算，避免 callback 內再呼叫 Metrics 造成死鎖
+    static Snapshot collect() {
+        Snapshot snap;
+        std::vector<Gauge> gauges;
+        {
+            auto& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto& shard : r.shards) {
+                for (int i = 0; i < (int)Counter::COUNT; ++i) {
+                    snap.counters[i] += shard->values[i].load(std::memory_order_relaxed);
+                }
+            }
+            snap.end_codes = r.end_codes;
+            for (auto& [role, c] : r.cameras) {
+                snap.cameras[role] = {c->barcodes.load(std::memory_order_relaxed), c->timeouts.load(std::memory_order_relaxed)};
+            }
+            gauges = r.gauges;
+            snap.uptime_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - r.start).count();
+        }
+        for (auto& g : gauges) snap.gauges.push_back({g.name, g.help, g.fn()});
+        return snap;
+    }
+
+    static std::string hex_code(int code) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "%04X", code & 0xFFFF);
+        return buf;
+    }
+
+    static std::string fmt_double(double v) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", v);
+        return buf;
+    }
+};
\ No newline at end of file
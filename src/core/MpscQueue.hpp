@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// 無鎖 MPSC 佇列 (Vyukov intrusive 版本)
+// 多個執行緒可同時 push；只有單一消費者執行緒可以 pop
+// 注意：producer 交換 head 後、串上 next 前的極短時間內，pop 可能暫時看不到該節點，
+// 呼叫端需搭配「排程旗標」機制在 push 之後再喚醒消費者 (見 WsServer::broadcast)
+template <typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    std::atomic<Node*> head_; // producer 端
+    Node* tail_;              // consumer 端 (僅消費者存取)
+
+public:
+    MpscQueue() {
+        Node* stub = new Node();
+        head_.store(stub, std::memory_order_relaxed);
+        tail_ = stub;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        T discard;
+        while (pop(discard)) {}
+        delete tail_;
+    }
+
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& out) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(next->value);
+        next->value = T();
+        tail_ = next;
+        delete tail;
+        return true;
+    }
+};
\ No newline at end of file
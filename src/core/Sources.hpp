@@ -0,0 +1,140 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ==============================================================================
+// 訊息來源 / 類型 ID
+// 來源名稱 (PLC, SYS, CAMERA_LEFT_1 ...) 在登錄時轉成 16-bit ID，Message 只帶 ID；
+// 名稱與類別依 ID 分段 (每段 CHUNK 個) 存放，段在用到時才配置且位址不變，讀取不加鎖 (登錄後不再變動)
+// 一般 Hub 只用到第一段；彙總端每個 Hub 另外登錄 <hub>/<來源>，最多可用到整個 16-bit 範圍
+// ==============================================================================
+
+using SourceId = uint16_t;
+
+// 來源類別：Controller 路由表依此決定處理方式 (見 logic/Routes.hpp)
+enum class SourceKind : uint8_t {
+    OTHER = 0,
+    PLC,
+    WS,
+    SYS,
+    SCANNER,
+    CAMERA,         // CAMERA_*
+    CAMERA_MONITOR, // CAMERA_*_MONITOR
+    COUNT
+};
+
+enum class MsgType : uint8_t {
+    DATA = 0,
+    STATUS,       // PLC 讀取結果
+    CMD,          // 前端指令
+    DISCONNECTED, // 前端斷線
+    HEARTBEAT,
+    BARCODE,      // 相機條碼
+    TIMEOUT,      // 相機逾時 (TIMEOUT_BLANK)
+    STATE_SYNC,
+    COUNT
+};
+
+class Sources {
+public:
+    static constexpr size_t CHUNK = 1024;
+    static constexpr size_t MAX = size_t(1) << (8 * sizeof(SourceId)); // 65536
+
+    // 固定來源 (啟動時預先登錄，ID 不變)
+    static constexpr SourceId NONE = 0;
+    static constexpr SourceId PLC = 1;
+    static constexpr SourceId PLC_MONITOR = 2;
+    static constexpr SourceId WS = 3;
+    static constexpr SourceId SYS = 4;
+    static constexpr SourceId SCANNER = 5;
+
+    // 登錄 (或查詢) 來源，只在登錄時加鎖；超過 MAX 回傳 NONE
+    static SourceId id_of(std::string_view name) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        return r.intern(name);
+    }
+
+    static const std::string& name(SourceId id) {
+        auto& r = registry();
+        return id < r.count.load(std::memory_order_acquire) ? r.name_at(id) : r.name_at(NONE);
+    }
+
+    static SourceKind kind(SourceId id) {
+        auto& r = registry();
+        return id < r.count.load(std::memory_order_acquire) ? r.chunk(id).kinds[id % CHUNK] : SourceKind::OTHER;
+    }
+
+    // 已登錄數量 (新來源加入時遞增，WsServer 用來判斷是否要重送名稱表)
+    static size_t version() { return registry().count.load(std::memory_order_acquire); }
+
+    // ID 1..N 的名稱 (index = id - 1)
+    static std::vector<std::string> names() {
+        auto& r = registry();
+        size_t n = r.count.load(std::memory_order_acquire);
+        std::vector<std::string> out;
+        out.reserve(n ? n - 1 : 0);
+        for (size_t id = 1; id < n; ++id) out.push_back(r.name_at((SourceId)id));
+        return out;
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<std::string, SourceId> ids;
+        struct Chunk {
+            std::array<std::string, CHUNK> names;
+            std::array<SourceKind, CHUNK> kinds{};
+        };
+        std::array<std::unique_ptr<Chunk>, MAX / CHUNK> chunks; // 只增不減，count 公開前已配置
+        std::atomic<size_t> count{0};
+
+        Registry() {
+            for (const char* n : {"", "PLC", "PLC_MONITOR", "WS", "SYS", "SCANNER"}) intern(n);
+        }
+
+        SourceId intern(std::string_view name) {
+            auto it = ids.find(std::string(name));
+            if (it != ids.end()) return it->second;
+            size_t id = count.load(std::memory_order_relaxed);
+            if (id >= MAX) return NONE;
+            auto& c = chunks[id / CHUNK];
+            if (!c) c = std::make_unique<Chunk>();
+            c->names[id % CHUNK] = std::string(name);
+            c->kinds[id % CHUNK] = classify(name);
+            ids.emplace(c->names[id % CHUNK], (SourceId)id);
+            count.store(id + 1, std::memory_order_release); // 名稱寫完才公開
+            return (SourceId)id;
+        }
+
+        // 呼叫端須先確認 id < count
+        Chunk& chunk(size_t id) { return *chunks[id / CHUNK]; }
+        const std::string& name_at(SourceId id) { return chunk(id).names[id % CHUNK]; }
+    };
+
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    static SourceKind classify(std::string_view name) {
+        static constexpr std::string_view monitor_suffix = "_MONITOR";
+        if (name == "PLC") return SourceKind::PLC;
+        if (name == "WS") return SourceKind::WS;
+        if (name == "SYS") return SourceKind::SYS;
+        if (name == "SCANNER") return SourceKind::SCANNER;
+        if (name.substr(0, 6) == "CAMERA") {
+            bool monitor = name.size() > monitor_suffix.size() &&
+                           name.substr(name.size() - monitor_suffix.size()) == monitor_suffix;
+            return monitor ? SourceKind::CAMERA_MONITOR : SourceKind::CAMERA;
+        }
+        return SourceKind::OTHER;
+    }
+};
\ No newline at end of file
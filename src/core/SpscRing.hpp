@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 無鎖 SPSC 環形緩衝 (固定容量，不配置記憶體)
+// 只有單一生產者執行緒可以 push、單一消費者執行緒可以 pop；滿了 push 回傳 false (由呼叫端計數丟棄)
+// 用於不能等待的生產端，例如 Low-level Keyboard Hook 回呼 (見 KeyboardHook.hpp)
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+    std::array<T, N> slots_{};
+    alignas(64) std::atomic<uint64_t> head_{0}; // 生產者
+    alignas(64) std::atomic<uint64_t> tail_{0}; // 消費者
+
+public:
+    bool push(const T& value) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N) return false;
+        slots_[head & (N - 1)] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        out = slots_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return (size_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+
+    static constexpr size_t capacity() { return N; }
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include "core/Logger.hpp"
+
+// 啟動流程編排：每個步驟宣告相依關係，沒有相依的步驟並行執行，
+// 以 Readiness Probe 取代固定 sleep，並記錄每個階段耗時
+class StartupOrchestrator {
+public:
+    using Action = std::function<bool()>;
+
+    // critical = false：失敗只記錄警告，不影響整體結果 (相依它的步驟仍會被略過)
+    void add(std::string name, std::vector<std::string> deps, Action action, bool critical = true) {
+        steps_.push_back({std::move(name), std::move(deps), std::move(action), critical});
+    }
+
+    // 執行所有步驟，回傳是否所有 critical 步驟都成功
+    bool run() {
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+
+        for (auto& step : steps_) state_[step.name] = State::PENDING;
+        for (auto& step : steps_) {
+            for (auto& dep : step.deps) {
+                if (!state_.count(dep)) {
+                    spdlog::error("[Startup] Step '{}' depends on unknown step '{}'", step.name, dep);
+                    return false;
+                }
+            }
+        }
+
+        std::vector<std::thread> workers;
+        for (auto& step : steps_) {
+            workers.emplace_back([this, &step, t0]() {
+                if (!wait_deps(step)) {
+                    spdlog::warn("[Startup] {} skipped (dependency not ready)", step.name);
+                    finish(step, State::SKIPPED);
+                    return;
+                }
+
+                auto begin = clock::now();
+                bool ok = false;
+                try {
+                    ok = step.action();
+                } catch (const std::exception& e) {
+                    spdlog::error("[Startup] {} threw: {}", step.name, e.what());
+                }
+                auto end = clock::now();
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+                auto at = std::chrono::duration_cast<std::chrono::milliseconds>(end - t0).count();
+
+                if (ok) {
+                    spdlog::info("[Startup] {} ready in {} ms (t+{} ms)", step.name, ms, at);
+                } else if (step.critical) {
+                    spdlog::error("[Startup] {} FAILED after {} ms", step.name, ms);
+                } else {
+                    spdlog::warn("[Startup] {} not ready after {} ms (non-critical)", step.name, ms);
+                }
+                finish(step, ok ? State::DONE : State::FAILED);
+            });
+        }
+        for (auto& t : workers) t.join();
+
+        bool ok = true;
+        for (auto& step : steps_) {
+            if (step.critical && state_[step.name] != State::DONE) ok = false;
+        }
+        spdlog::info("[Startup] Completed in {} ms ({})",
+                     std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - t0).count(),
+                     ok ? "OK" : "FAILED");
+        return ok;
+    }
+
+    // ==========================================================================
+    // Readiness Probes
+    // ==========================================================================
+    static bool wait_until(const std::function<bool()>& probe, std::chrono::milliseconds timeout,
+                           std::chrono::milliseconds interval = std::chrono::milliseconds(50)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            if (probe()) return true;
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            std::this_thread::sleep_for(interval);
+        }
+    }
+
+    // 嘗試綁定 (不設 reuse_address)，成功代表沒有其他程式在 LISTEN
+    static bool port_free(int port) {
+        boost::asio::io_context ioc;
+        boost::asio::ip::tcp::acceptor probe(ioc);
+        boost::system::error_code ec;
+        probe.open(boost::asio::ip::tcp::v4(), ec);
+        if (ec) return false;
+        probe.bind(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), (unsigned short)port), ec);
+        return !ec;
+    }
+
+private:
+    enum class State { PENDING, DONE, FAILED, SKIPPED };
+
+    struct Step {
+        std::string name;
+        std::vector<std::string> deps;
+        Action action;
+        bool critical;
+    };
+
+    std::vector<Step> steps_;
+    std::unordered_map<std::string, State> state_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    // 等待所有相依步驟結束；任一相依未成功則回傳 false
+    bool wait_deps(const Step& step) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&]{
+            for (auto& dep : step.deps) {
+                if (state_[dep] == State::PENDING) return false;
+            }
+            return true;
+        });
+        for (auto& dep : step.deps) {
+            if (state_[dep] != State::DONE) return false;
+        }
+        return true;
+    }
+
+    void finish(const Step& step, State s) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_[step.name] = s;
+        }
+        cond_.notify_all();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// ==============================================================================
+// 相機 TCP 條碼分框
+// TCP 是位元組串流：一次 read 可能只有半個條碼，也可能含多個條碼
+//   - 以 CR / LF 分框，未結尾的部分留到下次 read
+//   - 從未收過結尾的相機 (舊機種)：由 CamSession 在短暫無資料後呼叫 flush()，
+//     把累積的內容視為一個條碼 (needs_flush() 判斷)
+// 只處理位元組，不含 Socket：CamSession 與 bench/lpsm_bench 共用
+// ==============================================================================
+
+class BarcodeFramer {
+public:
+    static constexpr size_t MAX_PENDING = 1024; // 超過仍未結尾視為雜訊，整段丟棄
+
+    // on_barcode(std::string&&) 對每個完整且非空的條碼呼叫一次
+    template <typename F>
+    void feed(const char* data, size_t len, F&& on_barcode) {
+        size_t begin = 0;
+        for (size_t i = 0; i < len; ++i) {
+            char c = data[i];
+            if (c != '\r' && c != '\n') continue;
+            terminated_ = true;
+            pending_.append(data + begin, i - begin);
+            begin = i + 1;
+            if (!pending_.empty()) {
+                on_barcode(std::move(pending_));
+                pending_.clear();
+            }
+        }
+        pending_.append(data + begin, len - begin);
+        if (pending_.size() > MAX_PENDING) {
+            pending_.clear();
+            ++discarded_;
+        }
+    }
+
+    // 只有從未收過結尾的相機需要以逾時分框；有結尾的相機，未結尾的部分一律等下次 read
+    bool needs_flush() const { return !terminated_ && !pending_.empty(); }
+
+    template <typename F>
+    void flush(F&& on_barcode) {
+        if (pending_.empty()) return;
+        on_barcode(std::move(pending_));
+        pending_.clear();
+    }
+
+    size_t pending() const { return pending_.size(); }
+    size_t discarded() const { return discarded_; }
+
+private:
+    std::string pending_;
+    bool terminated_ = false;
+    size_t discarded_ = 0;
+};
\ No newline at end of file
@@ -1,36 +1,53 @@
 #pragma once
 #include <boost/asio.hpp>
+#include <future>
+#include <memory>
 #include <spdlog/spdlog.h>
 #include "core/MessageBus.hpp"
 #include "core/Config.hpp" // 需要讀取 Config
+#include "core/Metrics.hpp"
+#include "core/BinLog.hpp"
+#include "driver/BarcodeFramer.hpp"
 
 using boost::asio::ip::tcp;
 
 class CamSession : public std::enable_shared_from_this<CamSession> {
+    static constexpr int FLUSH_MS = 30;
+
     tcp::socket socket_;
     std::shared_ptr<MessageBus> bus_;
     char data_[1024];
+    BarcodeFramer framer_; // 以 CR / LF 分框 (一次 read 可能有半個或多個條碼)
     boost::asio::steady_timer timeout_timer_;
+    boost::asio::steady_timer flush_timer_;  // 無結尾的舊機種：短暫無資料後才把累積內容視為一個條碼
+    uint64_t pending_rx_ns_ = 0;             // 未分框內容最後一次 read 的時間
     std::string client_id_;
+    std::string ip_;
+    Metrics::CameraStats* stats_ = nullptr; // 依角色計數 (角色變更時重新取得)
+    SourceId source_ = Sources::NONE;         // client_id_ / client_id_ + "_MONITOR" 的來源 ID
+    SourceId monitor_source_ = Sources::NONE;
 
 public:
-    CamSession(tcp::socket socket, std::shared_ptr<MessageBus> bus, boost::asio::io_context& ioc) : socket_(std::move(socket)), bus_(bus), timeout_timer_(ioc) {
+    CamSession(tcp::socket socket, std::shared_ptr<MessageBus> bus, boost::asio::io_context& ioc) : socket_(std::move(socket)), bus_(bus), timeout_timer_(ioc), flush_timer_(ioc) {
         // ✅ [關鍵] 取得 IP 並映射到 Config 中的名稱 (e.g. CAMERA_LEFT_1)
         try {
-            std::string ip = socket_.remote_endpoint().address().to_string();
-            auto& mapping = Config::get().camera_mapping;
-            
-            // 如果 Config 有設定這個 IP，就使用設定的名稱 (如 CAMERA_LEFT_1)
-            // 這樣前端 App.vue: if (source.startsWith("CAMERA_LEFT")) 才能正確運作
-            if (mapping.count(ip)) {
-                client_id_ = mapping[ip];
-            } else {
-                client_id_ = "CAMERA_UNKNOWN_" + ip;
-                spdlog::warn("[CAM] Unknown Camera IP: {}, please check config.json", ip);
-            }
+            ip_ = socket_.remote_endpoint().address().to_string();
+            client_id_ = resolve_role(*Config::get());
         } catch(...) {
             client_id_ = "CAMERA_ERROR";
         }
+        bind_role();
+    }
+
+    // 設定熱更新：重新對應角色，連線不中斷 (由 CamServer 在 io 執行緒呼叫)
+    void remap(const Config::AppConfig& cfg) {
+        if (ip_.empty()) return;
+        std::string next = resolve_role(cfg);
+        if (next != client_id_) {
+            spdlog::info("[CAM] Role remapped: {} -> {}", client_id_, next);
+            client_id_ = std::move(next);
+            bind_role();
+        }
     }
 
     void start() {
@@ -39,34 +56,74 @@ public:
         reset_timeout();
     }
 
+    // 關閉流程：停止收資料 (未分框的內容由讀取錯誤處理送出)
+    void stop() {
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+    }
+
 private:
+    // 角色確定時才登錄來源 ID，收到條碼 / 逾時時不再做字串處理
+    void bind_role() {
+        stats_ = &Metrics::camera(client_id_);
+        source_ = Sources::id_of(client_id_);
+        monitor_source_ = Sources::id_of(client_id_ + "_MONITOR");
+    }
+
+    std::string resolve_role(const Config::AppConfig& cfg) const {
+        // 如果 Config 有設定這個 IP，就使用設定的名稱 (如 CAMERA_LEFT_1)
+        // 這樣前端 App.vue: if (source.startsWith("CAMERA_LEFT")) 才能正確運作
+        auto it = cfg.camera_mapping.find(ip_);
+        if (it != cfg.camera_mapping.end()) return it->second;
+
+        spdlog::warn("[CAM] Unknown Camera IP: {}, please check config", ip_);
+        return "CAMERA_UNKNOWN_" + ip_;
+    }
+
     void do_read() {
         auto self(shared_from_this());
         socket_.async_read_some(boost::asio::buffer(data_), [this, self](boost::system::error_code ec, std::size_t length) {
             if (!ec) {
-                std::string barcode(data_, length);
-                // 移除換行符
-                barcode.erase(std::remove(barcode.begin(), barcode.end(), '\n'), barcode.end());
-                barcode.erase(std::remove(barcode.begin(), barcode.end(), '\r'), barcode.end());
-                
-                if (!barcode.empty()) {
-                    spdlog::info("[CAM] {} Recv: {}", client_id_, barcode);
-                    // ✅ 直接送字串，Controller 不用處理，WsServer 會自動轉發給前端
-                    bus_->push({ client_id_, "BARCODE", barcode });
+                uint64_t rx_ns = trace_now_ns();
+                framer_.feed(data_, length, [this, rx_ns](std::string&& barcode) { emit(std::move(barcode), rx_ns); });
+                if (framer_.needs_flush()) {
+                    pending_rx_ns_ = rx_ns;
+                    flush_timer_.expires_after(std::chrono::milliseconds(FLUSH_MS));
+                    flush_timer_.async_wait([this, self](boost::system::error_code ec) {
+                        if (!ec && framer_.needs_flush()) framer_.flush([this](std::string&& barcode) { emit(std::move(barcode), pending_rx_ns_); });
+                    });
                 }
                 
                 reset_timeout();
                 do_read();
+            } else {
+                // 斷線：停止逾時計時，Session 才會釋放 (否則每 10 秒仍會對已斷線的相機送出 TIMEOUT_BLANK)
+                timeout_timer_.cancel();
+                flush_timer_.cancel();
+                if (framer_.needs_flush()) framer_.flush([this](std::string&& barcode) { emit(std::move(barcode), pending_rx_ns_); });
+                if (ec != boost::asio::error::operation_aborted) {
+                    spdlog::info("[CAM] Disconnected: {} ({})", client_id_, ec.message());
+                }
             }
         });
     }
 
+    void emit(std::string&& barcode, uint64_t rx_ns) {
+        LPSM_LOG(LogModule::CAM, spdlog::level::info, "[CAM] {} Recv: {}", client_id_, barcode);
+        // ✅ 直接送字串，Controller 不用處理，WsServer 會自動轉發給前端
+        Message msg{ source_, MsgType::BARCODE, std::move(barcode) };
+        msg.trace.rx = rx_ns;
+        bus_->push(std::move(msg));
+        stats_->barcodes.fetch_add(1, std::memory_order_relaxed);
+    }
+
     void reset_timeout() {
         timeout_timer_.expires_after(std::chrono::seconds(10));
         timeout_timer_.async_wait([this, self=shared_from_this()](boost::system::error_code ec){
             if (!ec) {
                 // Send timeout signal
-                bus_->push({ client_id_ + "_MONITOR", "TIMEOUT", "TIMEOUT_BLANK" });
+                bus_->push({ monitor_source_, MsgType::TIMEOUT, "TIMEOUT_BLANK" });
+                stats_->timeouts.fetch_add(1, std::memory_order_relaxed);
                 // Start timer again
                 reset_timeout();
             }
@@ -78,19 +135,57 @@ class CamServer {
     boost::asio::io_context& ioc_;
     tcp::acceptor acceptor_;
     std::shared_ptr<MessageBus> bus_;
+    std::vector<std::weak_ptr<CamSession>> sessions_; // 僅在 io 執行緒存取
 
 public:
     CamServer(boost::asio::io_context& ioc, std::shared_ptr<MessageBus> bus, int port) : ioc_(ioc), acceptor_(ioc, tcp::endpoint(tcp::v4(), port)), bus_(bus) {
+        // ✅ 設定熱更新：切回 io 執行緒重新對應所有現存連線的角色
+        Config::subscribe([this](const Config::Snapshot& cfg) {
+            boost::asio::post(ioc_, [this, cfg]() { remap_sessions(*cfg); });
+        });
         do_accept();
     }
 
+    // 關閉流程 (任意執行緒)：停止接受新連線並關閉所有相機連線，
+    // 等到各連線的讀取回呼 (含未分框內容) 都已推入 Bus 才返回
+    bool stop(std::chrono::milliseconds timeout) {
+        auto done = std::make_shared<std::promise<void>>();
+        auto result = done->get_future();
+        boost::asio::post(ioc_, [this, done]() {
+            boost::system::error_code ignored;
+            acceptor_.close(ignored);
+            for (auto& weak : sessions_) {
+                if (auto session = weak.lock()) session->stop();
+            }
+            // 排在各連線的 operation_aborted 回呼之後
+            boost::asio::post(ioc_, [done]() { done->set_value(); });
+        });
+        return result.wait_for(timeout) == std::future_status::ready;
+    }
+
 private:
     void do_accept() {
         acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket) {
+            if (!acceptor_.is_open()) return; // 關閉流程
             if (!ec) {
-                std::make_shared<CamSession>(std::move(socket), bus_, ioc_)->start();
+                auto session = std::make_shared<CamSession>(std::move(socket), bus_, ioc_);
+                prune_sessions();
+                sessions_.push_back(session);
+                session->start();
             }
             do_accept();
         });
     }
+
+    void remap_sessions(const Config::AppConfig& cfg) {
+        prune_sessions();
+        for (auto& weak : sessions_) {
+            if (auto session = weak.lock()) session->remap(cfg);
+        }
+    }
+
+    void prune_sessions() {
+        sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+            [](const std::weak_ptr<CamSession>& w) { return w.expired(); }), sessions_.end());
+    }
 };
\ No newline at end of file
@@ -1,112 +1,99 @@
 #pragma once
 #include <windows.h>
-#include <iostream>
+#include <atomic>
+#include <cstdlib>
 #include <string>
 #include <thread>
 #include "core/MessageBus.hpp"
 #include "core/Logger.hpp"
+#include "core/Metrics.hpp"
+#include "core/Lifecycle.hpp"
+#include "core/SpscRing.hpp"
+#include "driver/ScannerDecoder.hpp"
 
 // 全域變數是 Windows Hook 的限制，因為 Callback 必須是靜態的
+// ✅ 回呼內只做「寫入 ring + SetEvent」：超過 LowLevelHooksTimeout 的 Hook 會被 Windows 靜默移除，
+//    而且回呼的任何延遲都會拖慢全系統的按鍵；字元轉換、分辨掃碼槍 / 人手、Log、推入 Bus 都在背景執行緒
 static HHOOK g_hHook = NULL;
-static std::shared_ptr<MessageBus> g_bus_ref = nullptr;
-static std::string g_barcode_buffer;
-static std::mutex g_hook_mutex;
+static SpscRing<KeyEvent, 4096> g_key_ring;   // 生產者：Hook 執行緒；消費者：解碼執行緒
+static std::atomic<uint64_t> g_key_dropped{0}; // ring 滿而丟棄的按鍵
+static HANDLE g_key_event = NULL;              // 喚醒解碼執行緒 (auto-reset)
+static std::atomic<DWORD> g_hook_thread_id{0};  // stop() 以 WM_QUIT 結束 Message Loop
 
 // 鍵盤鉤子回呼函式
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HC_ACTION) {
         KBDLLHOOKSTRUCT *p = (KBDLLHOOKSTRUCT *)lParam;
+        bool down = (wParam == WM_KEYDOWN);
+        bool up = (wParam == WM_KEYUP || wParam == WM_SYSKEYUP); // Shift 放開 (解碼端自行追蹤大小寫)
 
-        if (wParam == WM_KEYDOWN) {
-            DWORD vkCode = p->vkCode;
-
-            // 1. 處理 Enter (掃碼結束)
-            if (vkCode == VK_RETURN) {
-                std::lock_guard<std::mutex> lock(g_hook_mutex);
-                if (!g_barcode_buffer.empty()) {
-                    // ✅ [需求2] 掃到條碼直接輸出文字
-                    spdlog::info("[Scanner] Detected: {}", g_barcode_buffer);
-                    
-                    if (g_bus_ref) {
-                        if (g_barcode_buffer.compare("0") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: TIMEOUT_BLANK");
-                            g_bus_ref->push({"CAMERA_LEFT_GROUP_MONITOR", "DATA", "TIMEOUT_BLANK"});
-                            g_bus_ref->push({"CAMERA_RIGHT_GROUP_MONITOR", "DATA", "TIMEOUT_BLANK"});
-                        }
-                        else if (g_barcode_buffer.compare("1") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: 4240912013144");
-                            g_bus_ref->push({"CAMERA_LEFT_1", "DATA", "4240912013144"});
-                        }
-                        else if (g_barcode_buffer.compare("2") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: 4240912012548");
-                            g_bus_ref->push({"CAMERA_RIGHT_1", "DATA", "4240912012548"});
-                        }
-                        else if (g_barcode_buffer.compare("3") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: 4240913025717");
-                            g_bus_ref->push({"CAMERA_RIGHT_1", "DATA", "4240913025717"});
-                        }
-                        else if (g_barcode_buffer.compare("4") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: 4240914001156");
-                            g_bus_ref->push({"CAMERA_RIGHT_2", "DATA", "4240914001156"});
-                        }
-                        else if (g_barcode_buffer.compare("5") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: : 4251122021288");
-                            g_bus_ref->push({"CAMERA_LEFT_1", "DATA", "4251122021288"});
-                        }
-                        else if (g_barcode_buffer.compare("7") == 0) {
-                            spdlog::info("[Broadcast] Camera Test Input: : 9999999999996");
-                            g_bus_ref->push({"CAMERA_LEFT_1", "DATA", "9999999999996"});
-                        }
-                        else if (g_barcode_buffer.compare("6") == 0) {
-                            spdlog::info("[Broadcast] Keyboard Input: : Y04900132");
-                            g_bus_ref->push({"SCANNER", "DATA", "Y04900132"});
-                        }
-                        else {
-                            spdlog::info("[Broadcast] Keyboard Input: {}", g_barcode_buffer);
-                            g_bus_ref->push({"SCANNER", "DATA", g_barcode_buffer});
-                        }
-                    }
-                    g_barcode_buffer.clear();
-                }
-            }
-            // 2. 處理一般字元 (0-9, A-Z)
-            else {
-                // 取得鍵盤狀態 (處理 Shift 大小寫)
-                BYTE keyboardState[256];
-                GetKeyboardState(keyboardState);
-                WORD asciiBuffer[2];
-                
-                // 轉換 Virtual Key 為 ASCII
-                int len = ToAscii(vkCode, p->scanCode, keyboardState, asciiBuffer, 0);
-                if (len == 1) {
-                    char c = (char)asciiBuffer[0];
-                    // 過濾掉不可見字元，只留條碼常用的數字與字母
-                    if (isalnum(c) || c == '-' || c == '_') {
-                        std::lock_guard<std::mutex> lock(g_hook_mutex);
-                        g_barcode_buffer += c;
-                    }
-                }
+        if (down || up) {
+            if (g_key_ring.push({(uint32_t)p->vkCode, (uint32_t)p->scanCode, trace_now_ns(), down})) {
+                SetEvent(g_key_event);
+            } else {
+                g_key_dropped.fetch_add(1, std::memory_order_relaxed);
             }
         }
     }
-    // 3. 重要：傳遞給下一個鉤子，確保不阻擋使用者打字
+    // 重要：傳遞給下一個鉤子，確保不阻擋使用者打字
     return CallNextHookEx(g_hHook, nCode, wParam, lParam);
 }
 
 class KeyboardHook {
+    std::shared_ptr<MessageBus> bus_;
+    ScannerDecoder::Options options_;
+    bool accept_typed_ = false; // 人手輸入 (非掃碼槍速度) 是否也當作掃碼送出
+    std::atomic<bool> running_{true};
+
+    // 測試用輸入：在 Hub 電腦上手打單一數字 + Enter，模擬相機 / 掃碼槍
+    struct TestInput {
+        const char* key;
+        const char* source;
+        const char* payload;
+    };
+    static constexpr TestInput TEST_INPUTS[] = {
+        {"0", "CAMERA_LEFT_GROUP_MONITOR", "TIMEOUT_BLANK"},
+        {"0", "CAMERA_RIGHT_GROUP_MONITOR", "TIMEOUT_BLANK"},
+        {"1", "CAMERA_LEFT_1", "4240912013144"},
+        {"2", "CAMERA_RIGHT_1", "4240912012548"},
+        {"3", "CAMERA_RIGHT_1", "4240913025717"},
+        {"4", "CAMERA_RIGHT_2", "4240914001156"},
+        {"5", "CAMERA_LEFT_1", "4251122021288"},
+        {"7", "CAMERA_LEFT_1", "9999999999996"},
+        {"6", "SCANNER", "Y04900132"},
+    };
+
 public:
-    KeyboardHook(std::shared_ptr<MessageBus> bus) {
-        g_bus_ref = bus;
+    // 環境變數 (皆可省略)：
+    //   LPSM_SCANNER_GAP_MS      掃碼槍相鄰按鍵最大間隔 (預設 35)
+    //   LPSM_SCANNER_TIMEOUT_MS  每筆條碼逾時 (預設 500)
+    //   LPSM_SCANNER_ACCEPT_TYPED=1  人手輸入也送出 (舊行為)
+    KeyboardHook(std::shared_ptr<MessageBus> bus) : bus_(bus) {
+        if (const char* v = std::getenv("LPSM_SCANNER_GAP_MS")) options_.scanner_gap_ms = (uint32_t)std::atoi(v);
+        if (const char* v = std::getenv("LPSM_SCANNER_TIMEOUT_MS")) options_.timeout_ms = (uint32_t)std::atoi(v);
+        if (const char* v = std::getenv("LPSM_SCANNER_ACCEPT_TYPED")) accept_typed_ = std::atoi(v) != 0;
+
+        g_key_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+        Metrics::gauge("lpsm_scanner_keys_dropped", "Key events dropped because the hook ring was full", []{
+            return (double)g_key_dropped.load(std::memory_order_relaxed);
+        });
     }
 
-    // 啟動 Hook 執行緒
+    // 啟動 Hook 執行緒與解碼執行緒
     void start() {
+        std::thread([this](){
+            ThreadTopology::apply(ThreadRole::DECODE);
+            decode_loop();
+        }).detach();
+
         std::thread t([](){
+            ThreadTopology::apply(ThreadRole::HOOK);
+            g_hook_thread_id = GetCurrentThreadId();
             spdlog::info("[Hook] Starting Global Keyboard Hook...");
-            
+
             // 安裝鉤子
             g_hHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, GetModuleHandle(NULL), 0);
-            
+
             if (!g_hHook) {
                 spdlog::error("[Hook] Failed to install hook!");
                 return;
@@ -123,4 +110,59 @@ public:
         });
         t.detach(); // 讓它在背景跑
     }
+
+    // 關閉流程：移除 Hook (不再收按鍵)，解碼執行緒處理完 ring 內剩餘按鍵後結束
+    void stop() {
+        if (DWORD id = g_hook_thread_id.exchange(0)) PostThreadMessage(id, WM_QUIT, 0, 0);
+        running_ = false;
+        SetEvent(g_key_event);
+    }
+
+private:
+    void decode_loop() {
+        spdlog::info("[Hook] Scanner decoder started (gap {} ms, timeout {} ms, typed input {})",
+                     options_.scanner_gap_ms, options_.timeout_ms, accept_typed_ ? "accepted" : "ignored");
+        ScannerDecoder decoder(options_);
+        decoder.set_caps_lock(GetKeyState(VK_CAPITAL) & 1);
+
+        KeyEvent ev;
+        bool last = false;
+        while (!last) {
+            // 逾時醒來也要 poll，讓閒置的殘留內容及時丟棄
+            WaitForSingleObject(g_key_event, 100);
+            last = !running_; // 收到 stop 後清完 ring 即結束
+            while (g_key_ring.pop(ev)) {
+                decoder.feed(ev, [this](ScannerDecoder::Result&& r) { dispatch(std::move(r)); });
+            }
+            decoder.poll(trace_now_ns());
+        }
+    }
+
+    void dispatch(ScannerDecoder::Result&& r) {
+        // 測試輸入 (單一數字，必定是人手輸入)
+        bool test_input = false;
+        for (const auto& t : TEST_INPUTS) {
+            if (r.text != t.key) continue;
+            test_input = true;
+            spdlog::info("[Broadcast] Test Input {}: {} -> {}", t.key, t.source, t.payload);
+            push(Sources::id_of(t.source), t.payload, r.enter_ns);
+        }
+        if (test_input) return;
+
+        if (r.kind == ScannerDecoder::Kind::TYPED && !accept_typed_) {
+            LPSM_LOG(LogModule::SCANNER, spdlog::level::debug, "[Scanner] Ignored typed input ({} chars, max gap {} ms)",
+                     r.text.size(), r.max_gap_ns / 1000000);
+            return;
+        }
+
+        // ✅ [需求2] 掃到條碼直接輸出文字
+        LPSM_LOG(LogModule::SCANNER, spdlog::level::info, "[Scanner] Detected: {}", r.text);
+        push(Sources::SCANNER, std::move(r.text), r.enter_ns);
+    }
+
+    void push(SourceId source, std::string payload, uint64_t rx_ns) {
+        Message msg{source, MsgType::DATA, std::move(payload)};
+        msg.trace.rx = rx_ns; // Enter 按下的時間
+        bus_->push(std::move(msg));
+    }
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ==============================================================================
+// MC Protocol (3E Frame, Binary) 封包建立與回應解析
+// 只處理位元組，不含 Socket：PlcClient 與 bench/lpsm_bench 共用
+// ==============================================================================
+
+class McProtocol {
+public:
+    static constexpr size_t RESPONSE_HEADER = 11; // 副標頭 ~ End Code
+
+    // Batch Read (0401)，Sub: Bit (0001)，Device M
+    static std::vector<uint8_t> build_read_packet(int start_addr, int count) {
+        std::vector<uint8_t> packet = {
+            0x50, 0x00, 0x00, 0xFF, 0xFF, 0x03, 0x00, 0x0C, 0x00, 0x10, 0x00,
+            0x01, 0x04, 0x01, 0x00,
+            (uint8_t)(start_addr & 0xFF), (uint8_t)((start_addr >> 8) & 0xFF), 0x00,
+            0x90, (uint8_t)(count & 0xFF), (uint8_t)((count >> 8) & 0xFF)
+        };
+        return packet;
+    }
+
+    static std::vector<uint8_t> build_write_packet(int addr, bool on) {
+        std::vector<uint8_t> packet = {
+            0x50, 0x00, 0x00, 0xFF, 0xFF, 0x03, 0x00,
+            0x0D, 0x00, // 長度 13 (正確)
+            0x10, 0x00, // Timer
+            0x01, 0x14, 0x01, 0x00, // Cmd: Batch Write (1401), Sub: Bit (0001)
+            (uint8_t)(addr & 0xFF), (uint8_t)((addr >> 8) & 0xFF), 0x00,
+            0x90, // Device M
+            0x01, 0x00, // Count 1
+
+            // ✅ [修正]
+            // MC Protocol 規定：第一個點位在 High Nibble (0x10)，而非 Low Nibble (0x01)
+            (uint8_t)(on ? 0x10 : 0x00)
+        };
+        return packet;
+    }
+
+    // Bit 讀取回應的完整長度：Header (11 bytes) + Data ((數量 + 1) / 2)
+    static size_t read_response_len(int count) { return RESPONSE_HEADER + (size_t)(count + 1) / 2; }
+
+    // End Code (Header 最後 2 bytes)；長度不足視為 0
+    static int end_code(const uint8_t* buf, size_t len) {
+        return len >= RESPONSE_HEADER ? (buf[9] | (buf[10] << 8)) : 0;
+    }
+
+    // 讀取回應中的 Bit：每 byte 兩點
+    // ✅ [關鍵修正] Mitsubishi 規則：偶數 Offset 在高位，奇數 Offset 在低位
+    static bool bit(const std::vector<uint8_t>& raw, int base_addr, int target_addr) {
+        int offset = target_addr - base_addr;
+        if (offset < 0) return false;
+
+        size_t byte_idx = (size_t)offset / 2;
+        if (byte_idx >= raw.size()) return false;
+
+        uint8_t val = raw[byte_idx];
+        // 偶數偏移 (例如 M542, M500) -> 取高 4 位；奇數偏移 (例如 M503, M545) -> 取低 4 位
+        return (offset % 2 == 0) ? ((val >> 4) & 0x01) : (val & 0x01);
+    }
+};
\ No newline at end of file
@@ -4,13 +4,26 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <atomic>
 #include "core/MessageBus.hpp"
+#include "core/Config.hpp"
+#include "core/Metrics.hpp"
 #include <spdlog/spdlog.h>
+#include "core/BinLog.hpp"
+#include "driver/McProtocol.hpp"
+#include "logic/Sinks.hpp"
 #include <unordered_map>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
 
 using boost::asio::ip::tcp;
 
-class PlcClient {
+class PlcClient : public PlcSink {
+public:
+    using WriteResult = PlcWriteResult;
+
 private:
     boost::asio::io_context& ioc_;
     tcp::socket socket_;
@@ -20,7 +33,9 @@ private:
     boost::asio::steady_timer timer_;    // 用於重連延遲
     boost::asio::steady_timer op_timer_; // ✅ 新增：用於單次操作超時
     boost::asio::steady_timer reset_timer_;
-    bool connected_ = false;
+    std::atomic<bool> connected_{false}; // io 執行緒寫入，啟動流程讀取
+    
+    uint64_t last_read_ns_ = 0; // 上次讀取完成時間 (計算輪詢週期)
     
     int start_addr_ = 0;
     int read_count_ = 0;
@@ -31,8 +46,13 @@ private:
     struct WriteCommand {
         int address;
         bool on;
+        uint64_t trace_rx_ns = 0; // 反向路徑追蹤：前端指令收到時間 (0 = 不追蹤)
+        WriteCallback on_done;    // PLC 回應 (或連線錯誤) 時回呼
     };
     std::queue<WriteCommand> write_queue_;
+    bool write_in_flight_ = false; // 僅 io 執行緒存取
+    bool cycle_waiting_ = false;   // 兩次輪詢之間的等待 (安全寫入可提前結束)，僅 io 執行緒存取
+    uint64_t cycle_gen_ = 0;       // 辨識已被提前結束的等待
 
 public:
     PlcClient(boost::asio::io_context& ioc, std::shared_ptr<MessageBus> bus, std::string ip, int port) 
@@ -44,26 +64,23 @@ public:
             spdlog::error("[PLC] Invalid IP Address: {}", ip);
         }
 
-        auto& pts = Config::get().points;
-        int min_addr = std::min({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start});
-        int max_addr = std::max({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start});
+        // ✅ 設定熱更新：切回 io 執行緒重新規劃讀取範圍 / 端點
+        // 先訂閱再讀目前設定：ConfigWatcher 已在執行，兩者之間的發布不會漏掉 (apply_config 重複套用無副作用)
+        Config::subscribe([this](const Config::Snapshot& cfg) {
+            boost::asio::post(ioc_, [this, cfg]() { apply_config(*cfg); });
+        });
 
-        addr_trigger_ = pts.write_trigger;
-        addr_result_  = pts.write_result;
-        
-        start_addr_ = (min_addr / 100) * 100;
-        int needed = max_addr - start_addr_ + 20;
-        read_count_ = (needed < 100) ? 100 : needed; 
-        
-        spdlog::info("[PLC] Auto-Range: Start M{}, Count {}", start_addr_, read_count_);
+        plan_read_range(Config::get()->points);
     }
 
+    bool is_connected() const { return connected_; }
+
     void start() { 
         boost::asio::post(ioc_, [this]() { do_connect(); });
     }
 
     // 用於：系統啟動、PLC 重連、WS 斷線
-    void reset_safe_signals() {
+    void reset_safe_signals() override {
         boost::asio::post(ioc_, [this]() {
             spdlog::warn("[PLC] Resetting Safe Signals (M{}, M{} -> OFF)", addr_trigger_, addr_result_);
             
@@ -74,9 +91,35 @@ public:
 
             write_queue_.push({addr_result_, false});
             sent_state_cache_[addr_result_] = false;
+            wake_for_write();
         });
     }
 
+    // 關閉流程 (任意執行緒)：送出安全訊號 OFF，等待寫入佇列清空 (含傳送中的那筆)
+    // 回傳 false：PLC 未連線或逾時，剩餘寫入遺失
+    bool flush(std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        reset_safe_signals();
+        while (true) {
+            auto pending = std::make_shared<std::promise<size_t>>();
+            auto result = pending->get_future();
+            boost::asio::post(ioc_, [this, pending]() {
+                pending->set_value(write_queue_.size() + (write_in_flight_ ? 1 : 0));
+            });
+            if (result.wait_until(deadline) != std::future_status::ready) break;
+            size_t count = result.get();
+            if (count == 0) return true;
+            if (!connected_) {
+                spdlog::error("[PLC] Not connected. {} pending write(s) dropped.", count);
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (std::chrono::steady_clock::now() >= deadline) break;
+        }
+        spdlog::error("[PLC] Write queue not flushed within {} ms", timeout.count());
+        return false;
+    }
+
     void write_bit(int address, bool on) {
         boost::asio::post(ioc_, [this, address, on]() {
             // 檢查緩存：如果狀態一樣，則忽略 (減少 PLC 負擔)
@@ -90,21 +133,27 @@ public:
         });
     }
 
-    void write_pulse_pair(int addr1, bool val1, int addr2, bool val2) {
-        boost::asio::post(ioc_, [this, addr1, val1, addr2, val2]() {
+    // 參數說明見 PlcSink
+    void write_pulse_pair(int addr1, bool val1, int addr2, bool val2, uint64_t trace_rx_ns = 0, WriteCallback on_done = nullptr) override {
+        boost::asio::post(ioc_, [this, addr1, val1, addr2, val2, trace_rx_ns, on_done = std::move(on_done)]() {
             // 1. 取消上一次的計時 (防止舊的 OFF 訊號干擾新的觸發)
             reset_timer_.cancel();
 
             // 2. 寫入當前訊號 (ON) - 這裡做「狀態過濾」
             // 如果已經是 ON，就不重複送封包，但「計時器」必須重啟
-            if (!sent_state_cache_.count(addr1) || sent_state_cache_[addr1] != val1) {
-                write_queue_.push({addr1, val1});
+            // 追蹤時間戳掛在這組最後一筆實際送出的寫入上
+            bool write1 = !sent_state_cache_.count(addr1) || sent_state_cache_[addr1] != val1;
+            bool write2 = !sent_state_cache_.count(addr2) || sent_state_cache_[addr2] != val2;
+            if (write1) {
+                write_queue_.push({addr1, val1, write2 ? 0 : trace_rx_ns, write2 ? nullptr : on_done});
                 sent_state_cache_[addr1] = val1;
             }
-            if (!sent_state_cache_.count(addr2) || sent_state_cache_[addr2] != val2) {
-                write_queue_.push({addr2, val2});
+            if (write2) {
+                write_queue_.push({addr2, val2, trace_rx_ns, on_done});
                 sent_state_cache_[addr2] = val2;
             }
+            if (!write1 && !write2 && on_done) on_done({WriteResult::UNCHANGED});
+            if (write1 || write2) wake_for_write();
             
             // 3. 設定 2秒倒數，時間到後自動 OFF
             reset_timer_.expires_after(std::chrono::seconds(2));
@@ -121,6 +170,7 @@ public:
 
                     write_queue_.push({addr2, false});
                     sent_state_cache_[addr2] = false; 
+                    wake_for_write();
                     
                     // spdlog::info("[PLC] Pulse Auto-Reset Done"); // Log 可選
                 }
@@ -129,6 +179,51 @@ public:
     }
 
 private:
+    void plan_read_range(const Config::PlcPoints& pts) {
+        int min_addr = std::min({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start});
+        int max_addr = std::max({pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start});
+
+        addr_trigger_ = pts.write_trigger;
+        addr_result_  = pts.write_result;
+
+        start_addr_ = (min_addr / 100) * 100;
+        int needed = max_addr - start_addr_ + 20;
+        read_count_ = (needed < 100) ? 100 : needed;
+
+        spdlog::info("[PLC] Auto-Range: Start M{}, Count {}", start_addr_, read_count_);
+    }
+
+    // 在 io 執行緒執行：下一次讀取即使用新範圍，不中斷連線
+    void apply_config(const Config::AppConfig& cfg) {
+        int old_trigger = addr_trigger_;
+        int old_result = addr_result_;
+        plan_read_range(cfg.points);
+
+        // 寫入點位變更：舊點位先復歸，避免殘留 ON
+        if (old_trigger != addr_trigger_ || old_result != addr_result_) {
+            reset_timer_.cancel();
+            for (int addr : {old_trigger, old_result}) {
+                write_queue_.push({addr, false});
+                sent_state_cache_.erase(addr);
+            }
+            reset_safe_signals();
+        }
+
+        // 只有 PLC 端點變更才需要重連
+        tcp::endpoint next;
+        try {
+            next = tcp::endpoint(boost::asio::ip::make_address(cfg.plc_ip), cfg.plc_port);
+        } catch (...) {
+            spdlog::error("[PLC] Invalid IP Address: {}", cfg.plc_ip);
+            return;
+        }
+        if (next != endpoint_) {
+            spdlog::warn("[PLC] Endpoint changed to {}:{}. Reconnecting...", cfg.plc_ip, cfg.plc_port);
+            endpoint_ = next;
+            if (connected_) socket_.close(); // 觸發 handle_error -> 重連
+        }
+    }
+
     void do_connect() {
         spdlog::info("[PLC] Connecting to {}...", endpoint_.address().to_string());
         
@@ -167,7 +262,7 @@ private:
         if (!write_queue_.empty()) {
             auto cmd = write_queue_.front();
             write_queue_.pop();
-            do_write_request(cmd.address, cmd.on);
+            do_write_request(cmd);
         } else {
             do_read_request();
         }
@@ -185,32 +280,52 @@ private:
     }
 
     // --- 寫入流程 ---
-    void do_write_request(int addr, bool on) {
-        auto packet = build_write_packet(addr, on);
+    void do_write_request(const WriteCommand& cmd) {
+        auto packet = McProtocol::build_write_packet(cmd.address, cmd.on);
         auto buf = std::make_shared<std::vector<uint8_t>>(packet);
+        uint64_t sent_ns = trace_now_ns();
+        write_in_flight_ = true;
 
         start_op_timeout(); // 啟動計時
 
         boost::asio::async_write(socket_, boost::asio::buffer(*buf),
-            [this, buf, addr, on](boost::system::error_code ec, std::size_t) {
+            [this, buf, cmd, sent_ns](boost::system::error_code ec, std::size_t) {
                 if (!ec) {
-                    do_write_response(addr, on);
+                    do_write_response(cmd, sent_ns);
                 } else {
+                    write_in_flight_ = false;
+                    if (cmd.on_done) cmd.on_done({WriteResult::IO_ERROR});
                     handle_error(ec);
                 }
             });
     }
 
-    void do_write_response(int addr, bool on) {
+    void do_write_response(const WriteCommand& cmd, uint64_t sent_ns) {
         auto buf = std::make_shared<std::vector<uint8_t>>(1024);
         socket_.async_read_some(boost::asio::buffer(*buf),
-            [this, buf, addr, on](boost::system::error_code ec, std::size_t len) {
+            [this, buf, cmd, sent_ns](boost::system::error_code ec, std::size_t len) {
                 op_timer_.cancel(); // 操作完成，取消計時
+                write_in_flight_ = false;
 
                 if (!ec) {
-                    spdlog::info("[PLC] Write Success: M{} -> {}", addr, on ? "ON" : "OFF");
+                    uint64_t now = trace_now_ns();
+                    Latency::stage(Stage::PLC_WRITE_RTT).record_ns(sent_ns, now);
+                    Latency::stage(Stage::CMD_TO_PLC_ACK).record_ns(cmd.trace_rx_ns, now);
+                    Metrics::inc(Counter::PLC_WRITES);
+
+                    int end_code = McProtocol::end_code(buf->data(), len);
+                    if (end_code != 0) {
+                        spdlog::error("[PLC] Write Error Code: {:04X} (M{})", end_code, cmd.address);
+                        Metrics::plc_end_code(end_code);
+                    } else {
+                        LPSM_LOG(LogModule::PLC, spdlog::level::info, "[PLC] Write Success: M{} -> {}", cmd.address, cmd.on ? "ON" : "OFF");
+                    }
+                    if (cmd.on_done) {
+                        cmd.on_done({end_code ? WriteResult::PLC_ERROR : WriteResult::OK, end_code, now - sent_ns});
+                    }
                     schedule_next_cycle(50); 
                 } else {
+                    if (cmd.on_done) cmd.on_done({WriteResult::IO_ERROR});
                     handle_error(ec);
                 }
             });
@@ -218,46 +333,56 @@ private:
 
     // --- 讀取流程 ---
     void do_read_request() {
-        auto packet = build_read_packet(start_addr_, read_count_);
+        // 記下本次請求的範圍 (設定熱更新可能在回應前改變成員變數)
+        int start_addr = start_addr_;
+        int count = read_count_;
+        auto packet = McProtocol::build_read_packet(start_addr, count);
         auto buf = std::make_shared<std::vector<uint8_t>>(packet);
+        uint64_t sent_ns = trace_now_ns();
         
         start_op_timeout(); // 啟動計時
 
-        boost::asio::async_write(socket_, boost::asio::buffer(*buf), [this, buf](boost::system::error_code ec, std::size_t) {
+        boost::asio::async_write(socket_, boost::asio::buffer(*buf), [this, buf, start_addr, count, sent_ns](boost::system::error_code ec, std::size_t) {
             if (!ec) {
-                do_read_response();
+                do_read_response(start_addr, count, sent_ns);
             } else {
                 handle_error(ec);
             }
         });
     }
 
-    void do_read_response() {
-        auto buf = std::make_shared<std::vector<uint8_t>>(1024);
-        
+    void do_read_response(int start_addr, int count, uint64_t sent_ns) {
         // 計算預期收到的總長度
-        // Header (11 bytes) + Data ((數量 + 1) / 2)
-        int data_len = (read_count_ + 1) / 2; 
-        int expected_len = 11 + data_len;
+        size_t expected_len = McProtocol::read_response_len(count);
+        auto buf = std::make_shared<std::vector<uint8_t>>(std::max<size_t>(1024, expected_len));
 
         // ✅ [修正 1] 改用 async_read 並指定 transfer_exactly，確保讀完完整封包
         boost::asio::async_read(socket_, boost::asio::buffer(*buf), 
             boost::asio::transfer_exactly(expected_len),
-            [this, buf, expected_len](boost::system::error_code ec, std::size_t len) {
+            [this, buf, expected_len, start_addr, sent_ns](boost::system::error_code ec, std::size_t len) {
                 
                 op_timer_.cancel(); // 操作完成，取消計時
 
                 if (!ec) {
+                    uint64_t rx_ns = trace_now_ns();
+                    Latency::stage(Stage::PLC_READ_RTT).record_ns(sent_ns, rx_ns);
+                    Latency::stage(Stage::PLC_CYCLE).record_ns(last_read_ns_, rx_ns);
+                    last_read_ns_ = rx_ns;
+                    Metrics::inc(Counter::PLC_READS);
+
                     // 檢查 End Code (Header 最後 2 bytes)
-                    int end_code = buf->at(9) | (buf->at(10) << 8);
+                    int end_code = McProtocol::end_code(buf->data(), len);
                     
                     if (end_code != 0) {
                         spdlog::error("[PLC] Read Error Code: {:04X}", end_code);
+                        Metrics::plc_end_code(end_code);
                     }
-                    else if (len >= 11) { 
+                    else if (len >= McProtocol::RESPONSE_HEADER) { 
                         // 擷取資料區段
-                        std::vector<uint8_t> data(buf->begin() + 11, buf->begin() + 11 + (len - 11));
-                        bus_->push({"PLC", "STATUS", json{{"raw", data}, {"start_addr", start_addr_}}});
+                        std::vector<uint8_t> data(buf->begin() + McProtocol::RESPONSE_HEADER, buf->begin() + len);
+                        Message msg{Sources::PLC, MsgType::STATUS, json{{"raw", data}, {"start_addr", start_addr}}};
+                        msg.trace.rx = rx_ns;
+                        bus_->push(std::move(msg));
                     }
                     schedule_next_cycle(200);
                 } else {
@@ -267,12 +392,26 @@ private:
     }
 
     void schedule_next_cycle(int ms) {
+        cycle_waiting_ = true;
+        uint64_t gen = ++cycle_gen_;
         timer_.expires_after(std::chrono::milliseconds(ms));
-        timer_.async_wait([this](boost::system::error_code ec){
-            if (!ec) process_next_action();
+        timer_.async_wait([this, gen](boost::system::error_code ec){
+            if (ec || gen != cycle_gen_ || !cycle_waiting_) return; // 已被 wake_for_write 接手
+            cycle_waiting_ = false;
+            process_next_action();
         });
     }
 
+    // 安全寫入 (GO_NOGO、復歸) 不等輪詢間隔，直接送出
+    // 過載時 io 執行緒忙於相機，PLC 週期被拉長，寫入延遲仍只取決於 PLC 本身的回應
+    void wake_for_write() {
+        if (!cycle_waiting_ || !connected_) return;
+        cycle_waiting_ = false;
+        ++cycle_gen_;
+        timer_.cancel();
+        process_next_action();
+    }
+
     void handle_error(boost::system::error_code ec) {
         // ✅ 修正：如果是被 Timer 強制 close 的，ec 會是 operation_aborted (或其他)，這時我們不能 return，要繼續跑重連流程
         if (ec == boost::asio::error::operation_aborted && connected_) {
@@ -289,6 +428,9 @@ private:
         }
         
         connected_ = false;
+        cycle_waiting_ = false;
+        last_read_ns_ = 0;
+        Metrics::inc(Counter::PLC_RECONNECTS);
         socket_.close();
         op_timer_.cancel(); // 確保計時器也停掉
         
@@ -296,32 +438,4 @@ private:
         timer_.expires_after(std::chrono::seconds(3));
         timer_.async_wait([this](boost::system::error_code){ do_connect(); });
     }
-
-    // (封包建立函式保持不變)
-    std::vector<uint8_t> build_read_packet(int start_addr, int count) {
-        std::vector<uint8_t> packet = {
-            0x50, 0x00, 0x00, 0xFF, 0xFF, 0x03, 0x00, 0x0C, 0x00, 0x10, 0x00,
-            0x01, 0x04, 0x01, 0x00,
-            (uint8_t)(start_addr & 0xFF), (uint8_t)((start_addr >> 8) & 0xFF), 0x00,
-            0x90, (uint8_t)(count & 0xFF), (uint8_t)((count >> 8) & 0xFF)
-        };
-        return packet;
-    }
-
-    std::vector<uint8_t> build_write_packet(int addr, bool on) {
-        std::vector<uint8_t> packet = {
-            0x50, 0x00, 0x00, 0xFF, 0xFF, 0x03, 0x00,
-            0x0D, 0x00, // 長度 13 (正確)
-            0x10, 0x00, // Timer
-            0x01, 0x14, 0x01, 0x00, // Cmd: Batch Write (1401), Sub: Bit (0001)
-            (uint8_t)(addr & 0xFF), (uint8_t)((addr >> 8) & 0xFF), 0x00,
-            0x90, // Device M
-            0x01, 0x00, // Count 1
-            
-            // ✅ [修正] 
-            // MC Protocol 規定：第一個點位在 High Nibble (0x10)，而非 Low Nibble (0x01)
-            (uint8_t)(on ? 0x10 : 0x00) 
-        };
-        return packet;
-    }
 };
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ==============================================================================
+// 掃碼槍鍵盤輸入解碼 (與平台無關)
+// Keyboard Hook 只把按鍵事件放進 SPSC ring，由背景執行緒交給這裡：
+//   - 自行追蹤 Shift / Caps Lock，把 Virtual Key 轉成字元 (掃碼槍模擬美式鍵盤，只保留 0-9 A-Z a-z - _)
+//   - Enter 結束一筆；依按鍵間隔分辨掃碼槍 (連續快速輸入) 與人手打字
+//   - 每筆有逾時：按鍵間閒置超過 timeout 的殘留內容丟棄，避免人手打到一半的字元黏到下一筆條碼前面；
+//     仍是掃碼槍速度 (間隔都在 scanner_gap 內) 卻持續超過 timeout 未按 Enter 的整筆丟棄到下一個 Enter 為止
+//     (人手打字一筆本來就會超過 timeout，只套用閒置逾時)
+// 可用合成的按鍵序列在 Linux 測試 / Benchmark (bench/lpsm_bench 的 scanner.*)
+// ==============================================================================
+
+struct KeyEvent {
+    uint32_t vk = 0;    // Windows Virtual-Key Code
+    uint32_t scan = 0;  // Scan Code (保留供除錯)
+    uint64_t t_ns = 0;  // trace_now_ns()
+    bool down = true;   // WM_KEYDOWN / WM_KEYUP
+};
+
+class ScannerDecoder {
+public:
+    // Windows Virtual-Key Code (與 winuser.h 相同數值)
+    static constexpr uint32_t KEY_ENTER = 0x0D;
+    static constexpr uint32_t KEY_SHIFT = 0x10;
+    static constexpr uint32_t KEY_CAPS_LOCK = 0x14;
+    static constexpr uint32_t KEY_NUMPAD0 = 0x60;
+    static constexpr uint32_t KEY_NUMPAD9 = 0x69;
+    static constexpr uint32_t KEY_NUMPAD_MINUS = 0x6D;
+    static constexpr uint32_t KEY_LSHIFT = 0xA0;
+    static constexpr uint32_t KEY_RSHIFT = 0xA1;
+    static constexpr uint32_t KEY_MINUS = 0xBD;
+
+    struct Options {
+        uint32_t scanner_gap_ms = 35; // 掃碼槍相鄰按鍵 (含 Enter) 的最大間隔
+        uint32_t timeout_ms = 500;    // 按鍵間的閒置上限；掃碼槍連續輸入從第一個字元到 Enter 的上限
+        size_t min_length = 4;        // 短於此長度一律視為人手輸入
+        size_t max_length = 128;
+    };
+
+    enum class Kind { SCANNER, TYPED };
+
+    struct Result {
+        std::string text;
+        Kind kind = Kind::SCANNER;
+        uint64_t first_ns = 0;  // 第一個字元
+        uint64_t enter_ns = 0;  // Enter
+        uint64_t max_gap_ns = 0;
+    };
+
+    struct Stats {
+        uint64_t scans = 0;    // 掃碼槍
+        uint64_t typed = 0;    // 人手輸入 (Enter 結束)
+        uint64_t stale = 0;    // 閒置逾時丟棄
+        uint64_t overlong = 0; // 掃碼槍速度的連續輸入超過 timeout 丟棄
+    };
+
+    ScannerDecoder() = default;
+    explicit ScannerDecoder(const Options& opt) : opt_(opt) {}
+
+    // 啟動時以系統目前的 Caps Lock 狀態初始化
+    void set_caps_lock(bool on) { caps_ = on; }
+
+    // on_result(Result&&)：每個 Enter 結束的非空輸入呼叫一次
+    template <typename F>
+    void feed(const KeyEvent& ev, F&& on_result) {
+        if (ev.vk == KEY_SHIFT || ev.vk == KEY_LSHIFT || ev.vk == KEY_RSHIFT) {
+            shift_ = ev.down;
+            return;
+        }
+        if (!ev.down) return;
+        if (ev.vk == KEY_CAPS_LOCK) {
+            caps_ = !caps_;
+            return;
+        }
+
+        expire(ev.t_ns);
+
+        if (ev.vk == KEY_ENTER) {
+            bool skipped = skip_until_enter_;
+            skip_until_enter_ = false;
+            if (skipped || buffer_.empty()) {
+                reset();
+                return;
+            }
+            Result r;
+            r.first_ns = first_ns_;
+            r.enter_ns = ev.t_ns;
+            r.max_gap_ns = std::max(max_gap_ns_, ev.t_ns - last_ns_);
+            bool burst = r.max_gap_ns <= (uint64_t)opt_.scanner_gap_ms * 1000000ULL && buffer_.size() >= opt_.min_length;
+            r.kind = burst ? Kind::SCANNER : Kind::TYPED;
+            ++(burst ? stats_.scans : stats_.typed);
+            r.text = std::move(buffer_);
+            reset();
+            on_result(std::move(r));
+            return;
+        }
+
+        char c = translate(ev.vk, shift_, caps_);
+        if (c == 0 || skip_until_enter_) return;
+        if (buffer_.empty()) {
+            first_ns_ = ev.t_ns;
+        } else {
+            max_gap_ns_ = std::max(max_gap_ns_, ev.t_ns - last_ns_);
+        }
+        last_ns_ = ev.t_ns;
+        if (buffer_.size() < opt_.max_length) buffer_ += c;
+    }
+
+    // 沒有按鍵時由背景執行緒定期呼叫，讓閒置的殘留內容及時丟棄
+    void poll(uint64_t now_ns) { expire(now_ns); }
+
+    // 條碼允許的字元；其餘 (含 Shift + 數字的符號) 回傳 0
+    static char translate(uint32_t vk, bool shift, bool caps) {
+        if (vk >= '0' && vk <= '9') return shift ? 0 : (char)vk;
+        if (vk >= 'A' && vk <= 'Z') return (shift != caps) ? (char)vk : (char)(vk - 'A' + 'a');
+        if (vk >= KEY_NUMPAD0 && vk <= KEY_NUMPAD9) return (char)('0' + (vk - KEY_NUMPAD0));
+        if (vk == KEY_NUMPAD_MINUS) return '-';
+        if (vk == KEY_MINUS) return shift ? '_' : '-';
+        return 0;
+    }
+
+    size_t pending() const { return buffer_.size(); }
+    const Stats& stats() const { return stats_; }
+    const Options& options() const { return opt_; }
+
+private:
+    Options opt_;
+    Stats stats_;
+    std::string buffer_;
+    uint64_t first_ns_ = 0;
+    uint64_t last_ns_ = 0;
+    uint64_t max_gap_ns_ = 0;
+    bool shift_ = false;
+    bool caps_ = false;
+    bool skip_until_enter_ = false;
+
+    void expire(uint64_t now_ns) {
+        if (buffer_.empty()) return;
+        uint64_t timeout_ns = (uint64_t)opt_.timeout_ms * 1000000ULL;
+        if (now_ns > last_ns_ && now_ns - last_ns_ > timeout_ns) {
+            ++stats_.stale;
+            reset();
+            return;
+        }
+        // 到目前為止 (含這次按鍵前的間隔) 仍是掃碼槍速度才檢查整筆長度
+        uint64_t gap_ns = std::max(max_gap_ns_, now_ns > last_ns_ ? now_ns - last_ns_ : 0);
+        if (gap_ns <= (uint64_t)opt_.scanner_gap_ms * 1000000ULL && now_ns > first_ns_ && now_ns - first_ns_ > timeout_ns) {
+            ++stats_.overlong;
+            reset();
+            skip_until_enter_ = true;
+        }
+    }
+
+    void reset() {
+        buffer_.clear();
+        first_ns_ = last_ns_ = max_gap_ns_ = 0;
+    }
+};
\ No newline at end of file
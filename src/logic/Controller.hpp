@@ -1,111 +1,237 @@
 #pragma once
 #include <memory>
-#include <fstream>      // ✅ [新增] 檔案讀寫
-#include <filesystem>   // ✅ [新增] 檢查檔案存在
 #include "core/MessageBus.hpp"
-#include "driver/PlcClient.hpp"
 #include "core/Config.hpp"
-#include "server/WsServer.hpp"
+#include "core/Capture.hpp"
+#include "core/LoadShed.hpp"
+#include "server/Topics.hpp"
+#include "driver/McProtocol.hpp"
+#include "logic/OfflineCache.hpp"
+#include "logic/Routes.hpp"
+#include "logic/SignalHistory.hpp"
+#include "logic/Sinks.hpp"
 
 class Controller {
 private:
     std::shared_ptr<MessageBus> bus_;
-    std::shared_ptr<PlcClient> plc_;
-    std::shared_ptr<WsServer> ws_server_;
+    std::shared_ptr<PlcSink> plc_;       // 實際執行為 PlcClient，重播時為 Stub
+    std::shared_ptr<WsSink> ws_server_;  // 實際執行為 WsServer，重播時為 Stub
+    std::shared_ptr<CaptureWriter> capture_; // 開啟 Bus 擷取時才有
 
     // ✅ 新增：紀錄上一次的 PLC 狀態與 Log 時間
-    json last_plc_state_;
+    int last_plc_bits_ = -1; // 上一次廣播的 PLC 狀態 (WsFrame::PLC_FIELDS 位元)
     std::chrono::steady_clock::time_point last_log_time_;
+    std::chrono::steady_clock::time_point last_latency_log_time_;
 
-    const std::string CACHE_FILE = "offline_data.json";
+    std::vector<std::string> topics_; // 來源 ID -> 推播主題 (第一次推播時建立)
+
+    OfflineCache cache_;
+
+    SignalHistory history_; // PLC 點位 / 相機讀取歷史 (SIGNAL_HISTORY 查詢)
+    std::unique_ptr<HistorySpill> spill_; // LPSM_HISTORY_DIR 設定時才有
+    std::chrono::seconds spill_interval_{60};
+    std::chrono::steady_clock::time_point last_spill_time_;
+    int64_t last_spill_ms_ = 0;
+
+    // 降載中 (core/LoadShed.hpp)：相機監控事件每個來源只保留最新一筆，離線快取廣播延到恢復後
+    std::unordered_map<SourceId, Message> held_monitor_;
+    std::chrono::steady_clock::time_point last_monitor_flush_;
+    bool cache_load_deferred_ = false;
+    static constexpr std::chrono::milliseconds SHED_POLL{100}; // 有累積工作時檢查降載解除的間隔
 
 public:
-    Controller(std::shared_ptr<MessageBus> bus, std::shared_ptr<PlcClient> plc, std::shared_ptr<WsServer> ws) : bus_(bus), plc_(plc), ws_server_(ws) {
+    Controller(std::shared_ptr<MessageBus> bus, std::shared_ptr<PlcSink> plc, std::shared_ptr<WsSink> ws,
+               std::string cache_path = "offline_data.json")
+        : bus_(bus), plc_(plc), ws_server_(ws), cache_(std::move(cache_path)) {
         last_log_time_ = std::chrono::steady_clock::now();
+        last_latency_log_time_ = last_log_time_;
+
+        // ✅ 相機角色在設定載入時就登錄來源 ID (熱更新新增的角色同樣預先登錄)
+        register_camera_sources(*Config::get());
+        Config::subscribe([](const Config::Snapshot& cfg) { register_camera_sources(*cfg); });
+
+        Metrics::gauge("lpsm_offline_cache_bytes", "Size of the offline cache file", [cache = cache_]{
+            return (double)cache.size_bytes();
+        });
+
+        // LPSM_HISTORY_DIR=<dir>：每 LPSM_HISTORY_SPILL_SEC 秒 (預設 60) 把這段時間的訊號歷史寫到磁碟
+        if (const char* dir = std::getenv("LPSM_HISTORY_DIR")) {
+            if (const char* v = std::getenv("LPSM_HISTORY_SPILL_SEC")) spill_interval_ = std::chrono::seconds(std::max(1, std::atoi(v)));
+            spill_ = std::make_unique<HistorySpill>(dir);
+            last_spill_ms_ = history_.now_ms();
+        }
+        last_spill_time_ = std::chrono::steady_clock::now();
     }
 
+    // 需在 run() 之前設定
+    void set_capture(std::shared_ptr<CaptureWriter> capture) { capture_ = std::move(capture); }
+
     void run() {
         Message msg;
-        while (bus_->pop(msg)) {
-            try {
-                // 1. PLC 狀態更新 (由後端主動推播)
-                if (msg.source == "PLC" && msg.type == "STATUS") {
-                    handle_plc_update(msg.payload);
-                }
-                // 2. 前端指令處理
-                else if (msg.source == "WS" && msg.type == "CMD") {
-                    handle_ws_command(msg.payload);
-                }
-                else if (msg.source == "WS" && msg.type == "DISCONNECTED") {
+        for (;;) {
+            // 有降載累積的工作時不等下一則訊息：定時醒來補送，安靜的產線恢復後也不會卡到下一次心跳
+            MessageBus::Pop got;
+            if (has_shed_work()) {
+                got = bus_->pop_for(msg, shed_wait());
+            } else {
+                got = bus_->pop(msg) ? MessageBus::Pop::MESSAGE : MessageBus::Pop::STOPPED;
+            }
+            if (got == MessageBus::Pop::STOPPED) break;
+            if (got == MessageBus::Pop::TIMEOUT) {
+                release_shed_work();
+                continue;
+            }
+            if (capture_) capture_->record(msg);
+            process(msg);
+        }
+    }
+
+    // 關閉流程：run() 結束 (Bus 已清空) 後呼叫，確保離線快取 / 訊號歷史已寫到磁碟
+    bool sync_cache() {
+        if (spill_) {
+            spill_history();
+            spill_->stop();
+        }
+        if (cache_.sync()) return true;
+        spdlog::error("[Controller] Failed to sync offline cache {}", cache_.path());
+        return false;
+    }
+
+    // 處理單則訊息 (run() 與離線重播共用)
+    void process(Message& msg) {
+        try {
+            if (has_shed_work()) release_shed_work();
+
+            // 路由規則集中在 logic/Routes.hpp，這裡只查表
+            SourceKind kind = Sources::kind(msg.source);
+            const Route& route = ROUTES.at(kind, msg.type);
+            if (kind == SourceKind::CAMERA && msg.payload.is_string()) {
+                history_.record_camera(msg.source, msg.payload.get_ref<const std::string&>(), false, msg.trace.rx);
+            } else if (kind == SourceKind::CAMERA_MONITOR && msg.type == MsgType::TIMEOUT) {
+                history_.record_camera(msg.source, {}, true, msg.trace.rx);
+            }
+
+            switch (route.handler) {
+                case Handler::PLC_STATUS:
+                    handle_plc_update(msg.payload, msg.trace); // 由 handle_plc_update 自行決定是否廣播
+                    break;
+                case Handler::WS_COMMAND:
+                    handle_ws_command(msg);
+                    break;
+                case Handler::WS_DISCONNECTED:
                     spdlog::warn("[Controller] UI Disconnected. Safety Reset Triggered.");
                     plc_->reset_safe_signals();
-                }
-                // 3. 掃碼槍輸入 (純轉發，邏輯在前端)
-                else if (msg.source == "SCANNER") {
-                    spdlog::info("[Controller] Scanner Input Triggered");
-                }
+                    break;
+                case Handler::SCANNER_INPUT:
+                    LPSM_LOG(LogModule::CTRL, spdlog::level::info, "[Controller] Scanner Input Triggered"); // 純轉發，邏輯在前端
+                    break;
+                case Handler::NONE:
+                    break;
+            }
 
-                // 4. 統一廣播路由 (Routing)
-                // 決定哪些訊息要轉發給前端
-                bool should_broadcast = (
-                    msg.source == "SYS" || 
-                    msg.source == "WS" || 
-                    // msg.source == "PLC_MONITOR" || // ⚠️ 修改：PLC 改由 handle_plc_update 內部控制廣播
-                    msg.source == "SCANNER" ||
-                    msg.source.rfind("CAMERA", 0) == 0 
-                );
-
-                if (should_broadcast) {
-                    json wrapper;
-                    if (msg.type == "HEARTBEAT") {
-                        if (msg.source == "SYS") continue; 
-                    } 
-                    else if (msg.type == "STATE_SYNC") {
-                        wrapper = {{"type", "control"}, {"command", "STATE_SYNC"}, {"payload", msg.payload}};
-                    }
-                    else {
-                        wrapper = {{"type", "data"}, {"source", msg.source}, {"payload", msg.payload}};
-                    }
-                    
-                    if (!wrapper.empty()) {
-                        ws_server_->broadcast(wrapper.dump());
-                    }
+            if (route.broadcast) {
+                if (kind == SourceKind::CAMERA_MONITOR && LoadShed::active(Shed::MONITOR)) {
+                    held_monitor_[msg.source] = msg; // 由 release_shed_work 每個視窗推播一次
+                } else {
+                    broadcast(msg, route.delivery);
                 }
-
-            } catch (const std::exception& e) {
-                spdlog::error("Controller error: {}", e.what());
             }
+
+        } catch (const std::exception& e) {
+            spdlog::error("Controller error: {}", e.what());
         }
+
+        record_latency(msg.trace);
     }
 
 private:
-    // 處理 PLC 訊號 -> 判斷是否變更 -> 廣播 & Log
-    void handle_plc_update(const json& payload) {
-        auto raw = payload["raw"].get<std::vector<uint8_t>>();
-        int base_addr = payload["start_addr"].get<int>();
-        auto& pts = Config::get().points;
-
-        // ✅ 通用 Bit 解析函式
-        auto get_bit = [&](int target_addr) {
-            int offset = target_addr - base_addr;
-            if (offset < 0) return false;
+    void broadcast(Message& msg, Delivery delivery) {
+        // 編碼 (JSON 文字 / 二進位) 延後到 WS 執行緒依 Client 需要才做
+        WsFrame frame = (msg.type == MsgType::STATE_SYNC) ? WsFrame::control("STATE_SYNC", msg.payload)
+                                                          : WsFrame::data(msg.source, msg.payload);
+        msg.trace.done = trace_now_ns();
+        ws_server_->publish(topic_of(msg.source), std::move(frame), msg.trace, delivery);
+    }
 
-            int byte_idx = offset / 2;
-            if (byte_idx >= raw.size()) return false;
+    bool has_shed_work() const { return !held_monitor_.empty() || cache_load_deferred_; }
 
-            uint8_t val = raw[byte_idx];
-            
-            // ✅ [關鍵修正] Mitsubishi 規則：偶數 Offset 在高位，奇數 Offset 在低位
-            bool is_even_offset = (offset % 2 == 0);
+    // 下一次該檢查的時間：監控視窗到期，或最多 SHED_POLL 偵測降載解除
+    std::chrono::milliseconds shed_wait() const {
+        auto wait = SHED_POLL;
+        if (!held_monitor_.empty() && LoadShed::active(Shed::MONITOR)) {
+            auto due = last_monitor_flush_ + LoadShed::monitor_window() - std::chrono::steady_clock::now();
+            wait = std::min(wait, std::max(std::chrono::milliseconds(0), std::chrono::duration_cast<std::chrono::milliseconds>(due)));
+        }
+        return wait;
+    }
 
-            if (is_even_offset) {
-                // 偶數偏移 (例如 M542, M500) -> 取高 4 位
-                return (bool)((val >> 4) & 0x01);
-            } else {
-                // 奇數偏移 (例如 M503, M545) -> 取低 4 位
-                return (bool)(val & 0x01);
+    // 降載期間累積的工作：監控事件每 LoadShed::monitor_window 推播一次，解除降載後立即補送
+    void release_shed_work() {
+        if (!held_monitor_.empty()) {
+            auto now = std::chrono::steady_clock::now();
+            if (!LoadShed::active(Shed::MONITOR) || now - last_monitor_flush_ >= LoadShed::monitor_window()) {
+                for (auto& [source, held] : held_monitor_) broadcast(held, Delivery::STATE);
+                held_monitor_.clear();
+                last_monitor_flush_ = now;
             }
-        };
+        }
+        if (cache_load_deferred_ && !LoadShed::active(Shed::CACHE)) {
+            cache_load_deferred_ = false;
+            spdlog::info("[Controller] Load shedding released. Broadcasting deferred offline cache.");
+            load_offline_cache();
+        }
+    }
+
+    static void register_camera_sources(const Config::AppConfig& cfg) {
+        for (const auto& [ip, role] : cfg.camera_mapping) {
+            Sources::id_of(role);
+            Sources::id_of(role + "_MONITOR");
+        }
+    }
+
+    const std::string& topic_of(SourceId source) {
+        if (source >= topics_.size()) topics_.resize(source + 1);
+        std::string& topic = topics_[source];
+        if (topic.empty()) topic = Topics::for_source(Sources::name(source));
+        return topic;
+    }
+
+    // 記錄 Bus 前半段各階段延遲，並每 60 秒在 Terminal 輸出一次摘要
+    void record_latency(const TraceStamps& trace) {
+        uint64_t now = trace_now_ns();
+        Latency::stage(Stage::DEVICE_TO_BUS).record_ns(trace.rx, trace.enq);
+        Latency::stage(Stage::BUS_WAIT).record_ns(trace.enq, trace.deq);
+        Latency::stage(Stage::CONTROLLER).record_ns(trace.deq, now);
+
+        auto tp = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::seconds>(tp - last_latency_log_time_).count() >= 60) {
+            spdlog::info("[Latency] {}", Latency::summary());
+            last_latency_log_time_ = tp;
+        }
+        if (spill_ && tp - last_spill_time_ >= spill_interval_) {
+            spill_history();
+            last_spill_time_ = tp;
+        }
+    }
+
+    // 上次寫出之後的歷史交給背景執行緒寫檔
+    void spill_history() {
+        if (!spill_) return;
+        int64_t now = history_.now_ms();
+        spill_->submit(history_.query(last_spill_ms_, now));
+        last_spill_ms_ = now + 1;
+    }
+
+    // 處理 PLC 訊號 -> 判斷是否變更 -> 廣播 & Log
+    void handle_plc_update(const json& payload, TraceStamps trace) {
+        auto raw = payload["raw"].get<std::vector<uint8_t>>();
+        int base_addr = payload["start_addr"].get<int>();
+        auto cfg = Config::get(); // 本次處理期間固定使用同一份快照
+        const auto& pts = cfg->points;
+
+        // ✅ 通用 Bit 解析 (Mitsubishi 偶數 Offset 在高位，見 McProtocol::bit)
+        auto get_bit = [&](int target_addr) { return McProtocol::bit(raw, base_addr, target_addr); };
+        history_.record_plc(raw, base_addr, pts, trace.rx);
 
         // 使用 DB 設定的點位來取值
         bool up_in  = get_bit(pts.up_in);
@@ -114,76 +240,131 @@ private:
         bool dn_out = get_bit(pts.dn_out);
         bool start  = get_bit(pts.start);
 
-        json plc_data = {
-            {"up_in", up_in ? 1 : 0},
-            {"up_out", up_out ? 1 : 0},
-            {"dn_in", dn_in ? 1 : 0},
-            {"dn_out", dn_out ? 1 : 0},
-            {"start_message", start ? 1 : 0}
-        };
+        // 依 WsFrame::PLC_FIELDS 順序打包 (up_in, up_out, dn_in, dn_out, start_message)
+        uint8_t bits = (up_in ? 0x01 : 0) | (up_out ? 0x02 : 0) | (dn_in ? 0x04 : 0) |
+                       (dn_out ? 0x08 : 0) | (start ? 0x10 : 0);
 
         // ✅ 優化 1: 只有狀態「變更」時才廣播給前端 (減少網路與 Log 垃圾)
-        if (plc_data != last_plc_state_) {
-            spdlog::info("[PLC] Status Changed: {}", plc_data.dump());
+        if (bits != last_plc_bits_) {
+            WsFrame frame = WsFrame::plc_state(Sources::PLC_MONITOR, bits);
+            LPSM_LOG(LogModule::PLC, spdlog::level::info, "[PLC] Status Changed: up_in={} up_out={} dn_in={} dn_out={} start_message={}",
+                     up_in, up_out, dn_in, dn_out, start);
             
             // 手動觸發廣播 (因為 run() loop 裡把 PLC_MONITOR 的自動廣播關了)
-            json wrapper = {{"type", "data"}, {"source", "PLC_MONITOR"}, {"payload", plc_data}};
-            ws_server_->broadcast(wrapper.dump());
+            trace.done = trace_now_ns();
+            ws_server_->publish(Topics::plc(cfg->hub_ip), std::move(frame), trace, Delivery::STATE);
             
-            last_plc_state_ = plc_data;
+            last_plc_bits_ = bits;
         }
 
         // ✅ 優化 2: 每 5 秒在 Terminal 顯示一次狀態 (Heartbeat Log)
         auto now = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::seconds>(now - last_log_time_).count() >= 5) {
-            spdlog::info("[PLC] Monitor (5s): {}", plc_data.dump());
+            spdlog::info("[PLC] Monitor (5s): {}", WsFrame::plc_state(Sources::PLC_MONITOR, bits).to_json()["payload"].dump());
             last_log_time_ = now;
         }
     }
 
-    void handle_ws_command(const json& cmd) {
-        std::string command = cmd.value("command", "");
+    void handle_ws_command(const Message& msg) {
+        Command command = msg.command;
+        const json& cmd = msg.payload;
 
-        if (command == "GO_NOGO") {
+        if (command == Command::GO_NOGO) {
             int val = cmd.value("payload", 0); // 1=OK, 0=NG
-            auto& pts = Config::get().points;
+            auto cfg = Config::get();
+            const auto& pts = cfg->points;
 
-            spdlog::info("[Controller] Writing GO_NOGO: {}", val ? "OK" : "NG");
+            LPSM_LOG(LogModule::CTRL, spdlog::level::info, "[Controller] Writing GO_NOGO: {}", val ? "OK" : "NG");
 
-            plc_->write_pulse_pair(pts.write_trigger, val == 1, pts.write_result, true);
+            // 帶 request_id 時，等 PLC 寫入回應 (End Code) 後才回覆 CMD_ACK
+            PlcSink::WriteCallback on_done;
+            if (!msg.request_id.empty()) {
+                on_done = [ws = ws_server_, id = msg.request_id](const PlcWriteResult& r) {
+                    ws->complete_request(id, {{"status", r.status_name()}, {"end_code", r.end_code}, {"plc_rtt_us", r.rtt_ns / 1000}});
+                };
+            }
+            plc_->write_pulse_pair(pts.write_trigger, val == 1, pts.write_result, true, msg.trace.rx, std::move(on_done));
+            return;
         }
-        else if (command == "STEP_UPDATE") {
+        else if (command == Command::STEP_UPDATE) {
             // 純 Log 或者是未來擴充用
             std::string step = cmd.value("payload", "");
             spdlog::info("[Controller] Step updated to: {}", step);
         }
+        // ✅ [新增] 要求背景立即向 DB 重新載入設定 (熱更新，不重啟)
+        else if (command == Command::RELOAD_CONFIG) {
+            spdlog::info("[Controller] Config reload requested by UI");
+            Config::request_reload();
+        }
         // ✅ [修改] 累積模式：附加一筆資料到檔案末尾
-        else if (command == "APPEND_OFFLINE_CACHE") {
+        else if (command == Command::APPEND_OFFLINE_CACHE) {
             json item = cmd.value("payload", json::object());
             if (!item.empty()) {
                 save_offline_cache_append(item);
             }
         }
         // ✅ [新增] 清空模式：上傳成功後清空檔案
-        else if (command == "CLEAR_OFFLINE_CACHE") {
+        else if (command == Command::CLEAR_OFFLINE_CACHE) {
             clear_offline_cache();
         }
         // ✅ [載入] 讀取所有累積的資料
-        else if (command == "LOAD_OFFLINE_CACHE") {
+        else if (command == Command::LOAD_OFFLINE_CACHE) {
+            // 過載時整份快取的廣播最佔 WS 頻寬，延到 Watchdog 解除降載後才送
+            if (LoadShed::active(Shed::CACHE)) {
+                cache_load_deferred_ = true;
+                spdlog::warn("[Controller] Offline cache broadcast deferred (load shedding).");
+                if (!msg.request_id.empty()) ws_server_->complete_request(msg.request_id, {{"status", "DEFERRED"}});
+                return;
+            }
             load_offline_cache();
         }
+        // 訊號歷史查詢：{"command": "SIGNAL_HISTORY", "payload": {"from": <Epoch ms>, "to": <Epoch ms>, "signals": ["up_in", "CAMERA_LEFT_1"]}}
+        else if (command == Command::SIGNAL_HISTORY) {
+            query_history(cmd.value("payload", json::object()), msg.request_id);
+            return;
+        }
+
+        // 其餘指令處理完即視為完成
+        if (!msg.request_id.empty()) ws_server_->complete_request(msg.request_id, {{"status", "OK"}});
     }
 
-    // ✅ [實作] 附加寫入 (Accumulate)
-    // 採用 Line-delimited JSON (每一行一個 JSON 物件)，這樣即使程式崩潰也不會壞檔
+    // 預設查最近 5 分鐘；結果放在該 request_id 的 CMD_ACK，只回給發出查詢的 Client
+    // (切片可能很大，不走 sys 主題：避免推給所有 Client、佔用 StateStore ring 與 Upstream 轉送)
+    void query_history(const json& payload, const std::string& request_id) {
+        if (request_id.empty()) return; // WsServer 已拒絕
+        if (!payload.is_object()) {
+            ws_server_->complete_request(request_id, {{"status", "BAD_REQUEST"}, {"error", "payload must be an object"}});
+            return;
+        }
+        for (const char* key : {"from", "to"}) {
+            if (payload.contains(key) && !payload[key].is_number_integer()) {
+                ws_server_->complete_request(request_id, {{"status", "BAD_REQUEST"}, {"error", std::string(key) + " must be epoch ms (integer)"}});
+                return;
+            }
+        }
+        if (payload.contains("signals") && !payload["signals"].is_array()) {
+            ws_server_->complete_request(request_id, {{"status", "BAD_REQUEST"}, {"error", "signals must be an array"}});
+            return;
+        }
+        int64_t to = payload.value("to", history_.now_ms());
+        int64_t from = payload.value("from", to - 5 * 60 * 1000);
+        std::unordered_set<std::string> signals;
+        for (const auto& s : payload.value("signals", json::array())) {
+            if (s.is_string()) signals.insert(s.get<std::string>());
+        }
+
+        json result = history_.query(from, to, signals);
+        result["status"] = "OK";
+        result["type"] = "SIGNAL_HISTORY";
+        result["available"] = history_.names();
+        ws_server_->complete_request(request_id, std::move(result));
+        spdlog::info("[Controller] Signal history queried ({} ms range)", to - from);
+    }
+
+    // ✅ [實作] 附加寫入 (Accumulate)，格式見 OfflineCache
     void save_offline_cache_append(const json& item) {
         try {
-            // std::ios::app 是關鍵，它會寫在檔案最後面
-            std::ofstream o(CACHE_FILE, std::ios::app); 
-            if (o.is_open()) {
-                // dump(-1) 輸出成單行字串 (compact)
-                o << item.dump(-1) << "\n"; 
-                o.close();
+            if (cache_.append(item)) {
                 spdlog::info("[Controller] Offline record appended.");
             } else {
                 spdlog::error("[Controller] Failed to append cache file.");
@@ -195,47 +376,26 @@ private:
 
     // ✅ [實作] 清空檔案
     void clear_offline_cache() {
-        try {
-            // std::ios::trunc 會清空檔案內容
-            std::ofstream o(CACHE_FILE, std::ios::trunc);
-            o.close();
+        if (cache_.clear()) {
             spdlog::info("[Controller] Offline cache CLEARED.");
-        } catch (const std::exception& e) {
-            spdlog::error("[Controller] Clear Cache Exception: {}", e.what());
+        } else {
+            spdlog::error("[Controller] Failed to clear cache file.");
         }
     }
 
     // ✅ [實作] 載入檔案 (讀取每一行並組成 Array)
     void load_offline_cache() {
-        if (!std::filesystem::exists(CACHE_FILE)) return;
-
         try {
-            std::ifstream i(CACHE_FILE);
-            if (i.is_open()) {
-                json json_array = json::array();
-                std::string line;
-                
-                // 一行一行讀取
-                while (std::getline(i, line)) {
-                    if (!line.empty()) {
-                        try {
-                            // 解析每一行的 JSON
-                            json_array.push_back(json::parse(line));
-                        } catch (...) {
-                            spdlog::warn("[Controller] Skipped corrupted line in cache file");
-                        }
-                    }
-                }
-                i.close();
+            size_t skipped = 0;
+            json json_array = cache_.load(&skipped);
+            if (skipped) spdlog::warn("[Controller] Skipped {} corrupted line(s) in cache file", skipped);
+            if (json_array.empty()) return; // 沒資料就不廣播
 
-                if (json_array.empty()) return; // 沒資料就不廣播
+            size_t records = json_array.size();
+            json response_payload = { {"type", "OFFLINE_CACHE_LOADED"}, {"data", std::move(json_array)} };
 
-                json response_payload = { {"type", "OFFLINE_CACHE_LOADED"}, {"data", json_array} };
-                json wrapper = { {"type", "data"}, {"source", "SYS"}, {"payload", response_payload} };
-                
-                ws_server_->broadcast(wrapper.dump());
-                spdlog::info("[Controller] Offline cache loaded. Records: {}", json_array.size());
-            }
+            ws_server_->publish(Topics::SYS, WsFrame::data(Sources::SYS, std::move(response_payload)));
+            spdlog::info("[Controller] Offline cache loaded. Records: {}", records);
         } catch (const std::exception& e) {
             spdlog::error("[Controller] Load Cache Exception: {}", e.what());
         }
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <nlohmann/json.hpp>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// 離線快取檔 (MES 斷線時累積的上傳資料)
+// 採用 Line-delimited JSON (每一行一個 JSON 物件)，這樣即使程式崩潰也不會壞檔
+// 只處理檔案，Log 與廣播由 Controller 負責
+// ==============================================================================
+
+class OfflineCache {
+public:
+    explicit OfflineCache(std::string path) : path_(std::move(path)) {}
+
+    const std::string& path() const { return path_; }
+
+    // 附加一筆到檔案末尾 (每筆都重新開檔，寫完即關閉)
+    bool append(const json& item) const {
+        // std::ios::app 是關鍵，它會寫在檔案最後面
+        std::ofstream o(path_, std::ios::app);
+        if (!o.is_open()) return false;
+        // dump(-1) 輸出成單行字串 (compact)
+        o << item.dump(-1) << "\n";
+        return o.good();
+    }
+
+    // 清空檔案 (上傳成功後)
+    bool clear() const {
+        std::ofstream o(path_, std::ios::trunc);
+        return o.is_open();
+    }
+
+    // 讀取每一行並組成 Array；無法解析的行略過並計入 skipped
+    json load(size_t* skipped = nullptr) const {
+        json json_array = json::array();
+        if (skipped) *skipped = 0;
+        std::ifstream i(path_);
+        if (!i.is_open()) return json_array;
+
+        std::string line;
+        while (std::getline(i, line)) {
+            if (line.empty()) continue;
+            json item = json::parse(line, nullptr, false);
+            if (item.is_discarded()) {
+                if (skipped) ++*skipped;
+                continue;
+            }
+            json_array.push_back(std::move(item));
+        }
+        return json_array;
+    }
+
+    // 把檔案內容確實寫到磁碟 (append 關檔後資料仍可能只在 OS 快取)；關閉流程最後呼叫
+    // 檔案不存在視為成功
+    bool sync() const {
+        if (!std::filesystem::exists(path_)) return true;
+#ifdef _WIN32
+        int fd = _open(path_.c_str(), _O_WRONLY | _O_BINARY);
+        if (fd < 0) return false;
+        bool ok = _commit(fd) == 0;
+        _close(fd);
+#else
+        int fd = ::open(path_.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+#endif
+        return ok;
+    }
+
+    uint64_t size_bytes() const {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path_, ec);
+        return ec ? 0 : (uint64_t)size;
+    }
+
+private:
+    std::string path_;
+};
\ No newline at end of file
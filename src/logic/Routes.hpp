@@ -0,0 +1,73 @@
+#pragma once
+#include "core/Sources.hpp"
+#include "server/Topics.hpp"
+
+// ==============================================================================
+// Controller 路由表
+// 所有「哪種訊息交給誰處理、要不要推播給前端」的規則集中在 ROUTE_RULES，
+// 編譯期展開成 [SourceKind][MsgType] 表，執行時只做一次索引
+// ==============================================================================
+
+enum class Handler : uint8_t {
+    NONE = 0,
+    PLC_STATUS,      // 解析 PLC 位元，變更時推播 PLC_MONITOR
+    WS_COMMAND,      // 前端指令
+    WS_DISCONNECTED, // 前端斷線 -> 復歸 PLC 安全訊號
+    SCANNER_INPUT,   // 掃碼槍輸入 (只記 Log，邏輯在前端)
+};
+
+struct Route {
+    Handler handler = Handler::NONE;
+    bool broadcast = false;              // 是否轉發給前端 (主題依來源決定，見 Topics::for_source)
+    Delivery delivery = Delivery::EVENT; // 慢速 Client 的送達語意
+};
+
+struct RouteRule {
+    SourceKind source; // ANY_SOURCE = 任意來源
+    MsgType type;      // ANY_TYPE = 任意類型
+    Route route;
+};
+
+inline constexpr SourceKind ANY_SOURCE = SourceKind::COUNT;
+inline constexpr MsgType ANY_TYPE = MsgType::COUNT;
+
+// 由上而下比對，先符合者優先；都不符合則不處理也不推播 (e.g. PLC_MONITOR 由 handle_plc_update 自行推播)
+inline constexpr RouteRule ROUTE_RULES[] = {
+    {SourceKind::PLC,            MsgType::STATUS,       {Handler::PLC_STATUS, false}},
+    {ANY_SOURCE,                 MsgType::HEARTBEAT,    {Handler::NONE, false}},            // 心跳只記錄延遲
+    {SourceKind::WS,             MsgType::CMD,          {Handler::WS_COMMAND, true}},      // 指令回音
+    {SourceKind::WS,             MsgType::DISCONNECTED, {Handler::WS_DISCONNECTED, true}},
+    {SourceKind::WS,             ANY_TYPE,              {Handler::NONE, true}},
+    {SourceKind::SCANNER,        ANY_TYPE,              {Handler::SCANNER_INPUT, true}},
+    {SourceKind::SYS,            ANY_TYPE,              {Handler::NONE, true}},
+    {SourceKind::CAMERA,         ANY_TYPE,              {Handler::NONE, true}},
+    {SourceKind::CAMERA_MONITOR, ANY_TYPE,              {Handler::NONE, true, Delivery::STATE}},
+};
+
+struct RouteTable {
+    Route routes[(int)SourceKind::COUNT][(int)MsgType::COUNT] = {};
+
+    constexpr const Route& at(SourceKind source, MsgType type) const { return routes[(int)source][(int)type]; }
+};
+
+constexpr RouteTable build_routes() {
+    RouteTable table{};
+    for (int s = 0; s < (int)SourceKind::COUNT; ++s) {
+        for (int t = 0; t < (int)MsgType::COUNT; ++t) {
+            for (const auto& rule : ROUTE_RULES) {
+                bool source_ok = rule.source == ANY_SOURCE || (int)rule.source == s;
+                bool type_ok = rule.type == ANY_TYPE || (int)rule.type == t;
+                if (source_ok && type_ok) {
+                    table.routes[s][t] = rule.route;
+                    break;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+inline constexpr RouteTable ROUTES = build_routes();
+
+static_assert(ROUTES.at(SourceKind::PLC, MsgType::STATUS).handler == Handler::PLC_STATUS, "PLC status must reach handle_plc_update");
+static_assert(!ROUTES.at(SourceKind::OTHER, MsgType::DATA).broadcast, "unknown sources are not forwarded");
\ No newline at end of file
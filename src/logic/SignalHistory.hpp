@@ -0,0 +1,421 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "core/Config.hpp"
+#include "core/Latency.hpp"
+#include "core/Lifecycle.hpp"
+#include "core/Sources.hpp"
+#include "driver/McProtocol.hpp"
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// PLC 訊號 / 相機讀取的記憶體歷史 (常駐開啟，供「五分鐘前感測器閃了一下」這類問題回查)
+//   - Bit：只存變化的時間 (Run-length，值交替，不需另存)
+//   - Word：讀取範圍內每 16 點 M 組成一個 Word，存 (時間差, 值差)
+//   - 相機：每次條碼 / 逾時一筆 (條碼截斷為 TEXT_MAX 字元)
+// 每個訊號一個固定容量 ring，滿了覆蓋最舊的一筆；記錄為 O(1) 且不配置記憶體
+// (只有設定變更 / 第一次出現的相機才建立 ring)
+// 時間以 TICK_NS (0.1 ms) 為單位存成 32-bit 差值；兩次變化間隔超過約 4.9 天時該訊號從頭記錄
+// 僅 Controller 執行緒存取
+// ==============================================================================
+
+class SignalHistory {
+public:
+    static constexpr uint64_t TICK_NS = 100000;       // 0.1 ms
+    static constexpr size_t BIT_CAPACITY = 4096;      // 每個 Bit 保留的變化次數 (16 KB)
+    static constexpr size_t WORD_CAPACITY = 2048;     // 每個 Word (16 KB)
+    static constexpr size_t EVENT_CAPACITY = 1024;    // 每台相機 (32 KB)
+    static constexpr size_t MAX_WORDS = 64;           // 讀取範圍最多記錄 64 個 Word (1024 點)
+    static constexpr size_t MAX_POINTS_PER_SIGNAL = 5000; // 單次查詢每個訊號最多回傳筆數
+    static constexpr size_t TEXT_MAX = 26;
+
+    SignalHistory() : wall_offset_ns_(wall_now_ns() - (int64_t)trace_now_ns()) {}
+
+    // ---- 記錄 (Controller 執行緒) ----
+
+    // PLC 讀取結果：設定中的 5 個監看點位 + 讀取範圍內每個 Word
+    void record_plc(const std::vector<uint8_t>& raw, int base_addr, const Config::PlcPoints& pts, uint64_t t_ns) {
+        const int addrs[] = {pts.up_in, pts.up_out, pts.dn_in, pts.dn_out, pts.start};
+        for (size_t i = 0; i < bits_.size(); ++i) bits_[i].record(t_ns, McProtocol::bit(raw, base_addr, addrs[i]));
+
+        size_t word_count = std::min(MAX_WORDS, (raw.size() * 2 + 15) / 16);
+        if (base_addr != word_base_ || word_count != words_.size()) {
+            // 讀取範圍改變 (設定熱更新)：Word 從頭記錄
+            word_base_ = base_addr;
+            words_.clear();
+            for (size_t i = 0; i < word_count; ++i) words_.push_back(std::make_unique<WordRing>());
+        }
+        // 每 byte 兩點 (偶數 Offset 在高位，見 McProtocol::bit)，一個 Word = 8 bytes
+        for (size_t w = 0; w < words_.size(); ++w) {
+            int32_t value = 0;
+            size_t end = std::min(raw.size(), w * 8 + 8);
+            for (size_t i = w * 8; i < end; ++i) {
+                int shift = (int)(i - w * 8) * 2;
+                value |= ((raw[i] >> 4) & 1) << shift | (raw[i] & 1) << (shift + 1);
+            }
+            words_[w]->record(t_ns, value);
+        }
+    }
+
+    // 相機條碼 (CAMERA) / 逾時 (CAMERA_MONITOR)；其他來源忽略
+    void record_camera(SourceId source, std::string_view text, bool timeout, uint64_t t_ns) {
+        if (source >= camera_index_.size()) camera_index_.resize((size_t)source + 1, -1); // 新來源才會擴充
+        int16_t& index = camera_index_[source];
+        if (index < 0) {
+            // 第一次出現：_MONITOR 與相機本身共用同一個 ring
+            std::string name = Sources::name(source);
+            if (timeout && name.size() > 8 && name.compare(name.size() - 8, 8, "_MONITOR") == 0) name.resize(name.size() - 8);
+            auto it = std::find_if(cameras_.begin(), cameras_.end(), [&](const Camera& c) { return c.name == name; });
+            if (it == cameras_.end()) {
+                cameras_.push_back({name, std::make_unique<EventRing>()});
+                it = cameras_.end() - 1;
+            }
+            index = (int16_t)(it - cameras_.begin());
+        }
+        cameras_[index].ring->record(t_ns, timeout ? EventRing::TIMEOUT : EventRing::BARCODE, text);
+    }
+
+    // ---- 查詢 ----
+
+    // from / to 為 Epoch ms；signals 為空表示全部 (名稱見 names())
+    json query(int64_t from_ms, int64_t to_ms, const std::unordered_set<std::string>& signals = {}) const {
+        uint64_t from = to_mono(from_ms), to = to_mono(to_ms);
+        auto wanted = [&](const std::string& name) { return signals.empty() || signals.count(name); };
+
+        json out = {{"from", from_ms}, {"to", to_ms}, {"tick_ms", TICK_NS / 1e6}};
+        json bits = json::object(), words = json::object(), cameras = json::object();
+        for (size_t i = 0; i < bits_.size(); ++i) {
+            if (wanted(BIT_NAMES[i])) bits[BIT_NAMES[i]] = bits_[i].slice(from, to, *this);
+        }
+        for (size_t w = 0; w < words_.size(); ++w) {
+            std::string name = word_name(w);
+            if (wanted(name)) words[name] = words_[w]->slice(from, to, *this);
+        }
+        for (const auto& c : cameras_) {
+            if (wanted(c.name)) cameras[c.name] = c.ring->slice(from, to, *this);
+        }
+        out["bits"] = std::move(bits);
+        out["words"] = std::move(words);
+        out["cameras"] = std::move(cameras);
+        return out;
+    }
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> out(std::begin(BIT_NAMES), std::end(BIT_NAMES));
+        for (size_t w = 0; w < words_.size(); ++w) out.push_back(word_name(w));
+        for (const auto& c : cameras_) out.push_back(c.name);
+        return out;
+    }
+
+    // 已配置的 ring 大小 (Metrics 用)
+    size_t memory_bytes() const {
+        return sizeof(*this) + words_.size() * sizeof(WordRing) + cameras_.size() * sizeof(EventRing);
+    }
+
+    int64_t now_ms() const { return ((int64_t)trace_now_ns() + wall_offset_ns_) / 1000000; }
+
+private:
+    static constexpr const char* BIT_NAMES[] = {"up_in", "up_out", "dn_in", "dn_out", "start_message"}; // 同 WsFrame::PLC_FIELDS
+
+    static int64_t wall_now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t to_mono(int64_t wall_ms) const {
+        int64_t ns = wall_ms * 1000000 - wall_offset_ns_;
+        return ns < 0 ? 0 : (uint64_t)ns;
+    }
+
+    // 0.1 ms 精度
+    double to_wall_ms(uint64_t mono_ns) const { return (double)(((int64_t)mono_ns + wall_offset_ns_) / (int64_t)TICK_NS) / 10.0; }
+
+    std::string word_name(size_t w) const { return "M" + std::to_string(word_base_ + (int)w * 16); }
+
+    // 共用的 ring 基礎：origin_ 為最舊一筆之前的基準時間，每筆存與前一筆的 tick 差
+    template <typename Entry, size_t N>
+    struct Ring {
+        static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+        std::array<Entry, N> entries;
+        size_t head = 0;  // 下一筆寫入位置
+        size_t count = 0;
+        uint64_t origin_ns = 0; // 最舊一筆的時間基準
+        uint64_t last_ns = 0;   // 最新一筆的時間 (以 tick 累加，解碼時不會漂移)
+        bool started = false;
+
+        // 回傳 false：間隔超過 32-bit tick，呼叫端需從頭記錄
+        bool delta(uint64_t t_ns, uint32_t& ticks) const {
+            uint64_t d = t_ns > last_ns ? (t_ns - last_ns) / TICK_NS : 0;
+            if (d > UINT32_MAX) return false;
+            ticks = (uint32_t)d;
+            return true;
+        }
+
+        // 滿了覆蓋最舊一筆：回傳 true 並由 evicted 帶回 (基準時間移到被覆蓋那筆)
+        bool push(const Entry& e, Entry& evicted) {
+            bool full = count == N;
+            if (full) {
+                evicted = entries[head];
+                origin_ns += (uint64_t)evicted.dt * TICK_NS;
+            } else {
+                ++count;
+            }
+            entries[head] = e;
+            head = (head + 1) & (N - 1);
+            last_ns += (uint64_t)e.dt * TICK_NS;
+            return full;
+        }
+
+        template <typename F>
+        void for_each(F&& f) const {
+            uint64_t t = origin_ns;
+            size_t start = (head - count) & (N - 1);
+            for (size_t i = 0; i < count; ++i) {
+                const Entry& e = entries[(start + i) & (N - 1)];
+                t += (uint64_t)e.dt * TICK_NS;
+                f(t, e);
+            }
+        }
+
+        void reset(uint64_t t_ns) {
+            head = count = 0;
+            origin_ns = last_ns = t_ns;
+            started = true;
+        }
+    };
+
+    struct BitEntry { uint32_t dt; };
+
+    class BitRing {
+        Ring<BitEntry, BIT_CAPACITY> ring_;
+        bool initial_ = false; // origin 時的值 (之後每筆變化翻轉)
+        bool value_ = false;
+        uint64_t seen_ns_ = 0; // 最後一次取樣
+
+    public:
+        void record(uint64_t t_ns, bool v) {
+            seen_ns_ = t_ns;
+            if (ring_.started && v == value_) return;
+            uint32_t dt = 0;
+            if (!ring_.started || !ring_.delta(t_ns, dt)) {
+                ring_.reset(t_ns);
+                initial_ = value_ = v;
+                return;
+            }
+            BitEntry evicted;
+            if (ring_.push({dt}, evicted)) initial_ = !initial_; // 最舊的變化被覆蓋，基準值跟著翻轉
+            value_ = v;
+        }
+
+        json slice(uint64_t from, uint64_t to, const SignalHistory& h) const {
+            json out = json::object();
+            if (!ring_.started) return out;
+            bool value = initial_;
+            json transitions = json::array();
+            bool truncated = false;
+            ring_.for_each([&](uint64_t t, const BitEntry&) {
+                if (t < from) {
+                    value = !value;
+                } else if (t <= to) {
+                    if (transitions.size() < MAX_POINTS_PER_SIGNAL) transitions.push_back(h.to_wall_ms(t));
+                    else truncated = true;
+                }
+            });
+            out["since"] = h.to_wall_ms(std::max(from, ring_.origin_ns)); // 早於此時間的歷史已覆蓋
+            out["initial"] = value; // since 當下的值，之後每筆 transition 翻轉
+            out["transitions"] = std::move(transitions);
+            out["value"] = value_;
+            out["sampled"] = h.to_wall_ms(seen_ns_);
+            if (truncated) out["truncated"] = true;
+            return out;
+        }
+    };
+
+    struct WordEntry { uint32_t dt; int32_t dv; };
+
+    class WordRing {
+        Ring<WordEntry, WORD_CAPACITY> ring_;
+        int32_t initial_ = 0;
+        int32_t value_ = 0;
+
+    public:
+        void record(uint64_t t_ns, int32_t v) {
+            if (ring_.started && v == value_) return;
+            uint32_t dt = 0;
+            if (!ring_.started || !ring_.delta(t_ns, dt)) {
+                ring_.reset(t_ns);
+                initial_ = value_ = v;
+                return;
+            }
+            WordEntry evicted;
+            if (ring_.push({dt, v - value_}, evicted)) initial_ += evicted.dv;
+            value_ = v;
+        }
+
+        json slice(uint64_t from, uint64_t to, const SignalHistory& h) const {
+            json out = json::object();
+            if (!ring_.started) return out;
+            int32_t value = initial_, at_from = initial_;
+            json changes = json::array();
+            bool truncated = false;
+            ring_.for_each([&](uint64_t t, const WordEntry& e) {
+                value += e.dv;
+                if (t < from) {
+                    at_from = value;
+                } else if (t <= to) {
+                    if (changes.size() < MAX_POINTS_PER_SIGNAL) changes.push_back({h.to_wall_ms(t), value});
+                    else truncated = true;
+                }
+            });
+            out["since"] = h.to_wall_ms(std::max(from, ring_.origin_ns));
+            out["initial"] = at_from;
+            out["changes"] = std::move(changes); // [時間, 新值]
+            out["value"] = value_;
+            if (truncated) out["truncated"] = true;
+            return out;
+        }
+    };
+
+    struct EventEntry {
+        uint32_t dt;
+        uint8_t kind;
+        uint8_t len;
+        char text[TEXT_MAX];
+    };
+
+    class EventRing {
+        Ring<EventEntry, EVENT_CAPACITY> ring_;
+
+    public:
+        enum : uint8_t { BARCODE = 0, TIMEOUT = 1 };
+
+        void record(uint64_t t_ns, uint8_t kind, std::string_view text) {
+            EventEntry e{};
+            if (!ring_.started || !ring_.delta(t_ns, e.dt)) {
+                ring_.reset(t_ns);
+                e.dt = 0;
+            }
+            e.kind = kind;
+            e.len = (uint8_t)std::min(text.size(), TEXT_MAX);
+            std::memcpy(e.text, text.data(), e.len);
+            EventEntry evicted;
+            ring_.push(e, evicted);
+        }
+
+        // [[時間, 條碼], ...]；逾時為 [時間, null]
+        json slice(uint64_t from, uint64_t to, const SignalHistory& h) const {
+            json out = json::object();
+            json events = json::array();
+            bool truncated = false;
+            ring_.for_each([&](uint64_t t, const EventEntry& e) {
+                if (t < from || t > to) return;
+                if (events.size() >= MAX_POINTS_PER_SIGNAL) {
+                    truncated = true;
+                    return;
+                }
+                if (e.kind == TIMEOUT) events.push_back({h.to_wall_ms(t), nullptr});
+                else events.push_back({h.to_wall_ms(t), std::string(e.text, e.len)});
+            });
+            out["since"] = h.to_wall_ms(std::max(from, ring_.origin_ns));
+            out["events"] = std::move(events);
+            if (truncated) out["truncated"] = true;
+            return out;
+        }
+    };
+
+    struct Camera {
+        std::string name;
+        std::unique_ptr<EventRing> ring;
+    };
+
+    int64_t wall_offset_ns_; // Epoch ns - trace_now_ns()
+    std::array<BitRing, 5> bits_;
+    int word_base_ = -1;
+    std::vector<std::unique_ptr<WordRing>> words_;
+    std::vector<Camera> cameras_;
+    std::vector<int16_t> camera_index_; // SourceId -> cameras_ (-1 = 尚未出現)
+};
+
+// 定期把歷史寫到磁碟 (LPSM_HISTORY_DIR)：Controller 執行緒交出 JSON 片段，背景執行緒寫檔
+//   <dir>/signal_history_YYYYMMDD.jsonl，每行為一個時間區間的 SignalHistory::query 結果
+class HistorySpill {
+public:
+    static constexpr size_t MAX_PENDING_BYTES = 8 * 1024 * 1024;
+
+    explicit HistorySpill(std::string dir) : dir_(std::move(dir)) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        running_ = true;
+        writer_ = std::thread([this]() {
+            ThreadTopology::apply(ThreadRole::BACKGROUND);
+            writer_loop();
+        });
+        spdlog::info("[History] Spilling signal history to {}", dir_);
+    }
+
+    ~HistorySpill() { stop(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (writer_.joinable()) writer_.join();
+    }
+
+    void submit(const json& slice) {
+        std::string line = slice.dump(-1);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.size() + line.size() > MAX_PENDING_BYTES) return; // 磁碟跟不上：略過這段
+        pending_ += line;
+        pending_ += '\n';
+        cond_.notify_one();
+    }
+
+private:
+    std::string dir_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_ = false;
+    std::string pending_;
+    std::thread writer_;
+
+    void writer_loop() {
+        std::string chunk;
+        bool running = true;
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return !running_ || !pending_.empty(); });
+                running = running_;
+                chunk.swap(pending_);
+            }
+            if (chunk.empty()) continue;
+
+            std::time_t now = std::time(nullptr);
+            char date[16];
+            std::strftime(date, sizeof(date), "%Y%m%d", std::localtime(&now));
+            std::ofstream out(dir_ + "/signal_history_" + date + ".jsonl", std::ios::app);
+            if (!out.is_open() || !(out << chunk)) spdlog::error("[History] Failed to write {}", dir_);
+            chunk.clear();
+        }
+    }
+};
\ No newline at end of file
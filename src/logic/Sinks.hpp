@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "core/Latency.hpp"
+#include "server/Topics.hpp"
+#include "server/WsProtocol.hpp"
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// Controller 的輸出端
+// 實際執行時由 PlcClient / WsServer 實作；離線重播 (tools/lpsm_replay) 改接 Stub，
+// 讓 Controller 不需 Asio 連線與 uWS 也能建置與執行
+// ==============================================================================
+
+// PLC 寫入結果 (在 io 執行緒回呼)
+struct PlcWriteResult {
+    enum Status { OK, UNCHANGED, PLC_ERROR, IO_ERROR } status = OK;
+    int end_code = 0;    // PLC 回應的 End Code
+    uint64_t rtt_ns = 0; // 寫入 Request -> Response
+
+    const char* status_name() const {
+        static const char* names[] = {"OK", "UNCHANGED", "PLC_ERROR", "IO_ERROR"};
+        return names[status];
+    }
+};
+
+class PlcSink {
+public:
+    using WriteCallback = std::function<void(const PlcWriteResult&)>;
+
+    virtual ~PlcSink() = default;
+
+    // 用於：系統啟動、PLC 重連、WS 斷線
+    virtual void reset_safe_signals() = 0;
+
+    // trace_rx_ns: 指令在 WS 收到的時間，用於量測「指令 -> PLC 寫入回應」延遲
+    // on_done: 這組寫入中最後一筆的 PLC 回應結果 (兩點都已是目標狀態時立即回呼 UNCHANGED)
+    virtual void write_pulse_pair(int addr1, bool val1, int addr2, bool val2, uint64_t trace_rx_ns = 0,
+                                  WriteCallback on_done = nullptr) = 0;
+};
+
+class WsSink {
+public:
+    virtual ~WsSink() = default;
+
+    // 可由任意執行緒呼叫
+    virtual void publish(std::string topic, WsFrame frame, const TraceStamps& trace = {},
+                         Delivery delivery = Delivery::EVENT) = 0;
+
+    // 帶 request_id 的指令完成 (回覆 CMD_ACK 給發出指令的 Client)；request_id 為 Message::request_id
+    virtual void complete_request(std::string request_id, json result) = 0;
+
+    // 移除 prefix 開頭的保留狀態 (keep 除外)，與 publish 依序生效；彙總端收到 Hub 完整快照時使用
+    // 不保留狀態的輸出端 (Stub) 不需實作
+    virtual void drop_retained(std::string /*prefix*/, std::string /*keep*/ = {}) {}
+};
\ No newline at end of file
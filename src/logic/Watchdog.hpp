@@ -0,0 +1,235 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include "core/Latency.hpp"
+#include "core/Lifecycle.hpp"
+#include "core/LoadShed.hpp"
+#include "core/MessageBus.hpp"
+#include "logic/Sinks.hpp"
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// 延遲 Watchdog：每 LPSM_WATCHDOG_MS (預設 500，0 = 關閉) 取樣一次並與 SLO 比較
+//   bus_depth    Bus 排隊中的訊息數        LPSM_SLO_BUS_DEPTH      (預設 1000 筆)
+//   bus_wait     Bus 排隊時間 p99          LPSM_SLO_BUS_WAIT_MS    (預設 100)
+//   controller   Controller 處理時間 p99   LPSM_SLO_CONTROLLER_MS  (預設 20)
+//   end_to_end   設備收到 -> WS 發送 p99   LPSM_SLO_END_TO_END_MS  (預設 250)
+//   plc_cycle    PLC 輪詢週期 p99          LPSM_SLO_PLC_CYCLE_MS   (預設 1000)
+// SLO 設為 0 即不檢查。延遲取「上次取樣之後」的區間分佈，樣本不足時累積到下一次
+// (PLC 週期卡住時，卡住的那一輪完成後仍會被算進去)
+// 連續 BREACH_SAMPLES 次違反 -> 啟動降載 (core/LoadShed.hpp)；連續 RECOVER_SAMPLES 次正常 -> 解除
+// 違反 / 恢復都推播 WATCHDOG 到 sys/watchdog，並附上 PLC 寫入延遲 (安全路徑不降載，供前端確認)
+// ==============================================================================
+
+class Watchdog {
+public:
+    static constexpr int BREACH_SAMPLES = 2;
+    static constexpr int RECOVER_SAMPLES = 10;
+
+    struct Stats {
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> breaches{0};
+        std::atomic<bool> shedding{false};
+    };
+
+    Watchdog(std::shared_ptr<MessageBus> bus, std::shared_ptr<WsSink> ws)
+        : bus_(std::move(bus)), ws_(std::move(ws)) {
+        interval_ = std::chrono::milliseconds(env_u64("LPSM_WATCHDOG_MS", 500));
+
+        probes_.push_back({"bus_depth", env_u64("LPSM_SLO_BUS_DEPTH", 1000), nullptr, 0});
+        add_latency("bus_wait", Stage::BUS_WAIT, env_u64("LPSM_SLO_BUS_WAIT_MS", 100) * 1000, 5);
+        add_latency("controller", Stage::CONTROLLER, env_u64("LPSM_SLO_CONTROLLER_MS", 20) * 1000, 5);
+        add_latency("end_to_end", Stage::END_TO_END, env_u64("LPSM_SLO_END_TO_END_MS", 250) * 1000, 5);
+        add_latency("plc_cycle", Stage::PLC_CYCLE, env_u64("LPSM_SLO_PLC_CYCLE_MS", 1000) * 1000, 1);
+        // 只回報不判斷：過載時安全寫入的延遲
+        add_latency("plc_write_rtt", Stage::PLC_WRITE_RTT, 0, 1);
+        add_latency("cmd_to_plc_ack", Stage::CMD_TO_PLC_ACK, 0, 1);
+    }
+
+    ~Watchdog() { stop(std::chrono::milliseconds(100)); }
+
+    bool enabled() const { return interval_.count() > 0; }
+    const Stats& stats() const { return stats_; }
+
+    void start() {
+        if (!enabled() || thread_.running()) return;
+        spdlog::info("[Watchdog] Sampling every {} ms. SLO: {}", interval_.count(), describe_limits());
+        stopping_ = false;
+        thread_.start(ThreadRole::HEARTBEAT, [this]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!cond_.wait_for(lock, interval_, [this]{ return stopping_; })) {
+                lock.unlock();
+                sample();
+                lock.lock();
+            }
+        });
+    }
+
+    // 關閉時解除降載 (Bus 清空期間不再延後任何推播)
+    bool stop(std::chrono::milliseconds timeout) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cond_.notify_all();
+        bool joined = thread_.join_for(timeout);
+        if (stats_.shedding.exchange(false)) LoadShed::release();
+        return joined;
+    }
+
+private:
+    struct Probe {
+        std::string name;
+        uint64_t limit;                        // SLO 上限 (bus_depth 為筆數，其餘為 us)；0 = 只回報
+        const LatencyHistogram* hist;          // nullptr = Bus 深度
+        uint64_t min_samples;
+        LatencyHistogram::Counts base{};       // 區間起點
+        uint64_t value = 0;                    // 最近一次有效的區間 p99 (us) / 深度
+        bool fresh = false;                    // 本次取樣是否有足夠樣本
+        uint64_t peak = 0;                     // 本次違反期間的最大值
+    };
+
+    std::shared_ptr<MessageBus> bus_;
+    std::shared_ptr<WsSink> ws_;
+    std::chrono::milliseconds interval_;
+    std::vector<Probe> probes_;
+
+    ManagedThread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_ = false;
+
+    Stats stats_;
+    int bad_ = 0;     // 連續違反次數
+    int healthy_ = 0; // 降載中連續正常次數
+    std::chrono::steady_clock::time_point breach_start_;
+
+    static uint64_t env_u64(const char* name, uint64_t fallback) {
+        const char* v = std::getenv(name);
+        return v ? (uint64_t)std::max(0LL, std::atoll(v)) : fallback;
+    }
+
+    void add_latency(const char* name, Stage stage, uint64_t limit_us, uint64_t min_samples) {
+        Probe p{name, limit_us, &Latency::stage(stage), min_samples};
+        p.base = p.hist->snapshot();
+        probes_.push_back(std::move(p));
+    }
+
+    void update(Probe& p) {
+        if (!p.hist) {
+            p.value = bus_->size();
+            p.fresh = true;
+            return;
+        }
+        auto now = p.hist->snapshot();
+        LatencyHistogram::Counts delta;
+        uint64_t total = 0;
+        for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            delta[i] = now[i] - p.base[i];
+            total += delta[i];
+        }
+        p.fresh = total >= p.min_samples;
+        if (!p.fresh) return; // 累積到下一次
+        p.value = (uint64_t)LatencyHistogram::percentile_of(delta, 99);
+        p.base = now;
+    }
+
+    static bool breached(const Probe& p) { return p.limit && p.fresh && p.value > p.limit; }
+
+    void sample() {
+        std::vector<Probe*> over;
+        for (auto& p : probes_) {
+            update(p);
+            if (breached(p)) over.push_back(&p);
+        }
+        stats_.samples.fetch_add(1, std::memory_order_relaxed);
+
+        bool shedding = stats_.shedding.load(std::memory_order_relaxed);
+        if (!over.empty()) {
+            healthy_ = 0;
+            if (++bad_ >= BREACH_SAMPLES && !shedding) enter(over);
+            if (stats_.shedding.load(std::memory_order_relaxed)) {
+                for (Probe* p : over) p->peak = std::max(p->peak, p->value); // 恢復時回報
+            }
+        } else {
+            bad_ = 0;
+            if (shedding && ++healthy_ >= RECOVER_SAMPLES) leave();
+        }
+    }
+
+    void enter(const std::vector<Probe*>& over) {
+        LoadShed::engage();
+        stats_.shedding.store(true, std::memory_order_relaxed);
+        stats_.breaches.fetch_add(1, std::memory_order_relaxed);
+        breach_start_ = std::chrono::steady_clock::now();
+        healthy_ = 0;
+
+        json slos = json::array();
+        std::string desc;
+        for (const Probe* p : over) {
+            slos.push_back({{"slo", p->name}, {"value", p->value}, {"limit", p->limit}, {"unit", unit(*p)}});
+            if (!desc.empty()) desc += ", ";
+            desc += p->name + " " + std::to_string(p->value) + " > " + std::to_string(p->limit) + " " + unit(*p);
+        }
+        spdlog::warn("[Watchdog] SLO breached: {}. Shedding: {}", desc, join(LoadShed::active_names()));
+        report("BREACH", {{"slos", std::move(slos)}});
+    }
+
+    void leave() {
+        auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - breach_start_).count();
+        LoadShed::release();
+        stats_.shedding.store(false, std::memory_order_relaxed);
+        healthy_ = 0;
+
+        json peaks = json::object();
+        for (auto& p : probes_) {
+            if (p.peak) peaks[p.name] = {{"value", p.peak}, {"limit", p.limit}, {"unit", unit(p)}};
+            p.peak = 0;
+        }
+        spdlog::info("[Watchdog] Recovered after {} ms. Load shedding released.", duration_ms);
+        report("RECOVERED", {{"duration_ms", duration_ms}, {"peaks", std::move(peaks)}});
+    }
+
+    // STATE 推播：新連線的前端從快照即可得知目前是否在降載
+    void report(const char* state, json body) {
+        body["state"] = state;
+        body["ts"] = std::time(nullptr);
+        body["shedding"] = LoadShed::active_names();
+        json safety = json::object();
+        for (const auto& p : probes_) {
+            if (!p.limit && p.hist) safety[p.name + "_p99_us"] = p.value;
+        }
+        body["safety"] = std::move(safety);
+        ws_->publish(Topics::WATCHDOG, WsFrame::control("WATCHDOG", std::move(body)), {}, Delivery::STATE);
+    }
+
+    std::string describe_limits() const {
+        std::string out;
+        for (const auto& p : probes_) {
+            if (!p.limit) continue;
+            if (!out.empty()) out += ", ";
+            out += p.name + " " + std::to_string(p.hist ? p.limit / 1000 : p.limit) + (p.hist ? "ms" : "");
+        }
+        return out.empty() ? "none" : out;
+    }
+
+    static const char* unit(const Probe& p) { return p.hist ? "us" : "msgs"; }
+
+    static std::string join(const std::vector<std::string>& items) {
+        std::string out;
+        for (const auto& s : items) out += (out.empty() ? "" : ",") + s;
+        return out.empty() ? "none" : out;
+    }
+};
\ No newline at end of file
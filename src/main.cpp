@@ -12,14 +12,17 @@
 #include "core/Logger.hpp"
 #include "core/MessageBus.hpp"
 #include "core/Config.hpp"
+#include "core/ConfigDb.hpp"
+#include "core/Startup.hpp"
+#include "core/Lifecycle.hpp"
 #include "driver/PlcClient.hpp"
 #include "driver/CamServer.hpp"
 #include "driver/KeyboardHook.hpp"
 #include "server/WsServer.hpp"
+#include "server/UpstreamRelay.hpp"
+#include "server/Aggregator.hpp"
 #include "logic/Controller.hpp"
-
-// 全域變數
-std::atomic<bool> g_running{true};
+#include "logic/Watchdog.hpp"
 
 void KillProcessOnPort(int port) {
     std::string cmd = "for /f \"tokens=5\" %a in ('netstat -aon ^| find \":" + std::to_string(port) + "\" ^| find \"LISTENING\"') do taskkill /f /pid %a > nul 2>&1";
@@ -28,7 +31,9 @@ void KillProcessOnPort(int port) {
 
 BOOL WINAPI ConsoleHandler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_CLOSE_EVENT || signal == CTRL_BREAK_EVENT) {
-        g_running = false;
+        Lifecycle::request_shutdown();
+        // 按 [X] 關閉視窗時，Handler 一返回 Windows 就結束行程：等關閉流程跑完
+        if (signal == CTRL_CLOSE_EVENT) Lifecycle::wait_stopped(Lifecycle::shutdown_budget() + std::chrono::milliseconds(500));
         return TRUE; 
     }
     return FALSE;
@@ -70,71 +75,363 @@ std::string GetLocalIP() {
     }
 }
 
-int main() {
-    SetConsoleOutputCP(65001);
+// 命令列參數 (皆可省略，預設為一般 Hub)
+//   --upstream <host>[:port]   Hub 把推播上傳到彙總端 (預設 port 7070)
+//   --hub-id <name>            上傳時的 Hub 名稱 (預設為設定中的 Hub IP)
+//   --aggregator               彙總模式：只接收各 Hub 的上傳並推播給中央看板 (不連 DB / PLC / 相機)
+//   --listen <port>            彙總模式接收 Hub 的 port (預設 7070)
+//   --ws-port <port>           彙總模式的 WebSocket port (預設 8181)
+struct LaunchOptions {
+    bool aggregator = false;
+    std::string upstream_host;
+    int upstream_port = UpstreamProtocol::DEFAULT_PORT;
+    std::string hub_id;
+    int listen_port = UpstreamProtocol::DEFAULT_PORT;
+    int ws_port = 8181;
+};
 
-    // 1. 環境清理 (包含關閉殘留的 Edge)
-    system("taskkill /F /IM msedge.exe >nul 2>&1");
-    KillProcessOnPort(8181);  // Websocket port
-    KillProcessOnPort(6060);  // Camera port
-    
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+bool ParseLaunchOptions(int argc, char** argv, LaunchOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--aggregator") opt.aggregator = true;
+        else if (!has_value) return false;
+        else if (a == "--upstream") {
+            std::string target = argv[++i];
+            size_t colon = target.rfind(':');
+            opt.upstream_host = target.substr(0, colon);
+            if (colon != std::string::npos) opt.upstream_port = std::atoi(target.c_str() + colon + 1);
+            if (opt.upstream_host.empty()) return false;
+        }
+        else if (a == "--hub-id") opt.hub_id = argv[++i];
+        else if (a == "--listen") opt.listen_port = std::atoi(argv[++i]);
+        else if (a == "--ws-port") opt.ws_port = std::atoi(argv[++i]);
+        else return false;
+    }
+    return opt.upstream_port > 0 && opt.listen_port > 0 && opt.ws_port > 0;
+}
 
-    // 2. 開啟網頁 (請確認現場是否連得到這個 IP)
-    OpenEdgeOnWindows("http://10.8.32.64:2102/");
-    // OpenEdgeOnWindows("http://localhost:5173/");
-    
-    // 給瀏覽器足夠時間啟動，避免 Port 搶佔問題
-    std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+// 彙總模式：io (Hub 連線) + WS (中央看板)，關閉流程與 Hub 相同
+int RunAggregator(const LaunchOptions& opt) {
+    spdlog::info("LPSM Aggregator Starting (hubs on port {}, dashboards on port {})...", opt.listen_port, opt.ws_port);
 
-    if (!SetConsoleCtrlHandler(ConsoleHandler, TRUE)) {
-        std::cerr << "錯誤: 無法註冊控制台處理程序" << std::endl;
+    auto bus = std::make_shared<MessageBus>(); // 只有心跳與看板指令
+    boost::asio::io_context ioc;
+    auto ws_server = std::make_shared<WsServer>(bus);
+    std::shared_ptr<Aggregator> aggregator;
+    ManagedThread io_thread, logic_thread, ws_thread;
+
+    StartupOrchestrator boot;
+    boot.add("cleanup", {}, [&](){
+        KillProcessOnPort(opt.ws_port);
+        KillProcessOnPort(opt.listen_port);
+        return StartupOrchestrator::wait_until([&]{
+            return StartupOrchestrator::port_free(opt.ws_port) && StartupOrchestrator::port_free(opt.listen_port);
+        }, std::chrono::seconds(3));
+    });
+
+    boot.add("io", {}, [&](){
+        io_thread.start(ThreadRole::IO, [&ioc](){
+            auto work = boost::asio::make_work_guard(ioc);
+            ioc.run();
+        });
+        return true;
+    });
+
+    boot.add("ws", {"cleanup"}, [&](){
+        ws_thread.start(ThreadRole::WS, [ws_server, port = opt.ws_port](){ ws_server->run(port); });
+        return ws_server->wait_listening(std::chrono::seconds(5));
+    });
+
+    boot.add("aggregator", {"cleanup", "io", "ws"}, [&](){
+        aggregator = std::make_shared<Aggregator>(ioc, ws_server, opt.listen_port);
+        const auto& stats = aggregator->stats();
+        Metrics::gauge("lpsm_aggregator_hubs_online", "Hubs connected to the aggregator", [&stats]{ return (double)stats.hubs_online.load(); });
+        Metrics::gauge("lpsm_aggregator_entries_total", "Pushes received from hubs", [&stats]{ return (double)stats.entries.load(); });
+        Metrics::gauge("lpsm_aggregator_bytes_total", "Bytes received from hubs", [&stats]{ return (double)stats.wire_bytes.load(); });
+        return true;
+    });
+
+    // 看板送來的指令沒有 Controller 可處理：帶 request_id 的直接回覆 UNSUPPORTED
+    boot.add("logic", {"ws"}, [&](){
+        logic_thread.start(ThreadRole::LOGIC, [bus, ws_server](){
+            Message msg;
+            while (bus->pop(msg)) {
+                if (msg.type == MsgType::CMD && !msg.request_id.empty()) {
+                    ws_server->complete_request(msg.request_id, {{"status", "UNSUPPORTED"}});
+                }
+            }
+        });
+        return true;
+    });
+
+    if (!boot.run()) {
+        spdlog::error("❌ 彙總模式啟動失敗，程式將在 10 秒後退出...");
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+        TerminateProcess(GetCurrentProcess(), 1);
+        return -1;
     }
 
+    spdlog::info("LPSM Aggregator Started. Press [X] to exit.");
+    Lifecycle::wait_for_shutdown();
+
+    spdlog::info("[System] Stopping aggregator and exiting...");
+    using std::chrono::milliseconds;
+    ShutdownSequence shutdown;
+    shutdown.add("intake", milliseconds(500), [&](milliseconds budget){
+        ws_server->stop_intake();
+        return aggregator ? aggregator->stop(budget) : true;
+    });
+    shutdown.add("drain", milliseconds(500), [&](milliseconds budget){
+        bus->stop();
+        return logic_thread.join_for(budget);
+    });
+    shutdown.add("ws", milliseconds(500), [&](milliseconds budget){
+        ws_server->stop();
+        return ws_thread.join_for(budget);
+    });
+    shutdown.add("io", milliseconds(300), [&](milliseconds budget){
+        ioc.stop();
+        return io_thread.join_for(budget);
+    });
+
+    bool clean = shutdown.run(Lifecycle::shutdown_budget());
+    Logger::shutdown();
+    Lifecycle::notify_stopped();
+    TerminateProcess(GetCurrentProcess(), clean ? 0 : 1);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    SetConsoleOutputCP(65001);
     Logger::init();
 
-    // 3. 取得本機 IP 並載入設定
-    std::string my_ip = GetLocalIP();
-    spdlog::info("Detected Local IP: {}", my_ip);
+    if (!SetConsoleCtrlHandler(ConsoleHandler, TRUE)) {
+        std::cerr << "錯誤: 無法註冊控制台處理程序" << std::endl;
+    }
 
-    if (!Config::load_from_db(my_ip)) {
-        spdlog::error("❌ 無法從資料庫載入設定！可能是 IP 未註冊或 DB 連線失敗。");
-        spdlog::error("程式將在 10 秒後退出...");
-        std::this_thread::sleep_for(std::chrono::seconds(10));
-        return -1; // 強制結束
+    LaunchOptions launch;
+    if (!ParseLaunchOptions(argc, argv, launch)) {
+        std::cerr << "用法: lpsm_app [--upstream host[:port] [--hub-id name]] | [--aggregator [--listen 7070] [--ws-port 8181]]" << std::endl;
+        return 2;
     }
+    if (launch.aggregator) return RunAggregator(launch);
 
     spdlog::info("LPSM System Starting...");
-    
+
     auto bus = std::make_shared<MessageBus>();
+    Metrics::gauge("lpsm_bus_queue_depth", "Messages waiting in the MessageBus", [bus]{ return (double)bus->size(); });
+    for (int i = 0; i < (int)Lane::COUNT; ++i) {
+        Lane lane = (Lane)i;
+        std::string name = MessageBus::lane_name(lane);
+        Metrics::gauge("lpsm_bus_" + name + "_depth", "Messages waiting in the " + name + " lane", [bus, lane]{ return (double)bus->size(lane); });
+        Metrics::gauge("lpsm_bus_" + name + "_wait_p99_us", "p99 queueing time in the " + name + " lane", [bus, lane]{ return bus->wait(lane).percentile(99); });
+    }
+    Metrics::gauge("lpsm_log_dropped", "Binary log records dropped because a thread ring was full", []{ return (double)BinLog::dropped(); });
     boost::asio::io_context ioc; 
+    auto ws_server = std::make_shared<WsServer>(bus);
+    KeyboardHook scanner_hook(bus);
+
+    std::string my_ip;
+    bool from_snapshot = false;
+    std::unique_ptr<ConfigWatcher> config_watcher;
+    std::shared_ptr<PlcClient> plc;
+    std::shared_ptr<CamServer> cam;
+    std::shared_ptr<Controller> controller;
+    std::shared_ptr<CaptureWriter> capture;
+    ManagedThread io_thread, logic_thread, ws_thread; // 角色 / 優先權見 core/Lifecycle.hpp
+
+    // SLO 監看與自動降載 (LPSM_WATCHDOG_MS=0 關閉，SLO 設定見 logic/Watchdog.hpp)
+    auto watchdog = std::make_shared<Watchdog>(bus, ws_server);
+    {
+        const auto& stats = watchdog->stats();
+        Metrics::gauge("lpsm_watchdog_shedding", "Load shedding active (SLO breached)", [&stats]{ return stats.shedding.load() ? 1.0 : 0.0; });
+        Metrics::gauge("lpsm_watchdog_breaches_total", "SLO breaches that triggered load shedding", [&stats]{ return (double)stats.breaches.load(); });
+    }
+
+    // --upstream：推播同時上傳到彙總端 (WS 啟動前掛上，連線在設定載入後才開始)
+    std::shared_ptr<UpstreamRelay> relay;
+    if (!launch.upstream_host.empty()) {
+        relay = std::make_shared<UpstreamRelay>(ioc, UpstreamRelay::Options{launch.upstream_host, launch.upstream_port, launch.hub_id});
+        ws_server->set_relay(relay);
+        const auto& stats = relay->stats();
+        Metrics::gauge("lpsm_upstream_connected", "Upstream relay connected to the aggregator", [relay]{ return relay->connected() ? 1.0 : 0.0; });
+        Metrics::gauge("lpsm_upstream_entries_total", "Pushes relayed to the aggregator", [&stats]{ return (double)stats.entries.load(); });
+        Metrics::gauge("lpsm_upstream_bytes_total", "Bytes sent to the aggregator", [&stats]{ return (double)stats.wire_bytes.load(); });
+    }
+
+    // 啟動流程：依相依關係並行執行，以 Probe 取代固定 sleep
+    //   cleanup ──┬── ws ── browser     (ws 也等 config：歡迎訊息的主題清單來自設定)
+    //             └── cam ──┐
+    //   config ───┬─────────┤
+    //             └── plc ──┴── logic ── watchdog
+    //   io, hook (獨立)         plc ── plc_link (僅量測)
+    StartupOrchestrator boot;
+
+    // 1. 環境清理 (包含關閉殘留的 Edge)，等到 Port 真的釋放為止
+    boot.add("cleanup", {}, [](){
+        system("taskkill /F /IM msedge.exe >nul 2>&1");
+        KillProcessOnPort(8181);  // Websocket port
+        KillProcessOnPort(6060);  // Camera port
+        return StartupOrchestrator::wait_until([]{
+            return StartupOrchestrator::port_free(8181) && StartupOrchestrator::port_free(6060);
+        }, std::chrono::seconds(3));
+    });
+
+    // 2. 取得本機 IP 並載入設定：優先使用本機快照 (免等 DB)，DB 更新改在背景進行
+    boot.add("config", {}, [&](){
+        my_ip = GetLocalIP();
+        spdlog::info("Detected Local IP: {}", my_ip);
+
+        from_snapshot = Config::load_snapshot(my_ip);
+        if (!from_snapshot && !ConfigDb::load(my_ip)) {
+            spdlog::error("❌ 無法從資料庫載入設定，且沒有本機快照！可能是 IP 未註冊或 DB 連線失敗。");
+            return false;
+        }
+
+        // 背景監看 DB 設定變更 (熱更新)
+        config_watcher = std::make_unique<ConfigWatcher>(my_ip);
+        config_watcher->start(from_snapshot);
+        return true;
+    });
+
+    boot.add("io", {}, [&](){
+        io_thread.start(ThreadRole::IO, [&ioc](){ 
+            auto work = boost::asio::make_work_guard(ioc);
+            ioc.run(); 
+        });
+        return true;
+    });
+
+    boot.add("hook", {}, [&](){
+        scanner_hook.start();
+        return true;
+    }, false);
+
+    boot.add("ws", {"cleanup", "config"}, [&](){
+        ws_thread.start(ThreadRole::WS, [ws_server](){ ws_server->run(8181); });
+        return ws_server->wait_listening(std::chrono::seconds(5));
+    });
+
+    // 3. WS 已在 LISTEN 才開啟網頁 (請確認現場是否連得到這個 IP)
+    boot.add("browser", {"ws"}, [](){
+        OpenEdgeOnWindows("http://10.8.32.64:2102/");
+        // OpenEdgeOnWindows("http://localhost:5173/");
+        return true;
+    }, false);
 
     // 4. 使用動態 IP 建立元件
-    auto plc = std::make_shared<PlcClient>(ioc, bus, Config::get().plc_ip, Config::get().plc_port);
-    auto cam = std::make_shared<CamServer>(ioc, bus, 6060);
-    auto ws_server = std::make_shared<WsServer>(bus);
-    auto controller = std::make_shared<Controller>(bus, plc, ws_server);
+    boot.add("plc", {"config", "io"}, [&](){
+        plc = std::make_shared<PlcClient>(ioc, bus, Config::get()->plc_ip, Config::get()->plc_port);
+        plc->start();
+        return true;
+    });
 
-    // 5. 啟動所有執行緒
-    plc->start();
-    std::thread io_thread([&ioc](){ 
-        auto work = boost::asio::make_work_guard(ioc);
-        ioc.run(); 
+    boot.add("cam", {"cleanup", "config", "io"}, [&](){
+        cam = std::make_shared<CamServer>(ioc, bus, 6060);
+        return true;
     });
 
-    KeyboardHook scanner_hook(bus);
-    scanner_hook.start();
+    boot.add("logic", {"plc", "ws"}, [&](){
+        controller = std::make_shared<Controller>(bus, plc, ws_server);
+        // LPSM_CAPTURE_DIR=<dir>：記錄 Controller 收到的所有訊息 (離線重播用，見 tools/lpsm_replay)
+        if (const char* dir = std::getenv("LPSM_CAPTURE_DIR")) {
+            capture = std::make_shared<CaptureWriter>(dir);
+            controller->set_capture(capture);
+        }
+        logic_thread.start(ThreadRole::LOGIC, [controller](){ controller->run(); });
+        return true;
+    });
 
-    std::thread logic_thread([controller](){ controller->run(); });
-    std::thread ws_thread([ws_server](){ ws_server->run(8181); });
+    // 彙總端離線不影響 Hub 本身 (背景重連)
+    if (relay) {
+        boot.add("upstream", {"config", "io", "ws"}, [&](){
+            if (relay->options().hub_id.empty()) {
+                relay->set_hub_id(Config::get()->hub_ip.empty() ? my_ip : Config::get()->hub_ip);
+            }
+            relay->start();
+            return true;
+        }, false);
+    }
 
-    spdlog::info("LPSM System Started. Press [X] to exit.");
+    // Bus / Controller / PLC 都已啟動才開始取樣，避免把啟動過程算成違反
+    boot.add("watchdog", {"logic"}, [&](){
+        watchdog->start();
+        return true;
+    }, false);
 
-    while (g_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    // 僅用於量測「啟動 -> PLC 連線」時間，PLC 離線不影響其他功能
+    boot.add("plc_link", {"plc"}, [&](){
+        return StartupOrchestrator::wait_until([&plc]{ return plc->is_connected(); }, std::chrono::seconds(5));
+    }, false);
+
+    if (!boot.run()) {
+        spdlog::error("❌ 啟動失敗，程式將在 10 秒後退出...");
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+        TerminateProcess(GetCurrentProcess(), 1); // 強制結束 (背景執行緒仍在執行)
+        return -1;
     }
 
+    spdlog::info("LPSM System Started. Press [X] to exit.");
+
+    Lifecycle::wait_for_shutdown(); // 阻塞到 Console Handler 發出關閉請求
+
+    // 依序關閉：先停輸入，再清空 Bus，最後把安全訊號與快取寫出去 (每階段有逾時，總時間見 LPSM_SHUTDOWN_TIMEOUT_MS)
     spdlog::info("[System] Stopping services and exiting...");
-    TerminateProcess(GetCurrentProcess(), 0);
+    using std::chrono::milliseconds;
+    ShutdownSequence shutdown;
+
+    // 0. 停止 Watchdog 並解除降載：關閉期間的推播與快取照常處理
+    shutdown.add("watchdog", milliseconds(200), [&](milliseconds budget){
+        return watchdog->stop(budget);
+    });
+
+    // 1. 停止輸入：掃碼槍 Hook、前端指令 / 新連線、相機連線 (未分框的條碼仍會推入 Bus)
+    shutdown.add("intake", milliseconds(500), [&](milliseconds budget){
+        scanner_hook.stop();
+        ws_server->stop_intake();
+        return cam ? cam->stop(budget) : true;
+    });
+
+    // 2. Controller 處理完 Bus 內剩餘訊息後 run() 返回
+    shutdown.add("drain", milliseconds(1500), [&](milliseconds budget){
+        bus->stop();
+        return logic_thread.join_for(budget);
+    });
+
+    // 3. 安全訊號 OFF，並等 PLC 寫入佇列清空
+    shutdown.add("plc", milliseconds(1500), [&](milliseconds budget){
+        return plc ? plc->flush(budget) : true;
+    });
+
+    // 4. 離線快取與擷取檔寫到磁碟
+    shutdown.add("cache", milliseconds(500), [&](milliseconds){
+        if (capture) capture->stop();
+        return controller ? controller->sync_cache() : true;
+    });
+
+    // 5. 送出最後的推播後關閉前端連線
+    shutdown.add("ws", milliseconds(500), [&](milliseconds budget){
+        ws_server->stop();
+        return ws_thread.join_for(budget);
+    });
+
+    // 6. 最後一批推播送到彙總端
+    if (relay) {
+        shutdown.add("upstream", milliseconds(300), [&](milliseconds budget){
+            return relay->stop(budget);
+        });
+    }
+
+    shutdown.add("io", milliseconds(300), [&](milliseconds budget){
+        ioc.stop();
+        return io_thread.join_for(budget);
+    });
+
+    bool clean = shutdown.run(Lifecycle::shutdown_budget());
+    Logger::shutdown(); // 寫出二進位 Log 剩餘紀錄
+    Lifecycle::notify_stopped();
+    // Hook Message Loop、DB 設定監看等執行緒不在關閉流程內，直接結束行程
+    TerminateProcess(GetCurrentProcess(), clean ? 0 : 1);
     return 0;
 }
\ No newline at end of file
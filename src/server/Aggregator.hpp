@@ -0,0 +1,350 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include "core/Latency.hpp"
+#include "core/Sources.hpp"
+#include "logic/Sinks.hpp"
+#include "server/Topics.hpp"
+#include "server/UpstreamProtocol.hpp"
+
+// ==============================================================================
+// 彙總端 (lpsm_app --aggregator)：接收各 Hub 的上傳中繼 (server/UpstreamRelay.hpp)，
+// 轉成 hub/<hub>/<topic> 主題後交給 WsSink (WsServer) 推播給中央看板
+//   - 來源名稱加上 Hub 前綴 (e.g. line3/CAMERA_LEFT_1)，看板不必知道主題也能分辨
+//   - 每個 Hub 記錄已收到的最後序號：重連時回覆給 Hub，只補送遺漏的推播 (Hub 重啟則送完整快照)
+//   - Hub 上線 / 離線以 hub/<hub>/status (HUB_STATUS，保留在快照中) 通知
+// 全部在 io 執行緒執行
+// ==============================================================================
+class Aggregator;
+
+class AggregatorSession : public std::enable_shared_from_this<AggregatorSession> {
+public:
+    using tcp = boost::asio::ip::tcp;
+    static constexpr auto IDLE_TIMEOUT = std::chrono::seconds(15); // Hub 閒置時每 5 秒送 PING
+
+    AggregatorSession(tcp::socket socket, Aggregator& owner, boost::asio::io_context& ioc)
+        : socket_(std::move(socket)), owner_(owner), idle_timer_(ioc) {
+        boost::system::error_code ec;
+        auto ep = socket_.remote_endpoint(ec);
+        if (!ec) peer_ = ep.address().to_string() + ":" + std::to_string(ep.port());
+    }
+
+    void start() {
+        reset_idle();
+        read_header();
+    }
+
+    void stop() {
+        idle_timer_.cancel();
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+    }
+
+    const std::string& peer() const { return peer_; }
+    const std::string& hub() const { return hub_; }
+
+    void send(std::string packet) {
+        out_ = std::move(packet); // 只有 HELLO 的回覆，不會重疊
+        boost::asio::async_write(socket_, boost::asio::buffer(out_), [self = shared_from_this()](boost::system::error_code, size_t) {});
+    }
+
+private:
+    tcp::socket socket_;
+    Aggregator& owner_;
+    boost::asio::steady_timer idle_timer_;
+    std::string peer_;
+    std::string hub_;
+    char header_[UpstreamProtocol::HEADER_SIZE];
+    std::string body_;
+    std::string out_;
+    bool closed_ = false;
+
+    void read_header() {
+        boost::asio::async_read(socket_, boost::asio::buffer(header_), [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            if (ec) return self->close(ec.message());
+            uint32_t len = 0;
+            uint8_t kind = 0;
+            if (!UpstreamProtocol::parse_header(self->header_, len, kind)) return self->close("packet too large");
+            self->body_.resize(len);
+            boost::asio::async_read(self->socket_, boost::asio::buffer(self->body_), [self, kind](boost::system::error_code ec, size_t) {
+                if (ec) return self->close(ec.message());
+                self->reset_idle();
+                if (!self->handle(kind)) return;
+                self->read_header();
+            });
+        });
+    }
+
+    bool handle(uint8_t kind);
+
+    void reset_idle() {
+        idle_timer_.expires_after(IDLE_TIMEOUT);
+        idle_timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) self->close("idle timeout");
+        });
+    }
+
+    void close(const std::string& reason);
+};
+
+class Aggregator {
+public:
+    using tcp = boost::asio::ip::tcp;
+
+    struct Stats {
+        std::atomic<uint64_t> hubs_online{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> entries{0};
+        std::atomic<uint64_t> snapshots{0};
+        std::atomic<uint64_t> duplicates{0}; // 重連補送時已收過的推播
+        std::atomic<uint64_t> batch_gaps{0}; // batch_seq 不連續 (不應發生)
+        std::atomic<uint64_t> corrupt{0};
+        std::atomic<uint64_t> wire_bytes{0};
+    };
+
+    Aggregator(boost::asio::io_context& ioc, std::shared_ptr<WsSink> ws, int port)
+        : ioc_(ioc), acceptor_(ioc, tcp::endpoint(tcp::v4(), (unsigned short)port)), ws_(std::move(ws)) {
+        spdlog::info("[Aggregator] Listening for hubs on port {}", port);
+        do_accept();
+    }
+
+    const Stats& stats() const { return stats_; }
+
+    // 關閉流程 (任意執行緒)：停止接受新連線並關閉所有 Hub 連線
+    bool stop(std::chrono::milliseconds timeout) {
+        auto done = std::make_shared<std::promise<void>>();
+        auto result = done->get_future();
+        boost::asio::post(ioc_, [this, done]() {
+            boost::system::error_code ignored;
+            acceptor_.close(ignored);
+            for (auto& [id, hub] : hubs_) {
+                if (auto session = hub.session.lock()) session->stop();
+            }
+            boost::asio::post(ioc_, [done]() { done->set_value(); });
+        });
+        return result.wait_for(timeout) == std::future_status::ready;
+    }
+
+private:
+    friend class AggregatorSession;
+
+    struct Hub {
+        std::string id;
+        uint64_t boot = 0;
+        int64_t last_seq = -1; // 已收到的最後 Hub 序號 (-1 = 沒有可用的狀態)
+        uint64_t batch_seq = 0;
+        uint64_t batches = 0;
+        std::string peer;
+        std::weak_ptr<AggregatorSession> session;
+        std::unordered_map<std::string, SourceId> sources; // Hub 的來源名稱 -> 加上前綴後的來源 ID
+    };
+
+    boost::asio::io_context& ioc_;
+    tcp::acceptor acceptor_;
+    std::shared_ptr<WsSink> ws_;
+    Stats stats_;
+    std::map<std::string, Hub> hubs_; // 僅 io 執行緒存取
+    std::string scratch_;              // 解壓縮緩衝 (重複使用)
+
+    void do_accept() {
+        acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket) {
+            if (!acceptor_.is_open()) return; // 關閉流程
+            if (!ec) {
+                socket.set_option(tcp::no_delay(true), ec);
+                std::make_shared<AggregatorSession>(std::move(socket), *this, ioc_)->start();
+            }
+            do_accept();
+        });
+    }
+
+    // HELLO：同一個 Hub 的舊連線 (尚未逾時) 直接關閉；Hub 重啟 (boot 不同) 時要求完整快照
+    // 回傳 Hub ID (格式錯誤時為空字串)
+    std::string on_hello(const std::shared_ptr<AggregatorSession>& session, const std::string& body) {
+        json hello = json::parse(body, nullptr, false);
+        std::string id = hello.is_object() ? hello.value("hub", "") : "";
+        if (id.empty() || id.find('/') != std::string::npos) {
+            spdlog::warn("[Aggregator] Rejected hub from {} (invalid id '{}')", session->peer(), id);
+            stats_.corrupt.fetch_add(1, std::memory_order_relaxed);
+            return "";
+        }
+
+        Hub& hub = hubs_[id];
+        if (auto old = hub.session.lock()) {
+            spdlog::warn("[Aggregator] Hub {} reconnected from {}, closing previous connection {}", id, session->peer(), old->peer());
+            hub.session.reset();
+            old->stop();
+        } else {
+            stats_.hubs_online.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t boot = hello.value("boot", (uint64_t)0);
+        if (boot != hub.boot) hub.last_seq = -1;
+        hub.id = id;
+        hub.boot = boot;
+        hub.batch_seq = 0;
+        hub.peer = session->peer();
+        hub.session = session;
+
+        spdlog::info("[Aggregator] Hub {} connected from {} ({})", id, hub.peer,
+                     hub.last_seq < 0 ? "full snapshot" : "resume from " + std::to_string(hub.last_seq));
+        session->send(UpstreamProtocol::packet(UpstreamProtocol::WELCOME, json{{"since", hub.last_seq}}.dump()));
+        publish_status(hub, true);
+        return id;
+    }
+
+    bool on_batch(const std::string& hub_id, const std::string& body) {
+        auto it = hubs_.find(hub_id);
+        if (it == hubs_.end()) return false;
+        Hub& hub = it->second;
+
+        UpstreamProtocol::BatchHeader h;
+        std::string_view entries;
+        if (!UpstreamProtocol::parse_batch(body, h, scratch_, entries)) {
+            spdlog::warn("[Aggregator] Hub {} sent a corrupt batch", hub.id);
+            stats_.corrupt.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (h.batch_seq != hub.batch_seq + 1) {
+            spdlog::warn("[Aggregator] Hub {} batch gap: expected {}, got {}", hub.id, hub.batch_seq + 1, h.batch_seq);
+            stats_.batch_gaps.fetch_add(1, std::memory_order_relaxed);
+        }
+        hub.batch_seq = h.batch_seq;
+        ++hub.batches;
+
+        bool reset = h.flags & UpstreamProtocol::FLAG_RESET;
+        if (reset) {
+            // 完整快照取代該 Hub 的狀態：先清掉保留中的 hub/<hub>/* (狀態主題除外)，快照中沒有的主題 (e.g. 已移除的相機) 不再留在看板快照
+            stats_.snapshots.fetch_add(1, std::memory_order_relaxed);
+            ws_->drop_retained(Topics::hub(hub.id, ""), Topics::hub(hub.id, "status"));
+            ws_->publish(Topics::hub(hub.id, "status"), WsFrame::control("HUB_SNAPSHOT", {{"hub", hub.id}, {"seq", h.hub_seq}}));
+        }
+
+        TraceStamps trace;
+        trace.rx = trace.done = trace_now_ns();
+        int64_t since = hub.last_seq;
+        size_t count = 0;
+        bool ok = UpstreamProtocol::for_each_entry(entries, [&](const UpstreamProtocol::Entry& e) {
+            // 補送與前一條連線已送達的部分重疊時略過 (快照一律套用)
+            if (!reset && since >= 0 && (int32_t)(e.seq - (uint32_t)since) <= 0) {
+                stats_.duplicates.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ++count;
+            republish(hub, e, trace);
+        });
+        // 截斷的批次不前進序號：重連時 Hub 從上一批之後重送 (已套用的部分重複推播一次，不會遺失)
+        if (ok) hub.last_seq = h.hub_seq;
+        stats_.batches.fetch_add(1, std::memory_order_relaxed);
+        stats_.entries.fetch_add(count, std::memory_order_relaxed);
+        if (!ok) {
+            spdlog::warn("[Aggregator] Hub {} sent a truncated batch", hub.id);
+            stats_.corrupt.fetch_add(1, std::memory_order_relaxed);
+        }
+        return ok;
+    }
+
+    // Hub 推播的文字格式 (WsFrame::to_json) -> 加上 Hub 前綴重新建立 Frame (序號由本機 WsServer 重新編號)
+    void republish(Hub& hub, const UpstreamProtocol::Entry& e, const TraceStamps& trace) {
+        json msg = json::parse(e.text, nullptr, false);
+        if (!msg.is_object()) {
+            stats_.corrupt.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        WsFrame frame;
+        std::string type = msg.value("type", "");
+        if (type == "data") {
+            SourceId source = source_of(hub, msg.value("source", ""));
+            json payload = msg.contains("payload") ? std::move(msg["payload"]) : json();
+            uint8_t bits = 0;
+            frame = plc_bits(payload, bits) ? WsFrame::plc_state(source, bits) : WsFrame::data(source, std::move(payload));
+        } else if (type == "control") {
+            json payload = msg.contains("payload") ? std::move(msg["payload"]) : json::object();
+            if (payload.is_object()) payload["hub"] = hub.id;
+            frame = WsFrame::control(msg.value("command", ""), std::move(payload));
+        } else {
+            msg.erase("seq");
+            msg["hub"] = hub.id;
+            frame = WsFrame::info(std::move(msg));
+        }
+        ws_->publish(Topics::hub(hub.id, std::string(e.topic)), std::move(frame), trace, e.delivery);
+    }
+
+    SourceId source_of(Hub& hub, const std::string& name) {
+        auto it = hub.sources.find(name);
+        if (it != hub.sources.end()) return it->second;
+        SourceId id = Sources::id_of(hub.id + "/" + name);
+        if (id == Sources::NONE) spdlog::warn("[Aggregator] Source registry full, {}/{} sent without a name", hub.id, name);
+        hub.sources.emplace(name, id);
+        return id;
+    }
+
+    // PLC 狀態 (PLC_FIELDS 各為 0 / 1) 還原成 bit，二進位 Client 維持精簡格式
+    static bool plc_bits(const json& payload, uint8_t& bits) {
+        if (!payload.is_object() || payload.size() != (size_t)WsFrame::PLC_FIELD_COUNT) return false;
+        bits = 0;
+        for (int i = 0; i < WsFrame::PLC_FIELD_COUNT; ++i) {
+            auto it = payload.find(WsFrame::PLC_FIELDS[i]);
+            if (it == payload.end() || !it->is_number_integer()) return false;
+            if (it->get<int>()) bits |= (uint8_t)(1u << i);
+        }
+        return true;
+    }
+
+    void on_closed(const AggregatorSession* session, const std::string& reason) {
+        auto it = hubs_.find(session->hub());
+        if (it == hubs_.end() || it->second.session.lock().get() != session) return; // 已被新連線取代
+        Hub& hub = it->second;
+        hub.session.reset();
+        stats_.hubs_online.fetch_sub(1, std::memory_order_relaxed);
+        spdlog::warn("[Aggregator] Hub {} disconnected ({})", hub.id, reason);
+        publish_status(hub, false);
+    }
+
+    void publish_status(const Hub& hub, bool online) {
+        json status = {{"hub", hub.id}, {"online", online}, {"peer", hub.peer}, {"seq", hub.last_seq}, {"batches", hub.batches}};
+        ws_->publish(Topics::hub(hub.id, "status"), WsFrame::control("HUB_STATUS", std::move(status)), {}, Delivery::STATE);
+    }
+};
+
+inline bool AggregatorSession::handle(uint8_t kind) {
+    owner_.stats_.wire_bytes.fetch_add(UpstreamProtocol::HEADER_SIZE + body_.size(), std::memory_order_relaxed);
+    switch (kind) {
+        case UpstreamProtocol::HELLO:
+            if (hub_.empty()) hub_ = owner_.on_hello(shared_from_this(), body_);
+            else hub_.clear(); // 重複的 HELLO
+            if (hub_.empty()) {
+                close("bad hello");
+                return false;
+            }
+            return true;
+        case UpstreamProtocol::BATCH:
+            if (hub_.empty() || !owner_.on_batch(hub_, body_)) {
+                close("bad batch");
+                return false;
+            }
+            return true;
+        case UpstreamProtocol::PING:
+            return true;
+        default:
+            close("unknown packet");
+            return false;
+    }
+}
+
+inline void AggregatorSession::close(const std::string& reason) {
+    if (closed_) return;
+    closed_ = true;
+    stop();
+    owner_.on_closed(this, reason);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// 前端指令 request_id 追蹤 (WS 執行緒專用，不加鎖)
+//   - request_id 只在同一個 Client 範圍內比對 (key 見 key_of)：不同分頁各自從 1 編號也不會互相誤判
+//   - 指令送出後登記為 PENDING，完成 (e.g. PLC 寫入回應) 時回覆 CMD_ACK 給發出指令的 Client
+//   - WINDOW 內重複的 request_id 不再執行：已完成則重送原結果，未完成則回覆 PENDING；
+//     同一個 request_id 換了指令視為衝突，由呼叫端拒絕
+//   - 超過 TIMEOUT 仍未完成的指令回覆 TIMEOUT (e.g. PLC 斷線，寫入仍在佇列中)
+// ==============================================================================
+class RequestTracker {
+public:
+    static constexpr uint64_t WINDOW_NS = 30ULL * 1000 * 1000 * 1000;
+    static constexpr uint64_t TIMEOUT_NS = 5ULL * 1000 * 1000 * 1000;
+
+    struct Entry {
+        uint32_t client_id = 0;  // 最後一次送出這個 request_id 的連線 (CMD_ACK 回覆對象)
+        std::string request_id;  // Client 指定的原始 request_id
+        std::string command;
+        uint64_t rx_ns = 0;
+        bool done = false;
+        json result; // 完成後的 CMD_ACK payload
+    };
+
+    // scope：連線 URL 帶 "?client=<id>" 時使用該 id (重連後仍視為同一個 Client，可重送未收到的 ACK)，
+    //        否則為連線序號 (只在這條連線內去重)
+    static std::string key_of(const std::string& scope, const std::string& request_id) {
+        return scope + '\n' + request_id;
+    }
+
+    // 回傳 nullptr 表示新的 request_id (已登記)；否則回傳既有紀錄 (重複，ACK 改送到這次的連線)
+    Entry* begin(const std::string& key, const std::string& request_id, uint32_t client_id, std::string command, uint64_t now_ns) {
+        auto it = entries_.find(key);
+        if (it != entries_.end() && now_ns - it->second.rx_ns < WINDOW_NS) {
+            it->second.client_id = client_id;
+            return &it->second;
+        }
+
+        Entry e;
+        e.client_id = client_id;
+        e.request_id = request_id;
+        e.command = std::move(command);
+        e.rx_ns = now_ns;
+        entries_[key] = std::move(e);
+        return nullptr;
+    }
+
+    // 標記完成，回傳紀錄 (不存在或已完成回傳 nullptr，例如已逾時)
+    Entry* complete(const std::string& key, json result) {
+        auto it = entries_.find(key);
+        if (it == entries_.end() || it->second.done) return nullptr;
+        it->second.done = true;
+        it->second.result = std::move(result);
+        return &it->second;
+    }
+
+    // 清除超過 WINDOW 的紀錄，回傳逾時仍未完成的 key (由呼叫端以 TIMEOUT 完成)
+    std::vector<std::string> expire(uint64_t now_ns) {
+        std::vector<std::string> timed_out;
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            uint64_t age = now_ns - it->second.rx_ns;
+            if (age >= WINDOW_NS) {
+                it = entries_.erase(it);
+                continue;
+            }
+            if (!it->second.done && age >= TIMEOUT_NS) timed_out.push_back(it->first);
+            ++it;
+        }
+        return timed_out;
+    }
+
+    const Entry* find(const std::string& key) const {
+        auto it = entries_.find(key);
+        return it == entries_.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::unordered_map<std::string, Entry> entries_;
+};
\ No newline at end of file
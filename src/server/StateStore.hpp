@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "server/Topics.hpp"
+#include "server/WsProtocol.hpp"
+
+// ==============================================================================
+// 推播狀態庫 (WS 執行緒專用，不加鎖)
+// 每則推播都帶遞增序號 (WsFrame::seq)：
+//   latest: 每個可保留主題的最新一筆 (PLC 狀態、相機監控、各相機最後條碼)，連線時組成快照
+//   ring:   最近 RING_SIZE 筆推播，Client 斷線重連時補送遺漏的部分
+// 序號以 serial number 方式比較，u32 溢位後仍可正確判斷先後
+// ==============================================================================
+class StateStore {
+public:
+    static constexpr size_t RING_SIZE = 1024;
+
+    struct Entry {
+        std::string topic;
+        std::shared_ptr<const WsFrame> frame;
+        Delivery delivery = Delivery::EVENT; // 上傳給彙總端時沿用 (見 server/UpstreamRelay.hpp)
+    };
+
+    void record(const std::string& topic, Delivery delivery, bool retain, std::shared_ptr<const WsFrame> frame) {
+        last_seq_ = frame->seq();
+        if (retain) latest_[topic] = {topic, frame, delivery};
+        ring_.push_back({topic, std::move(frame), delivery});
+        if (ring_.size() > RING_SIZE) ring_.pop_front();
+    }
+
+    uint32_t last_seq() const { return last_seq_; }
+
+    // since 之後的所有推播 (依序)；since 已不在 ring 範圍內 (或來自上一次執行) 時回傳 false，改送快照
+    bool deltas_since(uint32_t since, std::vector<Entry>& out) const {
+        out.clear();
+        if (since == last_seq_) return true;
+        if (after(since, last_seq_)) return false;              // Client 序號比 Server 新：Server 已重啟
+        if (ring_.empty() || after(ring_.front().frame->seq(), since + 1)) return false; // 中間有缺
+        for (const auto& e : ring_) {
+            if (after(e.frame->seq(), since)) out.push_back(e);
+        }
+        return true;
+    }
+
+    // 移除 prefix 開頭的保留主題 (keep 除外)；ring 不動，已送出的推播仍可補送
+    size_t drop_retained(const std::string& prefix, const std::string& keep) {
+        size_t dropped = 0;
+        for (auto it = latest_.lower_bound(prefix); it != latest_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+            if (it->first == keep) { ++it; continue; }
+            it = latest_.erase(it);
+            ++dropped;
+        }
+        return dropped;
+    }
+
+    std::vector<Entry> snapshot() const {
+        std::vector<Entry> out;
+        out.reserve(latest_.size());
+        for (const auto& [topic, entry] : latest_) out.push_back(entry);
+        return out;
+    }
+
+private:
+    uint32_t last_seq_ = 0;
+    std::map<std::string, Entry> latest_;
+    std::deque<Entry> ring_;
+
+    // a 是否在 b 之後
+    static bool after(uint32_t a, uint32_t b) { return (int32_t)(a - b) > 0; }
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// WebSocket 訂閱主題 (Topic) 命名
+//   plc/<station>            PLC 狀態 (station = Hub IP)
+//   camera/<role>            相機條碼 (e.g. camera/CAMERA_LEFT_1)
+//   camera/<role>/monitor    相機監控事件 (TIMEOUT_BLANK)
+//   scanner                  掃碼槍輸入
+//   sys                      系統訊息 (離線快取、STATE_SYNC、指令回音)
+//   sys/watchdog             SLO 違反 / 恢復與目前降載項目 (STATE，新連線可從快照取得)
+//   hub/<hub>/<topic>        彙總模式：各 Hub 轉送上來的主題；hub/<hub>/status 為 Hub 連線狀態
+// 訂閱時可用結尾 "*" 做前綴比對 (e.g. "camera/*")，單獨 "*" 代表全部；"!" 開頭為排除規則
+
+// 慢速 Client 的送達語意 (各來源使用哪一種見 logic/Routes.hpp)
+//   STATE: 週期性狀態 (PLC 監控、相機監控)，落後時只保留每個主題的最新一筆
+//   EVENT: 條碼、指令回音等，不可合併，需依序送達
+enum class Delivery { EVENT, STATE };
+
+class Topics {
+public:
+    static constexpr const char* SYS = "sys";
+    static constexpr const char* SCANNER = "scanner";
+    static constexpr const char* WATCHDOG = "sys/watchdog";
+
+    static std::string plc(const std::string& station) {
+        return "plc/" + (station.empty() ? std::string("local") : station);
+    }
+
+    static std::string camera(const std::string& role) { return "camera/" + role; }
+
+    // 依訊息來源決定主題
+    static std::string for_source(const std::string& source) {
+        static const std::string monitor_suffix = "_MONITOR";
+        if (source.rfind("CAMERA", 0) == 0) {
+            if (source.size() > monitor_suffix.size() &&
+                source.compare(source.size() - monitor_suffix.size(), monitor_suffix.size(), monitor_suffix) == 0) {
+                return camera(source.substr(0, source.size() - monitor_suffix.size())) + "/monitor";
+            }
+            return camera(source);
+        }
+        if (source == "SCANNER") return SCANNER;
+        return SYS;
+    }
+
+    // 彙總模式 (server/Aggregator.hpp)：各 Hub 的主題加上前綴，e.g. hub/line3/camera/CAMERA_LEFT_1
+    static std::string hub(const std::string& hub_id, const std::string& topic) {
+        return "hub/" + hub_id + "/" + topic;
+    }
+
+    // 相機條碼主題 (含彙總模式下各 Hub 的相機)，最後一筆條碼保留在快照中
+    static bool is_camera(const std::string& topic) {
+        if (topic.rfind("camera/", 0) == 0) return true;
+        if (topic.rfind("hub/", 0) != 0) return false;
+        size_t slash = topic.find('/', 4);
+        return slash != std::string::npos && topic.compare(slash + 1, 7, "camera/") == 0;
+    }
+
+    static bool matches(const std::string& pattern, const std::string& topic) {
+        return matches(pattern, 0, topic);
+    }
+
+    // Client 的訂閱規則：符合任一規則、且不符合任何排除規則 ("!" 開頭，e.g. "!camera/CAMERA_LEFT_1/monitor")
+    static bool wanted(const std::vector<std::string>& patterns, const std::string& topic) {
+        bool want = false;
+        for (const auto& pattern : patterns) {
+            bool exclude = !pattern.empty() && pattern[0] == '!';
+            if (exclude && matches(pattern, 1, topic)) return false;
+            if (!exclude && !want) want = matches(pattern, 0, topic);
+        }
+        return want;
+    }
+
+private:
+    // pattern 從 from 開始的部分；結尾 * 為前綴比對
+    static bool matches(const std::string& pattern, size_t from, const std::string& topic) {
+        if (pattern.size() > from && pattern.back() == '*') {
+            return topic.compare(0, pattern.size() - 1 - from, pattern, from, pattern.size() - 1 - from) == 0;
+        }
+        return topic.compare(0, std::string::npos, pattern, from, std::string::npos) == 0;
+    }
+};
\ No newline at end of file
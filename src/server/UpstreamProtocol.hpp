@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "server/Topics.hpp"
+#include "server/WsProtocol.hpp"
+
+// ==============================================================================
+// Hub -> 彙總端 (Aggregator) 上傳協定 (TCP，所有整數 little-endian)
+// 每個封包：u32 body_len + u8 kind + body
+//   HELLO    (Hub -> 彙總端) JSON {"hub": <id>, "boot": <啟動識別>, "version": 1}
+//   WELCOME  (彙總端 -> Hub) JSON {"since": <已收到的最後 Hub 序號，-1 = 需要完整快照>}
+//   BATCH    (Hub -> 彙總端) u64 batch_seq, u8 flags, u32 hub_seq, u32 raw_len, entries
+//            batch_seq 每條連線從 1 遞增 (檢查缺漏)；hub_seq 為此批涵蓋到的 Hub 推播序號 (WsFrame::seq)
+//            flags: FLAG_RESET = entries 是完整快照 (取代彙總端手上該 Hub 的狀態)
+//                   FLAG_DEFLATE = entries 以 Deflate::compress 壓縮，raw_len 為壓縮前長度
+//            entry: u8 delivery, u32 seq, u16 topic_len, topic, u32 text_len, text (WsFrame::text())
+//   PING     (Hub -> 彙總端) 閒置時的保活，body 為空
+// ==============================================================================
+class UpstreamProtocol {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr int DEFAULT_PORT = 7070;
+    static constexpr size_t HEADER_SIZE = 5;
+    static constexpr size_t BATCH_HEADER_SIZE = 17;
+    static constexpr size_t MAX_BODY = 16 * 1024 * 1024;
+
+    enum Kind : uint8_t { HELLO = 1, WELCOME = 2, BATCH = 3, PING = 4 };
+
+    static constexpr uint8_t FLAG_RESET = 0x01;
+    static constexpr uint8_t FLAG_DEFLATE = 0x02;
+
+    struct Entry {
+        Delivery delivery = Delivery::EVENT;
+        uint32_t seq = 0;
+        std::string_view topic;
+        std::string_view text;
+    };
+
+    struct BatchHeader {
+        uint64_t batch_seq = 0;
+        uint8_t flags = 0;
+        uint32_t hub_seq = 0;
+        uint32_t raw_len = 0;
+    };
+
+    // 封包標頭 (body 由呼叫端接在後面)
+    static void put_header(std::string& out, Kind kind, size_t body_len) {
+        put_u32(out, (uint32_t)body_len);
+        out.push_back((char)kind);
+    }
+
+    static std::string packet(Kind kind, const std::string& body) {
+        std::string out;
+        out.reserve(HEADER_SIZE + body.size());
+        put_header(out, kind, body.size());
+        out += body;
+        return out;
+    }
+
+    static void put_entry(std::string& out, Delivery delivery, uint32_t seq, const std::string& topic, const std::string& text) {
+        size_t topic_len = std::min<size_t>(topic.size(), 0xFFFF);
+        out.push_back((char)delivery);
+        put_u32(out, seq);
+        put_u16(out, (uint16_t)topic_len);
+        out.append(topic, 0, topic_len);
+        put_u32(out, (uint32_t)text.size());
+        out += text;
+    }
+
+    static size_t entry_size(const std::string& topic, const std::string& text) {
+        return 11 + std::min<size_t>(topic.size(), 0xFFFF) + text.size();
+    }
+
+    // 完整 BATCH 封包：entries 夠大且壓得下去時壓縮
+    static std::string batch(uint64_t batch_seq, uint8_t flags, uint32_t hub_seq, const std::string& entries) {
+        std::string out;
+        out.reserve(HEADER_SIZE + BATCH_HEADER_SIZE + entries.size());
+        put_header(out, BATCH, 0); // 長度最後回填
+        put_u64(out, batch_seq);
+        size_t flags_at = out.size();
+        out.push_back((char)flags);
+        put_u32(out, hub_seq);
+        put_u32(out, (uint32_t)entries.size());
+        bool deflated = false;
+        if (entries.size() >= COMPRESS_MIN_BYTES) {
+            size_t base = out.size();
+            deflated = Deflate::compress(entries.data(), entries.size(), out);
+            if (!deflated) out.resize(base);
+        }
+        if (deflated) out[flags_at] = (char)(flags | FLAG_DEFLATE);
+        else out += entries;
+
+        uint32_t body_len = (uint32_t)(out.size() - HEADER_SIZE);
+        for (int i = 0; i < 4; ++i) out[i] = (char)((body_len >> (8 * i)) & 0xFF);
+        return out;
+    }
+
+    // 封包標頭：body_len 超過 MAX_BODY 視為協定錯誤
+    static bool parse_header(const char* p, uint32_t& body_len, uint8_t& kind) {
+        body_len = get_u32(p);
+        kind = (uint8_t)p[4];
+        return body_len <= MAX_BODY;
+    }
+
+    // BATCH body -> 標頭 + 解壓後的 entries (未壓縮時直接引用 body)
+    static bool parse_batch(std::string_view body, BatchHeader& h, std::string& scratch, std::string_view& entries) {
+        if (body.size() < BATCH_HEADER_SIZE) return false;
+        const char* p = body.data();
+        h.batch_seq = get_u64(p);
+        h.flags = (uint8_t)p[8];
+        h.hub_seq = get_u32(p + 9);
+        h.raw_len = get_u32(p + 13);
+        std::string_view payload = body.substr(BATCH_HEADER_SIZE);
+        if (!(h.flags & FLAG_DEFLATE)) {
+            entries = payload;
+            return payload.size() == h.raw_len;
+        }
+        if (h.raw_len > MAX_BODY * 8) return false;
+        scratch.clear();
+        if (!Deflate::decompress(payload.data(), payload.size(), h.raw_len, scratch)) return false;
+        entries = scratch;
+        return true;
+    }
+
+    // 逐筆讀出 entries；格式錯誤時回傳 false (已讀出的部分仍有效)
+    template <typename F>
+    static bool for_each_entry(std::string_view entries, F&& fn) {
+        size_t pos = 0;
+        while (pos < entries.size()) {
+            if (entries.size() - pos < 7) return false;
+            Entry e;
+            e.delivery = (uint8_t)entries[pos] == (uint8_t)Delivery::STATE ? Delivery::STATE : Delivery::EVENT;
+            e.seq = get_u32(entries.data() + pos + 1);
+            size_t topic_len = get_u16(entries.data() + pos + 5);
+            pos += 7;
+            if (entries.size() - pos < topic_len + 4) return false;
+            e.topic = entries.substr(pos, topic_len);
+            pos += topic_len;
+            size_t text_len = get_u32(entries.data() + pos);
+            pos += 4;
+            if (entries.size() - pos < text_len) return false;
+            e.text = entries.substr(pos, text_len);
+            pos += text_len;
+            fn(e);
+        }
+        return true;
+    }
+
+private:
+    static void put_u16(std::string& out, uint16_t v) {
+        out.push_back((char)(v & 0xFF));
+        out.push_back((char)(v >> 8));
+    }
+    static void put_u32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back((char)((v >> (8 * i)) & 0xFF));
+    }
+    static void put_u64(std::string& out, uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back((char)((v >> (8 * i)) & 0xFF));
+    }
+    static uint16_t get_u16(const char* p) {
+        return (uint16_t)((uint8_t)p[0] | ((uint8_t)p[1] << 8));
+    }
+    static uint32_t get_u32(const char* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; --i) v = (v << 8) | (uint8_t)p[i];
+        return v;
+    }
+    static uint64_t get_u64(const char* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; --i) v = (v << 8) | (uint8_t)p[i];
+        return v;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,369 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include "server/StateStore.hpp"
+#include "server/UpstreamProtocol.hpp"
+
+// ==============================================================================
+// 上傳中繼 (Hub 端)：與彙總端 (server/Aggregator.hpp) 維持一條 TCP 長連線，
+// 把 WsServer 的推播以「批次 + 序號 + 壓縮」的形式往上送 (協定見 UpstreamProtocol.hpp)
+//   - 連線後彙總端回覆已收到的最後 Hub 序號：仍在 StateStore ring 內則只補送遺漏的推播，否則送完整快照
+//   - 每 FLUSH_MS 送出一批；同一批內 STATE 類主題只保留最新一筆 (PLC 狀態、相機監控)
+//   - 上一批還沒寫完時新的推播繼續累積；累積超過 max_pending_bytes 則丟棄並改送快照重新同步
+//   - 斷線後 1 -> 10 秒退避重連
+// 執行緒：連線 / 計時 / 寫入在 io 執行緒；offer / begin_stream 由 WsServer 在 WS 執行緒呼叫
+// ==============================================================================
+class UpstreamRelay : public std::enable_shared_from_this<UpstreamRelay> {
+public:
+    using tcp = boost::asio::ip::tcp;
+
+    // 連線建立後要求 WS 執行緒呼叫 begin_stream (generation: 連線代號；since: 彙總端已收到的最後序號，-1 = 送快照)
+    using SyncHandler = std::function<void(uint64_t generation, int64_t since)>;
+
+    struct Options {
+        std::string host;
+        int port = UpstreamProtocol::DEFAULT_PORT;
+        std::string hub_id;
+        int flush_ms = 50;
+        size_t max_pending_bytes = 4 * 1024 * 1024;
+    };
+
+    struct Stats {
+        std::atomic<uint64_t> connects{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> entries{0};
+        std::atomic<uint64_t> raw_bytes{0};   // entries 壓縮前
+        std::atomic<uint64_t> wire_bytes{0};  // 實際送出 (含標頭)
+        std::atomic<uint64_t> conflated{0};   // 同一批內被較新狀態取代
+        std::atomic<uint64_t> snapshots{0};   // 以完整快照同步
+        std::atomic<uint64_t> resumes{0};     // 只補送遺漏的推播
+        std::atomic<uint64_t> overflows{0};   // 累積過多而丟棄重新同步
+    };
+
+    UpstreamRelay(boost::asio::io_context& ioc, Options opt)
+        : ioc_(ioc), opt_(std::move(opt)), socket_(ioc), resolver_(ioc), flush_timer_(ioc), retry_timer_(ioc), stop_timer_(ioc) {
+        boot_ = (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+    }
+
+    void set_sync_handler(SyncHandler fn) { on_sync_ = std::move(fn); }
+
+    // 未指定 Hub ID 時由啟動流程在設定載入後補上 (start 之前呼叫)
+    void set_hub_id(std::string id) { opt_.hub_id = std::move(id); }
+
+    const Options& options() const { return opt_; }
+    const Stats& stats() const { return stats_; }
+    bool connected() const { return connected_.load(std::memory_order_relaxed); }
+
+    // 開始連線 (任意執行緒)
+    void start() {
+        boost::asio::post(ioc_, [self = shared_from_this()]() {
+            self->stopped_ = false;
+            self->backoff_ = std::chrono::seconds(1);
+            if (!self->socket_.is_open() && !self->retrying_) self->connect();
+        });
+    }
+
+    // 關閉流程 (任意執行緒)：送出已累積的推播後關閉連線，不再重連
+    bool stop(std::chrono::milliseconds timeout) {
+        auto done = std::make_shared<std::promise<void>>();
+        auto result = done->get_future();
+        boost::asio::post(ioc_, [self = shared_from_this(), done]() {
+            self->stopped_ = true;
+            self->retry_timer_.cancel();
+            self->flush();
+            self->close_when_idle(done);
+        });
+        return result.wait_for(timeout) == std::future_status::ready;
+    }
+
+    // WS 執行緒：每則推播在編號後呼叫 (未同步完成前直接忽略，由 begin_stream 的補送 / 快照涵蓋)
+    void offer(const std::string& topic, Delivery delivery, const WsFrame& frame) {
+        if (!streaming_.load(std::memory_order_acquire)) return;
+        const std::string& text = frame.text();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!streaming_.load(std::memory_order_relaxed)) return;
+        append(topic, delivery, frame.seq(), text);
+        hub_seq_ = frame.seq();
+        if (pending_bytes_ > opt_.max_pending_bytes) {
+            stats_.overflows.fetch_add(1, std::memory_order_relaxed);
+            clear_pending();
+            streaming_.store(false, std::memory_order_release);
+            uint64_t gen = generation_;
+            boost::asio::post(ioc_, [self = shared_from_this(), gen]() { self->resync(gen); });
+        }
+    }
+
+    // WS 執行緒：回應 SyncHandler。reset = true 時 entries 為完整快照；hub_seq 為 StateStore 目前的最新序號
+    void begin_stream(uint64_t generation, bool reset, uint32_t hub_seq, const std::vector<StateStore::Entry>& entries) {
+        std::vector<std::string> texts;
+        texts.reserve(entries.size());
+        for (const auto& e : entries) texts.push_back(e.frame->text()); // 編碼快取只能在 WS 執行緒讀取
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_ || !connected_.load(std::memory_order_relaxed)) return; // 已斷線 / 重連
+        clear_pending();
+        reset_ = reset;
+        hub_seq_ = hub_seq;
+        for (size_t i = 0; i < entries.size(); ++i) append(entries[i].topic, entries[i].delivery, entries[i].frame->seq(), texts[i]);
+        (reset ? stats_.snapshots : stats_.resumes).fetch_add(1, std::memory_order_relaxed);
+        sync_pending_ = true;
+        streaming_.store(true, std::memory_order_release);
+    }
+
+private:
+    static constexpr auto PING_INTERVAL = std::chrono::seconds(5);
+    static constexpr auto MAX_BACKOFF = std::chrono::seconds(10);
+
+    struct Pending {
+        Delivery delivery;
+        uint32_t seq;
+        std::string topic;
+        std::string text;
+    };
+
+    boost::asio::io_context& ioc_;
+    Options opt_;
+    Stats stats_;
+    SyncHandler on_sync_;
+    uint64_t boot_ = 0;
+
+    // 以下僅 io 執行緒存取
+    tcp::socket socket_;
+    tcp::resolver resolver_;
+    boost::asio::steady_timer flush_timer_;
+    boost::asio::steady_timer retry_timer_;
+    boost::asio::steady_timer stop_timer_;
+    std::chrono::seconds backoff_{1};
+    bool stopped_ = false;
+    bool retrying_ = false; // 讀 / 寫同時失敗時只排一次重連
+    bool writing_ = false;
+    uint64_t batch_seq_ = 0;
+    uint32_t sent_seq_ = 0; // 已交給 Socket 的最後 Hub 序號
+    std::chrono::steady_clock::time_point last_write_;
+    char header_[UpstreamProtocol::HEADER_SIZE];
+    std::string read_body_;
+    std::string out_;
+
+    // offer / begin_stream (WS 執行緒) 與 flush (io 執行緒) 共用
+    std::mutex mutex_;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> streaming_{false};
+    uint64_t generation_ = 0;
+    std::vector<Pending> pending_;
+    std::unordered_map<std::string, size_t> state_index_; // STATE 主題 -> pending_ 位置
+    size_t pending_bytes_ = 0;
+    uint32_t hub_seq_ = 0;
+    bool reset_ = false;
+    bool sync_pending_ = false; // begin_stream 後至少送一批 (即使沒有內容也要帶上 hub_seq)
+
+    // 呼叫端持有 mutex_
+    void append(const std::string& topic, Delivery delivery, uint32_t seq, const std::string& text) {
+        if (delivery == Delivery::STATE) {
+            auto it = state_index_.find(topic);
+            if (it != state_index_.end()) {
+                Pending& p = pending_[it->second];
+                pending_bytes_ = pending_bytes_ - p.text.size() + text.size();
+                p.seq = seq;
+                p.text = text;
+                stats_.conflated.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            state_index_.emplace(topic, pending_.size());
+        }
+        pending_.push_back({delivery, seq, topic, text});
+        pending_bytes_ += UpstreamProtocol::entry_size(topic, text);
+    }
+
+    void clear_pending() {
+        pending_.clear();
+        state_index_.clear();
+        pending_bytes_ = 0;
+        reset_ = false;
+        sync_pending_ = false;
+    }
+
+    void connect() {
+        if (stopped_) return;
+        resolver_.async_resolve(opt_.host, std::to_string(opt_.port),
+            [self = shared_from_this()](boost::system::error_code ec, tcp::resolver::results_type results) {
+                if (ec) return self->fail("resolve", ec);
+                boost::asio::async_connect(self->socket_, results, [self](boost::system::error_code ec, const tcp::endpoint&) {
+                    if (ec) return self->fail("connect", ec);
+                    self->socket_.set_option(tcp::no_delay(true), ec);
+                    self->send_hello();
+                });
+            });
+    }
+
+    void send_hello() {
+        json hello = {{"hub", opt_.hub_id}, {"boot", boot_}, {"version", UpstreamProtocol::VERSION}};
+        out_ = UpstreamProtocol::packet(UpstreamProtocol::HELLO, hello.dump());
+        boost::asio::async_write(socket_, boost::asio::buffer(out_), [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            if (ec) return self->fail("hello", ec);
+            self->read_packet();
+        });
+    }
+
+    // 彙總端只會送 WELCOME；之後的讀取僅用來偵測斷線
+    void read_packet() {
+        boost::asio::async_read(socket_, boost::asio::buffer(header_), [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            if (ec) return self->fail("read", ec);
+            uint32_t len = 0;
+            uint8_t kind = 0;
+            if (!UpstreamProtocol::parse_header(self->header_, len, kind)) return self->fail("read", boost::asio::error::message_size);
+            self->read_body_.resize(len);
+            boost::asio::async_read(self->socket_, boost::asio::buffer(self->read_body_), [self, kind](boost::system::error_code ec, size_t) {
+                if (ec) return self->fail("read", ec);
+                if (kind == UpstreamProtocol::WELCOME) self->on_welcome();
+                self->read_packet();
+            });
+        });
+    }
+
+    void on_welcome() {
+        json welcome = json::parse(read_body_, nullptr, false);
+        int64_t since = welcome.is_object() ? welcome.value("since", (int64_t)-1) : -1;
+        uint64_t gen;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            gen = ++generation_;
+            clear_pending();
+            connected_.store(true, std::memory_order_relaxed);
+        }
+        stats_.connects.fetch_add(1, std::memory_order_relaxed);
+        backoff_ = std::chrono::seconds(1);
+        batch_seq_ = 0;
+        last_write_ = std::chrono::steady_clock::now();
+        spdlog::info("[Upstream] Connected to {}:{} as {} ({})", opt_.host, opt_.port, opt_.hub_id,
+                     since < 0 ? "full snapshot" : "resume from " + std::to_string(since));
+        if (on_sync_) on_sync_(gen, since);
+        schedule_flush();
+    }
+
+    // 累積過多：從最後送出的序號重新同步 (補送或快照由 WS 執行緒決定)
+    void resync(uint64_t generation) {
+        if (generation != generation_ || !connected_.load(std::memory_order_relaxed)) return;
+        spdlog::warn("[Upstream] Pending deltas exceeded {} bytes, resyncing from seq {}", opt_.max_pending_bytes, sent_seq_);
+        if (on_sync_) on_sync_(generation, (int64_t)sent_seq_);
+    }
+
+    void schedule_flush() {
+        flush_timer_.expires_after(std::chrono::milliseconds(opt_.flush_ms));
+        flush_timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (ec || !self->connected_.load(std::memory_order_relaxed)) return;
+            self->flush();
+            self->schedule_flush();
+        });
+    }
+
+    void flush() {
+        if (writing_ || !connected_.load(std::memory_order_relaxed)) return;
+
+        std::vector<Pending> batch;
+        uint8_t flags = 0;
+        uint32_t hub_seq = 0;
+        bool sync = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(pending_);
+            state_index_.clear();
+            pending_bytes_ = 0;
+            if (reset_) flags |= UpstreamProtocol::FLAG_RESET;
+            reset_ = false;
+            sync = sync_pending_;
+            sync_pending_ = false;
+            hub_seq = hub_seq_;
+        }
+
+        if (batch.empty() && !sync) {
+            if (std::chrono::steady_clock::now() - last_write_ >= PING_INTERVAL) {
+                write(UpstreamProtocol::packet(UpstreamProtocol::PING, ""));
+            }
+            return;
+        }
+
+        std::string entries;
+        size_t raw = 0;
+        for (const auto& p : batch) raw += UpstreamProtocol::entry_size(p.topic, p.text);
+        entries.reserve(raw);
+        for (const auto& p : batch) UpstreamProtocol::put_entry(entries, p.delivery, p.seq, p.topic, p.text);
+
+        sent_seq_ = hub_seq;
+        stats_.batches.fetch_add(1, std::memory_order_relaxed);
+        stats_.entries.fetch_add(batch.size(), std::memory_order_relaxed);
+        stats_.raw_bytes.fetch_add(entries.size(), std::memory_order_relaxed);
+        write(UpstreamProtocol::batch(++batch_seq_, flags, hub_seq, entries));
+    }
+
+    void write(std::string packet) {
+        writing_ = true;
+        last_write_ = std::chrono::steady_clock::now();
+        stats_.wire_bytes.fetch_add(packet.size(), std::memory_order_relaxed);
+        out_ = std::move(packet);
+        boost::asio::async_write(socket_, boost::asio::buffer(out_), [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            self->writing_ = false;
+            if (ec) self->fail("write", ec);
+        });
+    }
+
+    void close_when_idle(std::shared_ptr<std::promise<void>> done) {
+        bool idle = !writing_;
+        if (idle && connected_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle = pending_.empty();
+        }
+        if (!idle) {
+            // 還在寫：稍後再檢查 (寫完後 flush 送出剩餘內容)
+            stop_timer_.expires_after(std::chrono::milliseconds(10));
+            stop_timer_.async_wait([self = shared_from_this(), done](boost::system::error_code) {
+                self->flush();
+                self->close_when_idle(done);
+            });
+            return;
+        }
+        disconnect();
+        done->set_value();
+        if (!stopped_) connect(); // 關閉期間又呼叫了 start
+    }
+
+    void disconnect() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connected_.store(false, std::memory_order_relaxed);
+            streaming_.store(false, std::memory_order_release);
+            clear_pending();
+        }
+        flush_timer_.cancel();
+        boost::system::error_code ignored;
+        socket_.shutdown(tcp::socket::shutdown_both, ignored);
+        socket_.close(ignored);
+    }
+
+    void fail(const char* what, boost::system::error_code ec) {
+        if (ec == boost::asio::error::operation_aborted) return; // 自己關閉的連線
+        bool was_connected = connected_.load(std::memory_order_relaxed);
+        disconnect();
+        if (stopped_ || retrying_) return;
+        if (was_connected) spdlog::warn("[Upstream] Connection lost ({}: {}). Reconnecting...", what, ec.message());
+        else spdlog::debug("[Upstream] {} {}:{} failed: {}", what, opt_.host, opt_.port, ec.message());
+
+        retrying_ = true;
+        retry_timer_.expires_after(backoff_);
+        backoff_ = std::min<std::chrono::seconds>(backoff_ * 2, MAX_BACKOFF);
+        retry_timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            self->retrying_ = false;
+            if (!ec) self->connect();
+        });
+    }
+};
\ No newline at end of file
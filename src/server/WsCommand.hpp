@@ -0,0 +1,144 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "core/Command.hpp"
+
+// ==============================================================================
+// 前端指令快速解析
+// 只掃描最外層物件取出 "command" 與 "payload" 的原始片段，不建立 JSON DOM；
+// HEARTBEAT 等由 WsServer 直接回覆的指令全程不配置記憶體，
+// 只有真正要進 Bus 的指令才把 payload 片段交給 json::parse
+// ==============================================================================
+
+struct WsCommand {
+    Command type = Command::NONE;
+    std::string_view name;    // "command" 字串內容 (不含引號，含跳脫字元時為原始內容)
+    std::string_view payload; // "payload" 值的原始 JSON 片段 (沒有則為空)
+    std::string_view request_id; // Client 指定的 "request_id" (字串去引號，數字為原始文字；沒有則為空)
+    bool escaped_name = false;
+};
+
+class WsCommandScanner {
+public:
+    // 解析失敗 (不是 JSON 物件 / 結構不完整) 回傳 false
+    static bool scan(std::string_view in, WsCommand& out) {
+        out = WsCommand{};
+        bool ok = for_each_member(in, [&](std::string_view key, std::string_view value) {
+            if (key == "command" && value.size() >= 2 && value.front() == '"') {
+                out.name = value.substr(1, value.size() - 2);
+                out.escaped_name = out.name.find('\\') != std::string_view::npos;
+            } else if (key == "payload") {
+                out.payload = value;
+            } else if (key == "request_id") {
+                bool quoted = value.size() >= 2 && value.front() == '"';
+                out.request_id = quoted ? value.substr(1, value.size() - 2) : value;
+                if (out.request_id == "null") out.request_id = {};
+            }
+        });
+        if (!ok) return false;
+        out.type = out.escaped_name ? Command::UNKNOWN : command_from_name(out.name);
+        return true;
+    }
+
+    // 讀取物件片段中最外層的整數欄位 (小數只取整數部分)
+    static bool find_int(std::string_view object, std::string_view key, int64_t& value) {
+        bool found = false;
+        for_each_member(object, [&](std::string_view k, std::string_view v) {
+            if (found || k != key) return;
+            auto res = std::from_chars(v.data(), v.data() + v.size(), value);
+            found = res.ec == std::errc();
+        });
+        return found;
+    }
+
+    // 預先格式化的 HEARTBEAT_ACK (文字模式)，buf 由呼叫端重複使用
+    static const std::string& format_heartbeat_ack(std::string& buf, int64_t server_ts, int64_t client_ts) {
+        static constexpr std::string_view head = R"({"type":"control","command":"HEARTBEAT_ACK","payload":{"server_ts":)";
+        static constexpr std::string_view mid = R"(,"client_ts":)";
+        char num[24];
+        buf.assign(head);
+        buf.append(num, std::to_chars(num, num + sizeof(num), server_ts).ptr);
+        buf.append(mid);
+        buf.append(num, std::to_chars(num, num + sizeof(num), client_ts).ptr);
+        buf.append("}}");
+        return buf;
+    }
+
+private:
+    // 走訪最外層物件的每個成員：f(key, value 原始片段)
+    template <typename F>
+    static bool for_each_member(std::string_view in, F&& f) {
+        size_t i = 0;
+        skip_ws(in, i);
+        if (i >= in.size() || in[i] != '{') return false;
+        ++i;
+        skip_ws(in, i);
+        if (i < in.size() && in[i] == '}') return true;
+
+        while (i < in.size()) {
+            if (in[i] != '"') return false;
+            size_t key_begin = i + 1;
+            if (!skip_string(in, i)) return false;
+            std::string_view key = in.substr(key_begin, i - key_begin - 1);
+
+            skip_ws(in, i);
+            if (i >= in.size() || in[i] != ':') return false;
+            ++i;
+            skip_ws(in, i);
+
+            size_t value_begin = i;
+            if (!skip_value(in, i)) return false;
+            f(key, in.substr(value_begin, i - value_begin));
+
+            skip_ws(in, i);
+            if (i >= in.size()) return false;
+            if (in[i] == '}') return true;
+            if (in[i] != ',') return false;
+            ++i;
+            skip_ws(in, i);
+        }
+        return false;
+    }
+
+    static void skip_ws(std::string_view in, size_t& i) {
+        while (i < in.size() && (in[i] == ' ' || in[i] == '\t' || in[i] == '\n' || in[i] == '\r')) ++i;
+    }
+
+    // i 指向開頭的 '"'，結束時指向結尾 '"' 的下一個字元
+    static bool skip_string(std::string_view in, size_t& i) {
+        for (++i; i < in.size(); ++i) {
+            if (in[i] == '\\') { ++i; continue; }
+            if (in[i] == '"') { ++i; return true; }
+        }
+        return false;
+    }
+
+    static bool skip_value(std::string_view in, size_t& i) {
+        if (i >= in.size()) return false;
+        char c = in[i];
+        if (c == '"') return skip_string(in, i);
+        if (c == '{' || c == '[') {
+            int depth = 0;
+            while (i < in.size()) {
+                char ch = in[i];
+                if (ch == '"') {
+                    if (!skip_string(in, i)) return false;
+                    continue;
+                }
+                if (ch == '{' || ch == '[') ++depth;
+                else if (ch == '}' || ch == ']') {
+                    if (--depth == 0) { ++i; return true; }
+                }
+                ++i;
+            }
+            return false;
+        }
+        // number / true / false / null
+        size_t begin = i;
+        while (i < in.size() && in[i] != ',' && in[i] != '}' && in[i] != ']' &&
+               in[i] != ' ' && in[i] != '\t' && in[i] != '\n' && in[i] != '\r') ++i;
+        return i > begin;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,397 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <zlib.h>
+#include "core/Sources.hpp"
+
+using json = nlohmann::json;
+
+// ==============================================================================
+// WebSocket 推播格式
+// 預設為 JSON 文字 (既有前端)；連線時帶 "?proto=bin" 或
+// Sec-WebSocket-Protocol: lpsm.bin 的 Client 改收二進位格式：
+//
+//   Header (16 bytes, little-endian)
+//     u8  version (=1)
+//     u8  type     (FrameType)
+//     u16 source_id (見 SOURCE_TABLE)
+//     u32 seq
+//     u64 ts_us    (Unix epoch, us)
+//   Payload
+//     PLC_STATE     u8 bit_count + packed bits (bit0 = up_in ... 見 PLC_FIELDS)
+//     BARCODE       u16 len + bytes
+//     DATA          CBOR (一般 payload)
+//     CONTROL       u8 len + command + CBOR payload
+//                   (SNAPSHOT 的 items 為各 Frame 的二進位編碼，以 CBOR byte string 存放)
+//     INFO          CBOR (整個訊息物件，e.g. 連線歡迎訊息)
+//     SOURCE_TABLE  u16 count + { u16 id, u8 len, name }...
+//
+// 壓縮 (COMPRESS_MIN_BYTES 以上的 Frame)
+//   文字：permessage-deflate (uWS SHARED_COMPRESSOR，server_no_context_takeover)；
+//         訊息內容在 frame 上壓縮一次 (text_wire)，有協商壓縮的文字 Client 共用，
+//         以 uWS 的 ALREADY_COMPRESSED 送出 (需 uWebSockets v20.44 以上)
+//   二進位：type 的最高位元 (FLAG_DEFLATE) 為 1 時，Header 之後的 payload 為 raw deflate，
+//           並使用 DEFLATE_DICTIONARY 作為預設字典 (Client 端 inflateRaw 需帶相同字典)；
+//           每則 Frame 只壓縮一次，所有二進位 Client 共用
+// ==============================================================================
+
+static constexpr size_t COMPRESS_MIN_BYTES = 512;
+static constexpr uint8_t FLAG_DEFLATE = 0x80;
+
+// 常見欄位 / 數值 (越常出現的放越後面，deflate 對字典尾端的距離較短)
+static constexpr const char DEFLATE_DICTIONARY[] =
+    "TIMEOUT_BLANKSTEP_UPDATEGO_NOGOSNAPSHOTRESUMEDSUBSCRIPTIONSSTATE_SYNC"
+    "work_orderpanelmodelstationresultstatustimestampcreated_atbarcode"
+    "CAMERA_LEFT_GROUPCAMERA_RIGHT_GROUPCAMERA_LEFT_1CAMERA_LEFT_2CAMERA_RIGHT_1CAMERA_RIGHT_2"
+    "OFFLINE_CACHE_LOADEDPLC_MONITORstart_messageup_inup_outdn_indn_out"
+    "commandcontrolsourcepayloadtypedataseq";
+
+// Raw deflate (無 zlib header)，壓縮串流以 thread_local 重複使用
+class Deflate {
+public:
+    // 壓縮失敗或沒有變小時回傳 false
+    static bool compress(const char* data, size_t len, std::string& out, bool use_dictionary = true) {
+        z_stream& zs = stream();
+        if (deflateReset(&zs) != Z_OK) return false;
+        if (use_dictionary) {
+            deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY), sizeof(DEFLATE_DICTIONARY) - 1);
+        }
+
+        size_t base = out.size();
+        out.resize(base + deflateBound(&zs, (uLong)len));
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = (uInt)len;
+        zs.next_out = reinterpret_cast<Bytef*>(&out[base]);
+        zs.avail_out = (uInt)(out.size() - base);
+        int rc = deflate(&zs, Z_FINISH);
+        size_t produced = (out.size() - base) - zs.avail_out;
+        out.resize(base + produced);
+        return rc == Z_STREAM_END && produced < len;
+    }
+
+    // permessage-deflate (RFC 7692) 的訊息內容：無字典，sync flush 後去掉結尾的 00 00 FF FF；
+    // 沒有 context takeover，每則訊息可獨立解壓，同一份結果可送給每個 Client。壓縮失敗或沒有變小時回傳 false
+    static bool compress_message(const char* data, size_t len, std::string& out) {
+        static constexpr char TAIL[] = {0x00, 0x00, (char)0xFF, (char)0xFF};
+        z_stream& zs = stream();
+        if (deflateReset(&zs) != Z_OK) return false;
+
+        size_t base = out.size();
+        out.resize(base + deflateBound(&zs, (uLong)len) + 16); // + sync flush 的空區塊
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = (uInt)len;
+        zs.next_out = reinterpret_cast<Bytef*>(&out[base]);
+        zs.avail_out = (uInt)(out.size() - base);
+        int rc = deflate(&zs, Z_SYNC_FLUSH);
+        size_t produced = (out.size() - base) - zs.avail_out;
+        bool ok = rc == Z_OK && zs.avail_in == 0 && zs.avail_out > 0 && produced > sizeof(TAIL) &&
+                  std::equal(TAIL, TAIL + sizeof(TAIL), out.begin() + (base + produced - sizeof(TAIL)));
+        produced -= sizeof(TAIL);
+        out.resize(ok ? base + produced : base);
+        return ok && produced < len;
+    }
+
+    // 解壓縮 compress() 的輸出 (raw_len: 壓縮前長度，由呼叫端的封包格式帶入)；資料毀損時回傳 false
+    static bool decompress(const char* data, size_t len, size_t raw_len, std::string& out, bool use_dictionary = true) {
+        z_stream& zs = inflater();
+        if (inflateReset(&zs) != Z_OK) return false;
+        if (use_dictionary) {
+            inflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY), sizeof(DEFLATE_DICTIONARY) - 1);
+        }
+
+        size_t base = out.size();
+        out.resize(base + raw_len);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = (uInt)len;
+        zs.next_out = reinterpret_cast<Bytef*>(&out[base]);
+        zs.avail_out = (uInt)raw_len;
+        int rc = inflate(&zs, Z_FINISH);
+        bool ok = rc == Z_STREAM_END && zs.avail_out == 0;
+        if (!ok) out.resize(base);
+        return ok;
+    }
+
+private:
+    struct Stream {
+        z_stream zs{};
+        Stream() { deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY); }
+        ~Stream() { deflateEnd(&zs); }
+    };
+
+    struct InflateStream {
+        z_stream zs{};
+        InflateStream() { inflateInit2(&zs, -15); }
+        ~InflateStream() { inflateEnd(&zs); }
+    };
+
+    static z_stream& stream() {
+        thread_local Stream s;
+        return s.zs;
+    }
+
+    static z_stream& inflater() {
+        thread_local InflateStream s;
+        return s.zs;
+    }
+};
+
+enum class FrameType : uint8_t {
+    PLC_STATE = 1,
+    BARCODE = 2,
+    DATA = 3,
+    CONTROL = 4,
+    INFO = 5,
+    SOURCE_TABLE = 6,
+};
+
+// 一則推播：建構時只存結構化內容，文字 / 二進位編碼在第一次需要時才產生並快取
+// (同一則訊息送給多個 Client 只編碼一次；沒有二進位 Client 時完全不做二進位編碼)
+// 注意：編碼快取非執行緒安全，建構後只能由 WS 執行緒讀取
+class WsFrame {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr const char* PLC_FIELDS[] = {"up_in", "up_out", "dn_in", "dn_out", "start_message"};
+    static constexpr int PLC_FIELD_COUNT = 5;
+
+    WsFrame() = default;
+
+    // bits: PLC_FIELDS 依序對應 bit0..bit4
+    static WsFrame plc_state(SourceId source, uint8_t bits) {
+        WsFrame f(FrameType::PLC_STATE, source);
+        f.bits_ = bits;
+        return f;
+    }
+
+    // 一般資料：字串 payload (條碼) 走 BARCODE，其餘走 CBOR
+    static WsFrame data(SourceId source, json payload) {
+        WsFrame f(payload.is_string() ? FrameType::BARCODE : FrameType::DATA, source);
+        f.payload_ = std::move(payload);
+        return f;
+    }
+
+    static WsFrame control(std::string command, json payload = json::object()) {
+        WsFrame f(FrameType::CONTROL, Sources::NONE);
+        f.command_ = std::move(command);
+        f.payload_ = std::move(payload);
+        return f;
+    }
+
+    // 連線 / 重連時的狀態快照：seq 為快照當下的最新序號，items 為各主題最新一筆
+    static WsFrame snapshot(uint32_t seq, std::vector<std::shared_ptr<const WsFrame>> items) {
+        WsFrame f(FrameType::CONTROL, Sources::NONE);
+        f.command_ = "SNAPSHOT";
+        f.payload_ = {{"seq", seq}};
+        f.items_ = std::move(items);
+        return f;
+    }
+
+    // 任意 JSON 物件 (文字模式原樣送出)
+    static WsFrame info(json body) {
+        WsFrame f(FrameType::INFO, Sources::NONE);
+        f.payload_ = std::move(body);
+        return f;
+    }
+
+    static WsFrame source_table(const std::vector<std::string>& names) {
+        WsFrame f(FrameType::SOURCE_TABLE, Sources::NONE);
+        f.binary_.reserve(HEADER_SIZE + 2 + names.size() * 16);
+        f.write_header(f.binary_);
+        put_u16(f.binary_, (uint16_t)names.size());
+        for (size_t i = 0; i < names.size(); ++i) {
+            size_t len = std::min<size_t>(names[i].size(), 255);
+            put_u16(f.binary_, (uint16_t)(i + 1));
+            f.binary_.push_back((char)len);
+            f.binary_.append(names[i], 0, len);
+        }
+        f.has_binary_ = true;
+        return f;
+    }
+
+    FrameType type() const { return type_; }
+    SourceId source() const { return source_id_; }
+    uint32_t seq() const { return seq_; }
+    uint64_t ts_us() const { return ts_us_; }
+
+    // 序號由 WsServer 在發送前指定 (會使已快取的編碼失效)
+    void set_seq(uint32_t seq) {
+        seq_ = seq;
+        has_text_ = false;
+        has_text_wire_ = false;
+        has_wire_ = false;
+        if (type_ != FrameType::SOURCE_TABLE) has_binary_ = false;
+    }
+
+    const std::string& text() const {
+        if (!has_text_) {
+            text_ = to_json().dump();
+            has_text_ = true;
+        }
+        return text_;
+    }
+
+    const std::string& binary() const {
+        if (!has_binary_) {
+            binary_.clear();
+            encode_binary(binary_);
+            has_binary_ = true;
+        }
+        return binary_;
+    }
+
+    // 實際送給二進位 Client 的內容：夠大且壓得下去時為 FLAG_DEFLATE 版本
+    const std::string& binary_wire() const {
+        if (!has_wire_) {
+            const std::string& raw = binary();
+            wire_deflated_ = false;
+            if (raw.size() >= COMPRESS_MIN_BYTES) {
+                wire_.assign(raw, 0, HEADER_SIZE);
+                wire_[1] = (char)((uint8_t)wire_[1] | FLAG_DEFLATE);
+                wire_deflated_ = Deflate::compress(raw.data() + HEADER_SIZE, raw.size() - HEADER_SIZE, wire_);
+            }
+            if (!wire_deflated_) wire_.clear();
+            has_wire_ = true;
+        }
+        return wire_deflated_ ? wire_ : binary();
+    }
+
+    bool binary_wire_deflated() const { binary_wire(); return wire_deflated_; }
+
+    // 文字 Client 的 permessage-deflate 內容 (COMPRESS_MIN_BYTES 以上且壓得下去時)，空字串 = 直接送 text()
+    const std::string& text_wire() const {
+        if (!has_text_wire_) {
+            const std::string& raw = text();
+            text_wire_.clear();
+            if (raw.size() >= COMPRESS_MIN_BYTES && !Deflate::compress_message(raw.data(), raw.size(), text_wire_)) text_wire_.clear();
+            has_text_wire_ = true;
+        }
+        return text_wire_;
+    }
+
+    // 文字模式的訊息物件 (與舊版 Controller 產生的格式相同，推播另附 "seq")
+    json to_json() const {
+        json out;
+        switch (type_) {
+            case FrameType::PLC_STATE: {
+                json fields = json::object();
+                for (int i = 0; i < PLC_FIELD_COUNT; ++i) fields[PLC_FIELDS[i]] = (bits_ >> i) & 1;
+                out = {{"type", "data"}, {"source", Sources::name(source_id_)}, {"payload", fields}};
+                break;
+            }
+            case FrameType::BARCODE:
+            case FrameType::DATA:
+                out = {{"type", "data"}, {"source", Sources::name(source_id_)}, {"payload", payload_}};
+                break;
+            case FrameType::CONTROL: {
+                json payload = payload_;
+                if (command_ == "SNAPSHOT") {
+                    payload["items"] = json::array();
+                    for (const auto& item : items_) payload["items"].push_back(item->to_json());
+                }
+                out = {{"type", "control"}, {"command", command_}, {"payload", payload}};
+                break;
+            }
+            case FrameType::INFO:
+                return payload_;
+            default:
+                return json::object();
+        }
+        if (seq_ != 0) out["seq"] = seq_;
+        return out;
+    }
+
+private:
+    FrameType type_ = FrameType::INFO;
+    SourceId source_id_ = Sources::NONE;
+    uint32_t seq_ = 0;
+    uint64_t ts_us_ = 0;
+    uint8_t bits_ = 0;
+    std::string command_;
+    json payload_;
+    std::vector<std::shared_ptr<const WsFrame>> items_; // SNAPSHOT 內容
+
+    mutable std::string text_;
+    mutable std::string binary_;
+    mutable bool has_text_ = false;
+    mutable bool has_binary_ = false;
+    mutable std::string wire_;
+    mutable bool has_wire_ = false;
+    mutable bool wire_deflated_ = false;
+    mutable std::string text_wire_;
+    mutable bool has_text_wire_ = false;
+
+    WsFrame(FrameType type, SourceId source) : type_(type), source_id_(source) {
+        ts_us_ = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void write_header(std::string& out) const {
+        out.push_back((char)VERSION);
+        out.push_back((char)type_);
+        put_u16(out, source_id_);
+        put_u32(out, seq_);
+        put_u64(out, ts_us_);
+    }
+
+    void encode_binary(std::string& out) const {
+        out.reserve(HEADER_SIZE + 32);
+        write_header(out);
+        switch (type_) {
+            case FrameType::PLC_STATE:
+                out.push_back((char)PLC_FIELD_COUNT);
+                out.push_back((char)bits_);
+                break;
+            case FrameType::BARCODE: {
+                const auto& s = payload_.get_ref<const std::string&>();
+                size_t len = std::min<size_t>(s.size(), 0xFFFF);
+                put_u16(out, (uint16_t)len);
+                out.append(s, 0, len);
+                break;
+            }
+            case FrameType::CONTROL: {
+                size_t len = std::min<size_t>(command_.size(), 255);
+                out.push_back((char)len);
+                out.append(command_, 0, len);
+                if (command_ != "SNAPSHOT") {
+                    append_cbor(out, payload_);
+                } else {
+                    json payload = payload_;
+                    payload["items"] = json::array();
+                    for (const auto& item : items_) {
+                        const std::string& bytes = item->binary();
+                        payload["items"].push_back(json::binary(std::vector<uint8_t>(bytes.begin(), bytes.end())));
+                    }
+                    append_cbor(out, payload);
+                }
+                break;
+            }
+            case FrameType::DATA:
+            case FrameType::INFO:
+                append_cbor(out, payload_);
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void append_cbor(std::string& out, const json& j) {
+        auto bytes = json::to_cbor(j);
+        out.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    static void put_u16(std::string& out, uint16_t v) {
+        out.push_back((char)(v & 0xFF));
+        out.push_back((char)(v >> 8));
+    }
+    static void put_u32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back((char)((v >> (8 * i)) & 0xFF));
+    }
+    static void put_u64(std::string& out, uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back((char)((v >> (8 * i)) & 0xFF));
+    }
+};
\ No newline at end of file
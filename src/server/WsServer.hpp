@@ -1,94 +1,769 @@
 #pragma once
 #include "App.h"
 #include "core/MessageBus.hpp"
-#include "core/Logger.hpp" 
+#include "core/Logger.hpp"
+#include "core/Latency.hpp"
+#include "core/Metrics.hpp"
+#include "core/MpscQueue.hpp"
+#include "core/Config.hpp"
+#include "core/Lifecycle.hpp"
+#include "core/LoadShed.hpp"
+#include "server/Topics.hpp"
+#include "server/WsProtocol.hpp"
+#include "server/StateStore.hpp"
+#include "server/WsCommand.hpp"
+#include "server/RequestTracker.hpp"
+#include "server/UpstreamRelay.hpp"
+#include "logic/Sinks.hpp"
+#include <algorithm>
 #include <thread>
 #include <atomic>
 #include <chrono>
 #include <string>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class WsServer : public WsSink {
+    using SharedFrame = std::shared_ptr<const WsFrame>;
+
+    // ✅ 慢速 Client 保護：超過 SOFT_LIMIT 後不再直接送出，改由 drain 事件補送
+    //   State 類：每個 key 只保留最新一筆 (conflate)
+    //   Event 類：最多排 MAX_PENDING_EVENTS 筆，超過即斷線 (前端重連後重新同步)
+    static constexpr unsigned int SOFT_LIMIT = 256 * 1024;
+    static constexpr unsigned int HARD_LIMIT = 4 * 1024 * 1024; // uWS 內部上限，超過直接關閉
+    static constexpr size_t MAX_PENDING_EVENTS = 256;
+    static constexpr const char* BINARY_SUBPROTOCOL = "lpsm.bin";
+
+    struct PendingState {
+        std::string key;
+        SharedFrame data;
+    };
 
-class WsServer {
     std::shared_ptr<MessageBus> bus_;
-    struct PerSocketData {}; 
+    struct PerSocketData {
+        std::vector<std::string> patterns{"*"}; // 訂閱規則 (預設全部，相容舊版前端)
+        bool binary = false; // 連線時協商的推播格式 (見 WsProtocol.hpp)
+        bool deflate = false; // Client 提出 permessage-deflate (文字大 Frame 送 WsFrame::text_wire)
+        int64_t resume_from = -1; // 連線 URL 的 "?since=<seq>"，-1 表示送完整快照
+        uint32_t client_id = 0;   // 連線序號 (CMD_ACK 依此回覆發出指令的 Client)
+        std::string request_scope; // request_id 去重範圍："?client=<id>" 或連線序號 (見 RequestTracker::key_of)
+        std::deque<SharedFrame> pending_events;
+        std::vector<PendingState> pending_states; // 依 key 保留最新值 (數量 <= 主題數)
+        bool closing = false;
+    };
+    using WS = uWS::WebSocket<false, true, PerSocketData>;
     std::atomic<bool> running_{true};
-    
+    std::atomic<bool> intake_{true}; // 關閉流程開始後不再接受前端指令
+    std::atomic<int> clients_{0};
+    std::mutex hb_mutex_;
+    std::condition_variable hb_cond_; // 關閉時立即喚醒心跳執行緒
+
     // ✅ 儲存 uWS 的 Loop 指標，用來做跨執行緒排程
-    uWS::Loop *loop_ = nullptr;
-    uWS::App* app_ptr = nullptr;
+    std::atomic<uWS::Loop*> loop_{nullptr};
+    uWS::App* app_ptr = nullptr; // 僅 WS 執行緒存取
+    us_listen_socket_t* listen_socket_ = nullptr; // 僅 WS 執行緒存取
+
+    // 跨執行緒發送佇列：訊息以 shared_ptr 共用同一份編碼結果 (不逐 Client 複製)
+    struct OutFrame {
+        std::string topic;
+        Delivery delivery = Delivery::EVENT;
+        std::shared_ptr<WsFrame> data; // nullptr = drop_retained (topic 為 prefix)
+        TraceStamps trace;
+        std::string keep;              // drop_retained 保留的主題
+    };
+    MpscQueue<OutFrame> outbox_;
+    std::atomic<bool> drain_scheduled_{false}; // 已排程 defer 尚未執行時，不重複喚醒 Loop
+
+    // 以下僅 WS 執行緒存取
+    std::unordered_set<WS*> sockets_;
+    std::vector<WS*> closing_sockets_; // deliver 標記、待 end_closing 關閉的慢速 Client
+    std::set<std::string> known_topics_;
+    std::set<std::string> config_topics_; // 其中來自設定的部分 (設定變更時移除舊的)
+    std::unordered_map<std::string, std::unordered_set<WS*>> subscribers_; // topic -> clients
+    uint32_t next_seq_ = 1;
+    StateStore state_; // 最新狀態與近期推播，供連線快照 / 重連補送
+    std::string ack_buf_; // HEARTBEAT_ACK 格式化緩衝 (重複使用)
+    size_t sent_sources_version_ = 0; // 已下發給二進位 Client 的來源表版本
+    uint32_t next_client_id_ = 1;
+    std::unordered_map<uint32_t, WS*> sockets_by_id_;
+    RequestTracker requests_; // request_id 去重與 CMD_ACK 回覆
+    std::shared_ptr<UpstreamRelay> relay_; // 上傳到彙總端 (可省略，run 之前設定)
+
+    // Listen 結果 (0 = 尚未完成, 1 = 成功, -1 = 失敗)，供啟動流程等待
+    int listen_state_ = 0;
+    std::mutex listen_mutex_;
+    std::condition_variable listen_cond_;
 
 public:
-    WsServer(std::shared_ptr<MessageBus> bus) : bus_(bus) {}
+    WsServer(std::shared_ptr<MessageBus> bus) : bus_(bus) {
+        Metrics::gauge("lpsm_ws_clients", "Connected WebSocket clients", [this]{ return (double)clients_.load(); });
+    }
+
+    // 等待 Socket 進入 LISTEN (Readiness Probe)
+    bool wait_listening(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(listen_mutex_);
+        listen_cond_.wait_for(lock, timeout, [this]{ return listen_state_ != 0; });
+        return listen_state_ == 1;
+    }
 
-    // ✅ 修改後的廣播介面：使用 defer 將任務丟回 WS 執行緒
-    void broadcast(const std::string& message) {
+    // ✅ 發佈介面 (任意執行緒)：推入無鎖佇列，只有佇列由空轉為非空時才 defer 喚醒 WS 執行緒
+    // topic: 只送給訂閱該主題的 Client (見 Topics.hpp)
+    // delivery: 慢速 Client 的處理方式 (STATE 可合併、EVENT 需逐筆送達)
+    // trace: 來源訊息的時間戳，用於量測 defer 等待與端到端延遲
+    void publish(std::string topic, WsFrame frame, const TraceStamps& trace = {}, Delivery delivery = Delivery::EVENT) override {
         // 必須檢查 loop_ 是否存在 (Server 啟動後才有)
-        if (loop_ && app_ptr) {
-            // copy message (因為是非同步執行，必須複製一份字串)
-            // defer 會讓這個 lambda 在 WS 執行緒的安全時間點執行
-            loop_->defer([this, msg = message]() {
-                if (app_ptr) {
-                    app_ptr->publish("broadcast", msg, uWS::OpCode::TEXT, false);
-                    // spdlog::info("[WS] SEND Broadcast!!!");
-                    spdlog::info("[WS] SEND Broadcast: {}", msg);
-                }
-            });
+        uWS::Loop* loop = loop_.load(std::memory_order_acquire);
+        if (!loop) return;
+
+        outbox_.push({std::move(topic), delivery, std::make_shared<WsFrame>(std::move(frame)), trace, {}});
+        if (!drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+            loop->defer([this]() { drain_outbox(); });
+        }
+    }
+
+    // 指令完成 (任意執行緒)：回覆 CMD_ACK 給發出該 request_id 的 Client
+    // result 至少含 "status"，其餘欄位 (e.g. end_code, plc_rtt_us) 原樣附上
+    void complete_request(std::string request_id, json result) override {
+        uWS::Loop* loop = loop_.load(std::memory_order_acquire);
+        if (!loop || request_id.empty()) return;
+        loop->defer([this, id = std::move(request_id), result = std::move(result)]() mutable {
+            finish_request(id, std::move(result));
+        });
+    }
+
+    // 經由 outbox 排在之前的 publish 之後，之後的 publish 不受影響
+    void drop_retained(std::string prefix, std::string keep = {}) override {
+        uWS::Loop* loop = loop_.load(std::memory_order_acquire);
+        if (!loop) return;
+
+        OutFrame marker;
+        marker.topic = std::move(prefix);
+        marker.keep = std::move(keep);
+        outbox_.push(std::move(marker));
+        if (!drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+            loop->defer([this]() { drain_outbox(); });
         }
     }
 
+    // 上傳中繼 (run 之前呼叫)：每則推播同時交給 relay，連線 / 重連時由 WS 執行緒決定補送或快照
+    void set_relay(std::shared_ptr<UpstreamRelay> relay) {
+        relay_ = std::move(relay);
+        relay_->set_sync_handler([this](uint64_t generation, int64_t since) {
+            if (uWS::Loop* loop = loop_.load(std::memory_order_acquire)) {
+                loop->defer([this, generation, since]() { sync_relay(generation, since); });
+            }
+        });
+    }
+
     void run(int port) {
         // ✅ 1. 獲取當前執行緒的 Event Loop
         // 注意：這行必須在 run 的這個執行緒內呼叫
-        loop_ = uWS::Loop::get();
+        loop_.store(uWS::Loop::get(), std::memory_order_release);
 
         uWS::App app;
         app_ptr = &app;
 
+        // 預先登錄設定檔中已知的主題，讓新連線的 Client 可以看到完整清單
+        // 設定熱更新 (e.g. 冷啟動時 DB 較晚載入、相機增減) 切回 WS 執行緒重建；先訂閱再讀目前設定，不漏掉中間的發布
+        Config::subscribe([this](const Config::Snapshot& cfg) {
+            if (uWS::Loop* loop = loop_.load(std::memory_order_acquire)) {
+                loop->defer([this, cfg]() { if (app_ptr) apply_config_topics(*cfg); });
+            }
+        });
+        apply_config_topics(*Config::get());
+
         std::thread hb_thread([this](){
+            ThreadTopology::apply(ThreadRole::HEARTBEAT);
+            auto last_heartbeat = std::chrono::steady_clock::now();
             while(running_) {
-                std::this_thread::sleep_for(std::chrono::seconds(2));
+                {
+                    std::unique_lock<std::mutex> lock(hb_mutex_);
+                    if (hb_cond_.wait_for(lock, std::chrono::seconds(2), [this]{ return !running_; })) break;
+                }
                 // 這裡只負責推 Event 到 Bus，不直接廣播，所以是安全的
-                bus_->push({"SYS", "HEARTBEAT", json{{"ts", std::time(nullptr)}}});
+                // 降載中拉長心跳間隔 (LoadShed::heartbeat_interval)，指令逾時檢查維持 2 秒
+                auto now = std::chrono::steady_clock::now();
+                if (now - last_heartbeat >= LoadShed::heartbeat_interval() - std::chrono::milliseconds(100)) {
+                    bus_->push({Sources::SYS, MsgType::HEARTBEAT, json{{"ts", std::time(nullptr)}}});
+                    last_heartbeat = now;
+                }
+                // 逾時未完成的指令由 WS 執行緒回覆 TIMEOUT
+                if (uWS::Loop* loop = loop_.load(std::memory_order_acquire)) {
+                    loop->defer([this]() { expire_requests(); });
+                }
             }
         });
 
         app.ws<PerSocketData>("/*", {
-            .open = [](auto *ws) {
-                ws->subscribe("broadcast"); 
-                spdlog::info("[WS] Client connected");
-                json welcome = {{"type", "info"}, {"message", "Connected to LPSM Backend"}};
-                ws->send(welcome.dump(), uWS::OpCode::TEXT, false);
+            .compression = uWS::SHARED_COMPRESSOR, // permessage-deflate 協商 (內容由 WsFrame::text_wire 預先壓縮，見 send_frame)
+            .maxBackpressure = HARD_LIMIT,
+            .closeOnBackpressureLimit = true,
+            .upgrade = [](auto *res, auto *req, auto *context) {
+                // 推播格式協商："?proto=bin" 或 Sec-WebSocket-Protocol 含 lpsm.bin
+                std::string_view protocols = req->getHeader("sec-websocket-protocol");
+                bool by_header = protocols.find(BINARY_SUBPROTOCOL) != std::string_view::npos;
+                PerSocketData data;
+                data.binary = by_header || req->getQuery("proto") == "bin";
+                data.deflate = req->getHeader("sec-websocket-extensions").find("permessage-deflate") != std::string_view::npos;
+                std::string_view client = req->getQuery("client");
+                if (!client.empty()) data.request_scope = "client:" + std::string(client);
+                std::string_view since = req->getQuery("since");
+                if (!since.empty()) {
+                    try { data.resume_from = std::stoll(std::string(since)); } catch (...) {}
+                }
+                res->template upgrade<PerSocketData>(std::move(data),
+                    req->getHeader("sec-websocket-key"),
+                    by_header ? std::string_view(BINARY_SUBPROTOCOL) : protocols,
+                    req->getHeader("sec-websocket-extensions"),
+                    context);
+            },
+            .open = [this](auto *ws) {
+                sockets_.insert(ws);
+                ws->getUserData()->client_id = next_client_id_++;
+                if (ws->getUserData()->request_scope.empty()) {
+                    ws->getUserData()->request_scope = "conn:" + std::to_string(ws->getUserData()->client_id);
+                }
+                sockets_by_id_[ws->getUserData()->client_id] = ws;
+                apply_patterns(ws);
+                clients_++;
+                bool binary = ws->getUserData()->binary;
+                spdlog::info("[WS] Client connected ({})", binary ? "binary" : "json");
+                if (binary) send_now(ws, std::make_shared<const WsFrame>(WsFrame::source_table(Sources::names())));
+                reply(ws, WsFrame::info({{"type", "info"}, {"message", "Connected to LPSM Backend"}, {"topics", known_topics_}, {"seq", state_.last_seq()}}));
+                sync_client(ws, ws->getUserData()->resume_from);
             },
             .message = [this](auto *ws, std::string_view message, uWS::OpCode opCode) {
-                std::string msg_str(message);
-                // spdlog::info("[WS] RECV: {}", msg_str); // 怕太吵可以註解掉
+                uint64_t rx_ns = trace_now_ns();
+                // spdlog::info("[WS] RECV: {}", message); // 怕太吵可以註解掉
+                WsCommand cmd;
+                if (!WsCommandScanner::scan(message, cmd)) return;
                 try {
-                    auto j = json::parse(message);
-                    if (j.contains("command") && j["command"] == "HEARTBEAT") {
-                        // 回傳 ACK
-                        json ack = {{"type", "control"}, {"command", "HEARTBEAT_ACK"}, {"payload", {{"server_ts", std::time(nullptr) * 1000}, {"client_ts", j["payload"].value("ts", 0)}}}};
-                        ws->send(ack.dump(), uWS::OpCode::TEXT, false);
-                        return; 
+                    switch (cmd.type) {
+                        case Command::HEARTBEAT: {
+                            // 回傳 ACK (文字模式直接套用預先格式化的字串，不建 JSON)
+                            int64_t client_ts = 0;
+                            WsCommandScanner::find_int(cmd.payload, "ts", client_ts);
+                            int64_t server_ts = (int64_t)std::time(nullptr) * 1000;
+                            if (ws->getUserData()->binary) {
+                                reply(ws, WsFrame::control("HEARTBEAT_ACK", {{"server_ts", server_ts}, {"client_ts", client_ts}}));
+                            } else {
+                                ws->send(WsCommandScanner::format_heartbeat_ack(ack_buf_, server_ts, client_ts), uWS::OpCode::TEXT, false);
+                            }
+                            return;
+                        }
+                        // 主題訂閱：只影響這個 Client，不進 Bus
+                        case Command::SUBSCRIBE:
+                        case Command::UNSUBSCRIBE: {
+                            json payload = cmd.payload.empty() ? json::object() : json::parse(cmd.payload);
+                            json topics = payload.is_object() ? payload.value("topics", json::array()) : json::array();
+                            update_subscriptions(ws, cmd.type == Command::SUBSCRIBE, topics);
+                            return;
+                        }
+                        // 重連補送：{"command": "RESUME", "payload": {"seq": <最後收到的 seq>}}
+                        case Command::RESUME: {
+                            int64_t since = -1;
+                            WsCommandScanner::find_int(cmd.payload, "seq", since);
+                            sync_client(ws, since);
+                            return;
+                        }
+                        // 延遲統計查詢：只回給發問的 Client
+                        case Command::LATENCY_STATS: {
+                            json stats = Latency::to_json();
+                            stats["bus_lanes"] = bus_->lane_stats();
+                            reply(ws, WsFrame::control("LATENCY_STATS", std::move(stats)));
+                            return;
+                        }
+                        // 調整模組 Log 等級：{"command": "SET_LOG_LEVEL", "payload": {"module": "PLC", "level": "debug"}}
+                        // 不帶 payload 時只回覆目前各模組等級
+                        case Command::SET_LOG_LEVEL: {
+                            // 模組或等級不認得時不變更任何等級，回覆中帶 error
+                            json payload = cmd.payload.empty() ? json::object() : json::parse(cmd.payload, nullptr, false);
+                            std::string error;
+                            if (payload.is_discarded() || !payload.is_object()) {
+                                error = "payload must be an object";
+                            } else if (payload.contains("module") || payload.contains("level")) {
+                                json m = payload.contains("module") ? payload["module"] : json("");
+                                json l = payload.contains("level") ? payload["level"] : json("info");
+                                std::string module_name = m.is_string() ? m.get<std::string>() : m.dump();
+                                std::string level_name = l.is_string() ? l.get<std::string>() : l.dump();
+                                LogModule module;
+                                spdlog::level::level_enum level;
+                                if (!BinLog::module_from_name(module_name, module)) {
+                                    error = "unknown module: " + module_name;
+                                } else if (!BinLog::level_from_name(level_name, level)) {
+                                    error = "unknown level: " + level_name;
+                                } else {
+                                    BinLog::set_level(module, level);
+                                    spdlog::info("[WS] Log level of {} set to {}", BinLog::module_name(module),
+                                                 spdlog::level::to_string_view(level));
+                                }
+                            }
+                            json levels = json::object();
+                            for (const auto& [name, level] : BinLog::levels()) levels[name] = level;
+                            json result = {{"levels", levels}, {"dropped", BinLog::dropped()}};
+                            if (!error.empty()) {
+                                spdlog::warn("[WS] SET_LOG_LEVEL rejected: {}", error);
+                                result["error"] = error;
+                            }
+                            reply(ws, WsFrame::control("LOG_LEVELS", std::move(result)));
+                            return;
+                        }
+                        default:
+                            break;
+                    }
+
+                    // 關閉流程中：Bus 正在清空，不再接受會動到 PLC / MES 的指令
+                    std::string request_id(cmd.request_id);
+                    if (!intake_.load(std::memory_order_relaxed)) {
+                        spdlog::warn("[WS] {} rejected: shutting down", cmd.name);
+                        if (!request_id.empty()) {
+                            reply(ws, WsFrame::control("CMD_ACK", {{"request_id", request_id}, {"command", std::string(cmd.name)}, {"status", "REJECTED"}}));
+                        }
+                        return;
                     }
-                    bus_->push({ "WS", "CMD", j });
+
+                    // 歷史查詢的結果只放在 CMD_ACK 回給發出的 Client，沒有 request_id 無從回覆
+                    if (cmd.type == Command::SIGNAL_HISTORY && request_id.empty()) {
+                        spdlog::warn("[WS] SIGNAL_HISTORY rejected: request_id required");
+                        reply(ws, WsFrame::control("CMD_ACK", {{"command", std::string(cmd.name)}, {"status", "BAD_REQUEST"},
+                                                               {"error", "request_id required"}}));
+                        return;
+                    }
+
+                    // 其餘指令交給 Controller：只解析 payload 片段，指令類型以列舉傳遞
+                    // 先解析再登記 request_id：格式錯誤直接回覆，不留下等到逾時的 PENDING 紀錄
+                    json body;
+                    try {
+                        if (cmd.escaped_name || cmd.type == Command::NONE) {
+                            body = json::parse(message); // 少見格式：原樣轉發
+                        } else {
+                            body = {{"command", std::string(cmd.name)}};
+                            if (!cmd.payload.empty()) body["payload"] = json::parse(cmd.payload);
+                        }
+                    } catch (const json::exception& e) {
+                        spdlog::warn("[WS] {} rejected: malformed payload ({})", cmd.name, e.what());
+                        if (!request_id.empty()) {
+                            reply(ws, WsFrame::control("CMD_ACK", {{"request_id", request_id}, {"command", std::string(cmd.name)}, {"status", "BAD_REQUEST"}}));
+                        }
+                        return;
+                    }
+
+                    // 帶 request_id 的指令：同一個 Client 在 WINDOW 內重複的不再執行，直接回覆原結果 / PENDING
+                    uint32_t client_id = ws->getUserData()->client_id;
+                    std::string request_key;
+                    if (!request_id.empty()) {
+                        request_key = RequestTracker::key_of(ws->getUserData()->request_scope, request_id);
+                        if (const auto* prev = requests_.begin(request_key, request_id, client_id, std::string(cmd.name), rx_ns)) {
+                            if (prev->command != cmd.name) {
+                                // 同一個 request_id 換了指令：不執行，也不回覆前一個指令的結果
+                                spdlog::warn("[WS] request_id {} reused for {} (was {}). Rejected.", request_id, cmd.name, prev->command);
+                                reply(ws, WsFrame::control("CMD_ACK", {{"request_id", request_id}, {"command", std::string(cmd.name)},
+                                                                       {"status", "CONFLICT"}, {"previous_command", prev->command}}));
+                                return;
+                            }
+                            spdlog::warn("[WS] Duplicate request_id {} ({}) ignored", request_id, prev->command);
+                            json ack = prev->done ? prev->result : json{{"request_id", request_id}, {"command", prev->command}, {"status", "PENDING"}};
+                            ack["duplicate"] = true;
+                            reply(ws, WsFrame::control("CMD_ACK", ack));
+                            return;
+                        }
+                    }
+
+                    Metrics::inc(Counter::WS_COMMANDS_RECEIVED);
+                    Message msg{ Sources::WS, MsgType::CMD, std::move(body) };
+                    msg.command = cmd.type;
+                    msg.client_id = client_id;
+                    msg.request_id = std::move(request_key);
+                    msg.trace.rx = rx_ns;
+                    bus_->push(std::move(msg));
                 } catch(...) {}
             },
+            .drain = [this](auto *ws) {
+                // Socket 緩衝區消化後，補送排隊中的訊息
+                flush_pending(ws);
+            },
             .close = [this](auto *ws, int code, std::string_view message) {
                 spdlog::info("[WS] Client disconnected");
-                
+                sockets_by_id_.erase(ws->getUserData()->client_id);
+                remove_socket(ws);
+                clients_--;
+
                 // ✅ [新增] 當前端斷線時，通知 Controller
                 // 這會觸發 Controller 去呼叫 PLC 的 reset_safe_signals
-                bus_->push({ "WS", "DISCONNECTED", json({}) });
+                bus_->push({ Sources::WS, MsgType::DISCONNECTED, json({}) });
             }
-        }).listen("0.0.0.0", port, [port](auto *listen_socket) {
+        }).get("/metrics", [](auto *res, auto *req) {
+            // Prometheus text format
+            res->writeHeader("Content-Type", "text/plain; version=0.0.4")->end(Metrics::prometheus());
+        }).get("/metrics.json", [](auto *res, auto *req) {
+            res->writeHeader("Content-Type", "application/json")->end(Metrics::to_json().dump());
+        }).listen("0.0.0.0", port, [this, port](auto *listen_socket) {
+            listen_socket_ = listen_socket;
             if (listen_socket) spdlog::info("[WS] Server listening on port {}", port);
             else spdlog::error("[WS] FAILED to listen on port {}!", port);
+            set_listen_state(listen_socket ? 1 : -1);
         }).run();
 
         // 結束時清理
-        running_ = false;
+        stop_heartbeat();
+        loop_.store(nullptr, std::memory_order_release); // ✅ 清空 Loop 指標
         app_ptr = nullptr;
-        loop_ = nullptr; // ✅ 清空 Loop 指標
-        
+
         if(hb_thread.joinable()) hb_thread.join();
     }
+
+    // 關閉流程第一步 (任意執行緒)：不再接受新連線與前端指令、停止心跳；
+    // 已連線的 Client 仍收得到推播 (Bus 清空期間的結果)
+    void stop_intake() {
+        intake_.store(false, std::memory_order_relaxed);
+        stop_heartbeat();
+        if (uWS::Loop* loop = loop_.load(std::memory_order_acquire)) {
+            loop->defer([this]() {
+                if (!listen_socket_) return;
+                us_listen_socket_close(0, listen_socket_);
+                listen_socket_ = nullptr;
+            });
+        }
+    }
+
+    // 關閉流程最後一步 (任意執行緒)：送出剩餘推播後關閉所有連線，Event Loop 隨之結束，run() 返回
+    void stop() {
+        stop_intake();
+        if (uWS::Loop* loop = loop_.load(std::memory_order_acquire)) {
+            loop->defer([this]() {
+                drain_outbox();
+                std::vector<WS*> open(sockets_.begin(), sockets_.end()); // close 回呼會修改 sockets_
+                for (WS* ws : open) ws->end(1001, "Server shutting down");
+            });
+        }
+    }
+
+private:
+    void stop_heartbeat() {
+        {
+            std::lock_guard<std::mutex> lock(hb_mutex_);
+            running_ = false;
+        }
+        hb_cond_.notify_all();
+    }
+
+    // WS 執行緒：一次喚醒把佇列內所有訊息取出，依 Client 分組後在 cork 內一次送出
+    void drain_outbox() {
+        // 先清旗標再取資料：清除後才 push 的訊息會再排程一次 defer，不會遺漏
+        drain_scheduled_.exchange(false, std::memory_order_acq_rel);
+        if (!app_ptr) return;
+
+        std::vector<OutFrame> batch;
+        OutFrame frame;
+        while (outbox_.pop(frame)) {
+            if (!frame.data) {
+                size_t dropped = state_.drop_retained(frame.topic, frame.keep);
+                if (dropped) spdlog::info("[WS] Dropped {} retained topics under {}", dropped, frame.topic);
+                continue;
+            }
+            if (!known_topics_.count(frame.topic)) register_topic(frame.topic);
+            frame.data->set_seq(next_seq_++);
+            // 狀態類與各相機最後條碼保留在快照中，其餘只進補送 ring
+            bool retain = frame.delivery == Delivery::STATE ||
+                          (frame.data->type() == FrameType::BARCODE && Topics::is_camera(frame.topic));
+            state_.record(frame.topic, frame.delivery, retain, frame.data);
+            if (relay_) relay_->offer(frame.topic, frame.delivery, *frame.data);
+            batch.push_back(std::move(frame));
+        }
+        if (batch.empty()) return;
+
+        // 出現新來源時，先把更新後的名稱表送給二進位 Client
+        size_t sources_version = Sources::version();
+        if (sources_version != sent_sources_version_) {
+            sent_sources_version_ = sources_version;
+            auto table = std::make_shared<const WsFrame>(WsFrame::source_table(Sources::names()));
+            for (WS* ws : sockets_) {
+                if (ws->getUserData()->binary) deliver(ws, "", Delivery::EVENT, table);
+            }
+        }
+
+        // 依 Client 分組 (只有訂閱者才會出現在這裡)
+        std::unordered_map<WS*, std::vector<const OutFrame*>> per_client;
+        for (const auto& f : batch) {
+            auto it = subscribers_.find(f.topic);
+            if (it == subscribers_.end()) continue;
+            for (WS* ws : it->second) per_client[ws].push_back(&f);
+        }
+
+        uint64_t begin = trace_now_ns();
+        for (auto& [ws, frames] : per_client) {
+            ws->cork([&]() {
+                for (const OutFrame* f : frames) {
+                    if (ws->getUserData()->closing) break;
+                    deliver(ws, f->topic, f->delivery, f->data);
+                }
+            });
+        }
+        uint64_t end = trace_now_ns();
+        end_closing();
+
+        for (const auto& f : batch) {
+            Latency::stage(Stage::WS_DEFER).record_ns(f.trace.done, begin);
+            Latency::stage(Stage::END_TO_END).record_ns(f.trace.rx, end);
+            LPSM_LOG(LogModule::WS, spdlog::level::debug, "[WS] SEND {}: {}", f.topic, f.data->text()); // 參數只在啟用時才求值
+        }
+        Latency::stage(Stage::WS_SEND).record_ns(begin, end);
+    }
+
+    // 送給單一 Client；已落後的 Client 依 delivery 類型排隊或合併
+    void deliver(WS* ws, const std::string& key, Delivery delivery, const SharedFrame& data) {
+        auto* d = ws->getUserData();
+        if (d->closing) return;
+
+        bool backlogged = !d->pending_events.empty() || !d->pending_states.empty();
+        if (!backlogged && ws->getBufferedAmount() < SOFT_LIMIT) {
+            send_now(ws, data);
+            return;
+        }
+
+        if (delivery == Delivery::STATE) {
+            for (auto& s : d->pending_states) {
+                if (s.key == key) {
+                    s.data = data; // 只保留最新狀態
+                    Metrics::inc(Counter::WS_CONFLATED);
+                    return;
+                }
+            }
+            d->pending_states.push_back({key, data});
+            return;
+        }
+
+        if (d->pending_events.size() >= MAX_PENDING_EVENTS) {
+            Metrics::inc(Counter::WS_BACKPRESSURE_DROPS);
+            Metrics::inc(Counter::WS_SLOW_CLIENT_CLOSED);
+            spdlog::warn("[WS] Slow client exceeded {} pending events. Disconnecting.", MAX_PENDING_EVENTS);
+            // end() 會同步呼叫 close handler 並釋放 PerSocketData：先標記，等呼叫端的迴圈結束後才關閉
+            d->closing = true;
+            d->pending_events.clear();
+            d->pending_states.clear();
+            closing_sockets_.push_back(ws);
+            return;
+        }
+        d->pending_events.push_back(data);
+    }
+
+    void flush_pending(WS* ws) {
+        auto* d = ws->getUserData();
+        if (d->closing) return;
+
+        ws->cork([&]() {
+            while (!d->pending_events.empty() && ws->getBufferedAmount() < SOFT_LIMIT) {
+                send_now(ws, d->pending_events.front());
+                d->pending_events.pop_front();
+            }
+            // Event 補完後才送合併後的最新狀態
+            while (d->pending_events.empty() && !d->pending_states.empty() && ws->getBufferedAmount() < SOFT_LIMIT) {
+                send_now(ws, d->pending_states.front().data);
+                d->pending_states.erase(d->pending_states.begin());
+            }
+        });
+    }
+
+    // WS 執行緒：補上延遲資訊後回覆 CMD_ACK (Client 已斷線則只記錄結果供重送)
+    // key 為 RequestTracker::key_of (Message::request_id)，回覆時還原成 Client 指定的 request_id
+    void finish_request(const std::string& key, json result) {
+        const auto* entry = requests_.find(key);
+        if (!entry || entry->done) return; // 已逾時回覆過
+
+        result["request_id"] = entry->request_id;
+        result["command"] = entry->command;
+        result["latency_us"] = (trace_now_ns() - entry->rx_ns) / 1000;
+        auto* done = requests_.complete(key, result);
+
+        auto it = sockets_by_id_.find(done->client_id);
+        if (it != sockets_by_id_.end()) {
+            deliver(it->second, "", Delivery::EVENT, std::make_shared<const WsFrame>(WsFrame::control("CMD_ACK", result)));
+            end_closing();
+        }
+    }
+
+    void expire_requests() {
+        for (const auto& key : requests_.expire(trace_now_ns())) {
+            if (const auto* entry = requests_.find(key)) spdlog::warn("[WS] Request {} ({}) timed out", entry->request_id, entry->command);
+            finish_request(key, {{"status", "TIMEOUT"}});
+        }
+    }
+
+    // 連線 / RESUME：since 仍在 ring 範圍內則只補送遺漏的推播 (結尾送 RESUMED)，否則送完整快照
+    // 兩者都只包含 Client 有訂閱的主題，並經由 deliver 排在既有待送訊息之後
+    void sync_client(WS* ws, int64_t since) {
+        std::vector<StateStore::Entry> entries;
+        if (since >= 0 && state_.deltas_since((uint32_t)since, entries)) {
+            for (const auto& e : entries) {
+                if (is_subscribed(ws, e.topic)) deliver(ws, e.topic, Delivery::EVENT, e.frame);
+            }
+            json info = {{"from", since}, {"to", state_.last_seq()}, {"count", entries.size()}};
+            deliver(ws, "", Delivery::EVENT, std::make_shared<const WsFrame>(WsFrame::control("RESUMED", info)));
+            end_closing();
+            return;
+        }
+
+        std::vector<std::shared_ptr<const WsFrame>> items;
+        for (const auto& e : state_.snapshot()) {
+            if (is_subscribed(ws, e.topic)) items.push_back(e.frame);
+        }
+        deliver(ws, "", Delivery::EVENT, std::make_shared<const WsFrame>(WsFrame::snapshot(state_.last_seq(), std::move(items))));
+        end_closing();
+    }
+
+    // deliver 標記為 closing 的慢速 Client 在這裡才 end()，呼叫端不能再使用這些 ws
+    void end_closing() {
+        if (closing_sockets_.empty()) return;
+        std::vector<WS*> sockets;
+        sockets.swap(closing_sockets_);
+        for (WS* ws : sockets) {
+            if (sockets_.count(ws)) ws->end(1013, "Backpressure limit");
+        }
+    }
+
+    // 與 sync_client 相同的判斷：彙總端的序號仍在 ring 範圍內則只補送，否則送完整快照
+    void sync_relay(uint64_t generation, int64_t since) {
+        std::vector<StateStore::Entry> entries;
+        bool resume = since >= 0 && state_.deltas_since((uint32_t)since, entries);
+        if (!resume) entries = state_.snapshot();
+        relay_->begin_stream(generation, !resume, state_.last_seq(), entries);
+    }
+
+    bool is_subscribed(WS* ws, const std::string& topic) {
+        auto it = subscribers_.find(topic);
+        return it != subscribers_.end() && it->second.count(ws);
+    }
+
+    // 依 Client 協商的格式送出 (編碼 / 壓縮結果快取在 frame 上，多個 Client 共用)
+    void send_now(WS* ws, const SharedFrame& frame) {
+        size_t bytes = send_frame(ws, *frame);
+        Metrics::inc(Counter::WS_MESSAGES_SENT);
+        Metrics::inc(Counter::WS_BYTES_SENT, bytes);
+    }
+
+    // 只回給單一 Client 的控制訊息 (不經過排隊)
+    void reply(WS* ws, const WsFrame& frame) { send_frame(ws, frame); }
+
+    // 二進位：已在 frame 上壓縮過 (FLAG_DEFLATE)，不再走 permessage-deflate
+    // 文字：COMPRESS_MIN_BYTES 以上送 frame 上已壓好的 permessage-deflate 內容 (每則只壓縮一次)，
+    //       小 Frame (PLC 狀態、ACK) 與未協商壓縮的 Client 直接送
+    size_t send_frame(WS* ws, const WsFrame& frame) {
+        if (ws->getUserData()->binary) {
+            const std::string& bytes = frame.binary_wire();
+            if (frame.binary_wire_deflated()) Metrics::inc(Counter::WS_COMPRESSED_FRAMES);
+            ws->send(bytes, uWS::OpCode::BINARY, false);
+            return bytes.size();
+        }
+        const std::string& text = frame.text();
+        if (ws->getUserData()->deflate && text.size() >= COMPRESS_MIN_BYTES) {
+            const std::string& wire = frame.text_wire();
+            if (!wire.empty()) {
+                Metrics::inc(Counter::WS_COMPRESSED_FRAMES);
+                ws->send(wire, uWS::OpCode::TEXT, uWS::CompressFlags::ALREADY_COMPRESSED);
+                return wire.size();
+            }
+        }
+        ws->send(text, uWS::OpCode::TEXT, false);
+        return text.size();
+    }
+
+    // 新主題第一次出現 (e.g. 未登錄的相機)：符合規則的 Client 自動訂閱
+    void register_topic(const std::string& topic) {
+        known_topics_.insert(topic);
+        for (WS* ws : sockets_) {
+            if (Topics::wanted(ws->getUserData()->patterns, topic)) subscribers_[topic].insert(ws);
+        }
+    }
+
+    // 設定中的主題 (PLC、各相機)：移除只屬於舊設定的主題，依各 Client 的規則重新訂閱，
+    // 已連線的 Client 另外收到 TOPICS (新的主題清單)
+    void apply_config_topics(const Config::AppConfig& cfg) {
+        std::set<std::string> topics = {Topics::SYS, Topics::WATCHDOG, Topics::SCANNER, Topics::plc(cfg.hub_ip)};
+        for (const auto& [ip, role] : cfg.camera_mapping) {
+            topics.insert(Topics::camera(role));
+            topics.insert(Topics::camera(role) + "/monitor");
+        }
+        if (topics == config_topics_) return;
+
+        for (const auto& topic : config_topics_) {
+            if (topics.count(topic)) continue;
+            known_topics_.erase(topic); // 之後若仍有推播，drain_outbox 會重新登錄
+            subscribers_.erase(topic);
+        }
+        known_topics_.insert(topics.begin(), topics.end());
+        config_topics_ = std::move(topics);
+        if (sockets_.empty()) return;
+
+        spdlog::info("[WS] Topics updated from config ({} known)", known_topics_.size());
+        auto frame = std::make_shared<const WsFrame>(WsFrame::control("TOPICS", {{"topics", known_topics_}}));
+        for (WS* ws : sockets_) {
+            apply_patterns(ws);
+            deliver(ws, "", Delivery::EVENT, frame);
+        }
+        end_closing();
+    }
+
+    // 依 Client 的規則訂閱所有已知主題
+    void apply_patterns(WS* ws) {
+        for (const auto& topic : known_topics_) {
+            if (Topics::wanted(ws->getUserData()->patterns, topic)) subscribers_[topic].insert(ws);
+            else subscribers_[topic].erase(ws);
+        }
+    }
+
+    void remove_socket(WS* ws) {
+        sockets_.erase(ws);
+        for (auto& [topic, set] : subscribers_) set.erase(ws);
+    }
+
+    // SUBSCRIBE: 第一次明確訂閱時會取代預設的 "*" (全部)，並移除同名的排除規則
+    // UNSUBSCRIBE: 移除同名規則；被較廣的規則涵蓋時 (e.g. 預設的 "*") 改加排除規則 "!<pattern>"，
+    //              兩者皆非 (本來就沒訂閱) 時列在回覆的 not_subscribed
+    void update_subscriptions(WS* ws, bool subscribe, const json& topics) {
+        auto& patterns = ws->getUserData()->patterns;
+        if (subscribe && patterns.size() == 1 && patterns[0] == "*") patterns.clear();
+
+        json not_subscribed = json::array();
+        for (const auto& t : topics) {
+            if (!t.is_string()) continue;
+            std::string pattern = t.get<std::string>();
+            if (pattern.empty() || pattern[0] == '!') continue;
+            auto excluded = std::find(patterns.begin(), patterns.end(), "!" + pattern);
+            if (subscribe) {
+                if (excluded != patterns.end()) patterns.erase(excluded);
+                if (std::find(patterns.begin(), patterns.end(), pattern) == patterns.end()) patterns.push_back(pattern);
+                continue;
+            }
+            bool already_excluded = excluded != patterns.end();
+            // 同名與被它涵蓋的較窄規則 (e.g. 取消 "camera/*" 時的 "camera/CAMERA_LEFT_1") 一併移除
+            size_t before = patterns.size();
+            patterns.erase(std::remove_if(patterns.begin(), patterns.end(), [&](const std::string& p) {
+                return p.empty() || (p[0] != '!' && Topics::matches(pattern, p));
+            }), patterns.end());
+            bool removed = patterns.size() != before;
+            if (Topics::wanted(patterns, pattern)) patterns.push_back("!" + pattern);
+            else if (!removed && !already_excluded) not_subscribed.push_back(pattern);
+        }
+        apply_patterns(ws);
+
+        json reply_payload = {{"topics", patterns}};
+        if (!not_subscribed.empty()) {
+            reply_payload["not_subscribed"] = std::move(not_subscribed);
+            reply_payload["error"] = "not subscribed";
+        }
+        reply(ws, WsFrame::control("SUBSCRIPTIONS", std::move(reply_payload)));
+    }
+
+    void set_listen_state(int state) {
+        {
+            std::lock_guard<std::mutex> lock(listen_mutex_);
+            listen_state_ = state;
+        }
+        listen_cond_.notify_all();
+    }
 };
\ No newline at end of file
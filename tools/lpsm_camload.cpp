@@ -0,0 +1,544 @@
+// 相機負載產生器 (CamServer / CamSession 擴充測試)
+// 模擬 N 台相機：每台從不同的 loopback 位址 (127.0.0.11, .12, ...) 連到 CamServer，
+// 依 camera_mapping 對應成 CAMERA_LEFT_n / CAMERA_RIGHT_n；同時以 WebSocket 訂閱 camera/*，
+// 量測條碼 -> WS 推播的送達率與端到端延遲 (條碼內含送出時間，同一台電腦的 steady_clock 可直接相減)
+//
+//   lpsm_camload [--host 127.0.0.1] [--cam-port 6060] [--ws-port 8181]
+//                [--cameras 4] [--base-ip 127.0.0.11] [--rate 10] [--duration 30]
+//                [--framing crlf|cr|lf|none|split|batch] [--batch 4] [--split-gap-ms 2]
+//                [--idle-every 0 --idle-for 12] [--churn-every 0]
+//                [--threads 2] [--report 5] [--grace 3] [--json]
+//   lpsm_camload --cameras 16 --print-mapping                     # 輸出 camera_mapping (ip -> role)
+//   lpsm_camload --cameras 16 --hub-ip 10.8.32.64 --snapshot state/config_snapshot.bin
+//                                                                 # 把對應寫入 Hub 的本機快照 (保留其他設定)
+//
+// --framing: crlf / cr / lf 每次寫入一個條碼；none 不帶結尾 (舊機種)；
+//            split 把一個條碼拆成兩次寫入 (間隔 --split-gap-ms)；batch 一次寫入 --batch 個條碼
+// --idle-every / --idle-for: 每送 S 秒後停止 S 秒 (超過 10 秒會觸發 TIMEOUT_BLANK)
+// --churn-every: 每 S 秒斷線重連一次 (各相機錯開)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <nlohmann/json.hpp>
+#include "core/Config.hpp"
+#include "core/Latency.hpp"
+
+namespace {
+
+namespace asio = boost::asio;
+namespace websocket = boost::beast::websocket;
+using tcp = asio::ip::tcp;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+constexpr int HUB_CAMERA_TIMEOUT_S = 10; // CamSession 無資料逾時
+
+enum class Framing { CRLF, CR, LF, NONE, SPLIT, BATCH };
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int cam_port = 6060;
+    int ws_port = 8181;
+    int cameras = 4;
+    std::string base_ip = "127.0.0.11";
+    double rate = 10.0;      // 每台每秒條碼數
+    double duration = 30.0;  // 秒
+    Framing framing = Framing::CRLF;
+    int batch = 4;
+    int split_gap_ms = 2;
+    double idle_every = 0;   // 0 = 不停頓
+    double idle_for = 12;
+    double churn_every = 0;  // 0 = 不重連
+    int threads = 2;
+    double report = 5;
+    double grace = 3;        // 停止送出後等待推播到齊的秒數
+    bool as_json = false;
+    bool print_mapping = false;
+    std::string snapshot;
+    std::string hub_ip;
+};
+
+struct Stats {
+    // 相機端
+    std::atomic<uint64_t> connects{0}, connect_failures{0}, churns{0}, write_errors{0};
+    std::atomic<uint64_t> sent{0}, writes{0}, idle_gaps{0}, expected_timeouts{0};
+    // WS 端
+    std::atomic<uint64_t> received{0}, duplicates{0}, out_of_order{0}, unmapped{0}, timeouts{0}, corrupt{0};
+    std::atomic<bool> ws_connected{false};
+    LatencyHistogram latency; // 條碼寫入完成 -> WS 收到 (us)
+};
+
+std::string camera_ip(const Options& opt, int index) {
+    uint32_t base = asio::ip::make_address_v4(opt.base_ip).to_uint();
+    return asio::ip::address_v4(base + (uint32_t)index).to_string();
+}
+
+std::string camera_role(int index) {
+    return (index % 2 == 0 ? "CAMERA_LEFT_" : "CAMERA_RIGHT_") + std::to_string(index / 2 + 1);
+}
+
+// 條碼：LG<相機>-<序號>-<送出時間 ns>-<檢查碼>
+// 檢查碼讓被切斷 / 黏在一起的條碼 (分框錯誤) 不會被當成正常條碼
+unsigned check_of(int camera, unsigned long long seq, unsigned long long ts) {
+    return (unsigned)(((unsigned long long)camera + seq + ts) % 97);
+}
+
+std::string make_barcode(int camera, uint64_t seq) {
+    char buf[80];
+    unsigned long long ts = trace_now_ns();
+    std::snprintf(buf, sizeof(buf), "LG%02d-%llu-%llu-%02u", camera, (unsigned long long)seq, ts,
+                  check_of(camera, seq, ts));
+    return buf;
+}
+
+bool parse_barcode(const std::string& s, int& camera, uint64_t& seq, uint64_t& sent_ns) {
+    unsigned long long q = 0, t = 0;
+    unsigned check = 0;
+    int consumed = 0;
+    if (s.rfind("LG", 0) != 0 ||
+        std::sscanf(s.c_str() + 2, "%d-%llu-%llu-%u%n", &camera, &q, &t, &check, &consumed) != 4 ||
+        (size_t)consumed + 2 != s.size() || check != check_of(camera, q, t)) {
+        return false;
+    }
+    seq = q;
+    sent_ns = t;
+    return true;
+}
+
+// ---- 模擬相機 ----
+// 所有操作都在自己的 strand 上，同一台相機只有一條非同步鏈 (連線 -> 送出 -> 計時 -> ...)
+class Camera : public std::enable_shared_from_this<Camera> {
+public:
+    Camera(asio::io_context& ioc, const Options& opt, int index, Stats& stats)
+        : opt_(opt), index_(index), stats_(stats), strand_(asio::make_strand(ioc)),
+          socket_(strand_), timer_(strand_) {
+        endpoint_ = tcp::endpoint(asio::ip::make_address(opt.host), (unsigned short)opt.cam_port);
+        local_ = tcp::endpoint(asio::ip::make_address(camera_ip(opt, index)), 0);
+        per_write_ = opt.framing == Framing::BATCH ? std::max(1, opt.batch) : 1;
+        interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(per_write_ / opt.rate));
+    }
+
+    void start() {
+        asio::post(strand_, [self = shared_from_this()] {
+            auto now = Clock::now();
+            // 各相機錯開停頓與重連的時間點，避免同時發生
+            double stagger = (double)self->index_ / std::max(1, self->opt_.cameras);
+            self->idle_start_ = now + seconds(self->opt_.idle_every * (0.5 + 0.5 * stagger));
+            self->next_churn_ = now + seconds(self->opt_.churn_every * (0.5 + 0.5 * stagger));
+            self->connect();
+        });
+    }
+
+    void stop() {
+        asio::post(strand_, [self = shared_from_this()] {
+            self->stopping_ = true;
+            self->timer_.cancel();
+            boost::system::error_code ec;
+            self->socket_.close(ec);
+        });
+    }
+
+private:
+    const Options& opt_;
+    int index_;
+    Stats& stats_;
+    asio::strand<asio::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    asio::steady_timer timer_;
+    tcp::endpoint endpoint_, local_;
+    bool stopping_ = false;
+    bool idling_ = false;
+    uint64_t seq_ = 0;
+    int per_write_ = 1;
+    Clock::duration interval_{};
+    Clock::time_point next_send_, idle_start_, next_churn_;
+    std::vector<std::string> chunks_;
+
+    static Clock::duration seconds(double s) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+    }
+
+    void connect() {
+        if (stopping_) return;
+        boost::system::error_code ec;
+        socket_.close(ec);
+        socket_.open(tcp::v4(), ec);
+        if (!ec) socket_.bind(local_, ec); // 來源位址決定 Hub 端的相機角色
+        if (ec) {
+            stats_.connect_failures.fetch_add(1, std::memory_order_relaxed);
+            retry_later();
+            return;
+        }
+        socket_.async_connect(endpoint_, [self = shared_from_this()](boost::system::error_code ec) {
+            if (ec) {
+                self->stats_.connect_failures.fetch_add(1, std::memory_order_relaxed);
+                self->retry_later();
+                return;
+            }
+            self->socket_.set_option(tcp::no_delay(true), ec); // split 才會真的分成兩個 TCP segment
+            self->stats_.connects.fetch_add(1, std::memory_order_relaxed);
+            self->next_send_ = Clock::now();
+            self->tick();
+        });
+    }
+
+    void retry_later() {
+        timer_.expires_after(std::chrono::milliseconds(200));
+        timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) self->connect();
+        });
+    }
+
+    void wait_until(Clock::time_point t) {
+        timer_.expires_at(t);
+        timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) self->tick();
+        });
+    }
+
+    void tick() {
+        if (stopping_) return;
+        auto now = Clock::now();
+
+        // 停頓完整結束才計入預期的 TIMEOUT_BLANK (測試在停頓中結束則不計)
+        if (idling_) {
+            idling_ = false;
+            stats_.expected_timeouts.fetch_add((uint64_t)(opt_.idle_for / HUB_CAMERA_TIMEOUT_S), std::memory_order_relaxed);
+        }
+
+        if (opt_.churn_every > 0 && now >= next_churn_) {
+            next_churn_ = now + seconds(opt_.churn_every);
+            stats_.churns.fetch_add(1, std::memory_order_relaxed);
+            connect();
+            return;
+        }
+
+        if (opt_.idle_every > 0 && now >= idle_start_) {
+            auto resume = now + seconds(opt_.idle_for);
+            idle_start_ = resume + seconds(opt_.idle_every);
+            stats_.idle_gaps.fetch_add(1, std::memory_order_relaxed);
+            idling_ = true;
+            next_send_ = resume;
+            wait_until(resume);
+            return;
+        }
+
+        if (now < next_send_) {
+            wait_until(next_send_);
+            return;
+        }
+        // 落後太多 (例如剛重連) 就從現在重新起算，不補送
+        next_send_ = std::max(next_send_ + interval_, now - std::chrono::seconds(1));
+
+        chunks_.clear();
+        std::string payload;
+        for (int i = 0; i < per_write_; ++i) {
+            payload += make_barcode(index_, ++seq_);
+            switch (opt_.framing) {
+                case Framing::CR: payload += "\r"; break;
+                case Framing::LF: payload += "\n"; break;
+                case Framing::NONE: break;
+                default: payload += "\r\n"; break;
+            }
+        }
+        if (opt_.framing == Framing::SPLIT) {
+            size_t half = payload.size() / 2;
+            chunks_.push_back(payload.substr(0, half));
+            chunks_.push_back(payload.substr(half));
+        } else {
+            chunks_.push_back(std::move(payload));
+        }
+        write_chunk(0);
+    }
+
+    void write_chunk(size_t i) {
+        asio::async_write(socket_, asio::buffer(chunks_[i]), [self = shared_from_this(), i](boost::system::error_code ec, size_t) {
+            if (ec) {
+                if (self->stopping_) return;
+                self->stats_.write_errors.fetch_add(1, std::memory_order_relaxed);
+                self->retry_later();
+                return;
+            }
+            self->stats_.writes.fetch_add(1, std::memory_order_relaxed);
+            if (i + 1 < self->chunks_.size()) {
+                self->timer_.expires_after(std::chrono::milliseconds(self->opt_.split_gap_ms));
+                self->timer_.async_wait([self, i](boost::system::error_code ec) {
+                    if (!ec) self->write_chunk(i + 1);
+                });
+                return;
+            }
+            self->stats_.sent.fetch_add(self->per_write_, std::memory_order_relaxed);
+            self->tick();
+        });
+    }
+};
+
+// ---- WS 接收端 ----
+class WsProbe : public std::enable_shared_from_this<WsProbe> {
+public:
+    WsProbe(asio::io_context& ioc, const Options& opt, Stats& stats)
+        : opt_(opt), stats_(stats), strand_(asio::make_strand(ioc)), ws_(strand_) {}
+
+    void start() {
+        tcp::endpoint ep(asio::ip::make_address(opt_.host), (unsigned short)opt_.ws_port);
+        ws_.next_layer().async_connect(ep, [self = shared_from_this()](boost::system::error_code ec) {
+            if (ec) return self->fail("connect", ec);
+            self->ws_.async_handshake(self->opt_.host + ":" + std::to_string(self->opt_.ws_port), "/",
+                [self](boost::system::error_code ec) {
+                    if (ec) return self->fail("handshake", ec);
+                    self->subscribe();
+                });
+        });
+    }
+
+    void stop() {
+        asio::post(strand_, [self = shared_from_this()] {
+            self->stopping_ = true;
+            boost::system::error_code ec;
+            self->ws_.next_layer().close(ec);
+        });
+    }
+
+private:
+    const Options& opt_;
+    Stats& stats_;
+    asio::strand<asio::io_context::executor_type> strand_;
+    websocket::stream<tcp::socket> ws_;
+    boost::beast::flat_buffer buffer_;
+    std::string subscribe_;
+    bool stopping_ = false;
+    std::unordered_map<int, uint64_t> last_seq_;  // 相機 -> 最後收到的序號
+    std::unordered_set<uint64_t> seen_;            // (相機 << 40) | 序號
+
+    void fail(const char* what, boost::system::error_code ec) {
+        stats_.ws_connected = false;
+        if (!stopping_) std::fprintf(stderr, "ws %s: %s\n", what, ec.message().c_str());
+    }
+
+    void subscribe() {
+        stats_.ws_connected = true;
+        subscribe_ = json{{"command", "SUBSCRIBE"}, {"payload", {{"topics", {"camera/*"}}}}}.dump();
+        ws_.text(true);
+        ws_.async_write(asio::buffer(subscribe_), [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            if (ec) return self->fail("subscribe", ec);
+            self->read();
+        });
+    }
+
+    void read() {
+        ws_.async_read(buffer_, [self = shared_from_this()](boost::system::error_code ec, size_t) {
+            if (ec) return self->fail("read", ec);
+            uint64_t now = trace_now_ns();
+            if (self->ws_.got_text()) self->handle(boost::beast::buffers_to_string(self->buffer_.data()), now);
+            self->buffer_.consume(self->buffer_.size());
+            self->read();
+        });
+    }
+
+    void handle(const std::string& text, uint64_t now) {
+        json msg = json::parse(text, nullptr, false);
+        if (msg.is_discarded() || msg.value("type", "") != "data") return;
+        std::string source = msg.value("source", "");
+        if (source.rfind("CAMERA", 0) != 0 || !msg.contains("payload") || !msg["payload"].is_string()) return;
+
+        std::string payload = msg["payload"].get<std::string>();
+        if (payload == "TIMEOUT_BLANK") {
+            stats_.timeouts.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        int camera = 0;
+        uint64_t seq = 0, sent_ns = 0;
+        if (!parse_barcode(payload, camera, seq, sent_ns)) {
+            stats_.corrupt.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (source.rfind("CAMERA_UNKNOWN_", 0) == 0) stats_.unmapped.fetch_add(1, std::memory_order_relaxed);
+        if (!seen_.insert(((uint64_t)camera << 40) | seq).second) {
+            stats_.duplicates.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uint64_t& last = last_seq_[camera];
+        if (seq < last) stats_.out_of_order.fetch_add(1, std::memory_order_relaxed);
+        last = std::max(last, seq);
+        stats_.received.fetch_add(1, std::memory_order_relaxed);
+        stats_.latency.record_ns(sent_ns, now);
+    }
+};
+
+bool parse_framing(const std::string& s, Framing& out) {
+    static const std::pair<const char*, Framing> names[] = {
+        {"crlf", Framing::CRLF}, {"cr", Framing::CR}, {"lf", Framing::LF},
+        {"none", Framing::NONE}, {"split", Framing::SPLIT}, {"batch", Framing::BATCH}};
+    for (const auto& [name, f] : names) {
+        if (s == name) { out = f; return true; }
+    }
+    return false;
+}
+
+json mapping(const Options& opt) {
+    json out = json::object();
+    for (int i = 0; i < opt.cameras; ++i) out[camera_ip(opt, i)] = camera_role(i);
+    return out;
+}
+
+// 既有快照保留 PLC 等設定，只加入 / 覆寫模擬相機的對應
+// (Hub 之後向 DB 重新載入設定時會被 DB 內容取代)
+int write_snapshot(const Options& opt) {
+    Config::AppConfig cfg;
+    uint64_t saved_at = 0;
+    Config::read_snapshot(opt.snapshot, cfg, saved_at);
+    if (!opt.hub_ip.empty()) cfg.hub_ip = opt.hub_ip;
+    if (cfg.hub_ip.empty()) {
+        std::fprintf(stderr, "--hub-ip is required when the snapshot does not exist yet\n");
+        return 2;
+    }
+    for (int i = 0; i < opt.cameras; ++i) cfg.camera_mapping[camera_ip(opt, i)] = camera_role(i);
+    if (!Config::save_snapshot(cfg, opt.snapshot)) return 1;
+    std::printf("wrote %d camera mappings to %s (hub %s)\n", opt.cameras, opt.snapshot.c_str(), cfg.hub_ip.c_str());
+    return 0;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: lpsm_camload [--host 127.0.0.1] [--cam-port 6060] [--ws-port 8181] [--cameras 4]\n"
+        "                    [--base-ip 127.0.0.11] [--rate 10] [--duration 30]\n"
+        "                    [--framing crlf|cr|lf|none|split|batch] [--batch 4] [--split-gap-ms 2]\n"
+        "                    [--idle-every 0 --idle-for 12] [--churn-every 0] [--threads 2]\n"
+        "                    [--report 5] [--grace 3] [--json]\n"
+        "                    [--print-mapping] [--snapshot path --hub-ip ip]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--json") opt.as_json = true;
+        else if (a == "--print-mapping") opt.print_mapping = true;
+        else if (!has_value) { usage(); return 2; }
+        else if (a == "--host") opt.host = argv[++i];
+        else if (a == "--cam-port") opt.cam_port = std::atoi(argv[++i]);
+        else if (a == "--ws-port") opt.ws_port = std::atoi(argv[++i]);
+        else if (a == "--cameras") opt.cameras = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--base-ip") opt.base_ip = argv[++i];
+        else if (a == "--rate") opt.rate = std::max(0.01, std::atof(argv[++i]));
+        else if (a == "--duration") opt.duration = std::max(0.1, std::atof(argv[++i]));
+        else if (a == "--framing") { if (!parse_framing(argv[++i], opt.framing)) { usage(); return 2; } }
+        else if (a == "--batch") opt.batch = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--split-gap-ms") opt.split_gap_ms = std::max(0, std::atoi(argv[++i]));
+        else if (a == "--idle-every") opt.idle_every = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--idle-for") opt.idle_for = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--churn-every") opt.churn_every = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--threads") opt.threads = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--report") opt.report = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--grace") opt.grace = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--snapshot") opt.snapshot = argv[++i];
+        else if (a == "--hub-ip") opt.hub_ip = argv[++i];
+        else { usage(); return 2; }
+    }
+    try {
+        camera_ip(opt, opt.cameras - 1);
+    } catch (const std::exception&) {
+        std::fprintf(stderr, "invalid --base-ip %s\n", opt.base_ip.c_str());
+        return 2;
+    }
+
+    if (opt.print_mapping) {
+        std::printf("%s\n", mapping(opt).dump(2).c_str());
+        return 0;
+    }
+    if (!opt.snapshot.empty()) return write_snapshot(opt);
+
+    asio::io_context ioc;
+    auto guard = asio::make_work_guard(ioc);
+    Stats stats;
+
+    auto probe = std::make_shared<WsProbe>(ioc, opt, stats);
+    probe->start();
+    std::vector<std::shared_ptr<Camera>> cameras;
+    for (int i = 0; i < opt.cameras; ++i) cameras.push_back(std::make_shared<Camera>(ioc, opt, i, stats));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.threads; ++i) threads.emplace_back([&ioc] { ioc.run(); });
+
+    // WS 先訂閱好再開始送，避免開頭的條碼被算成遺失
+    auto wait_ws = Clock::now() + std::chrono::seconds(3);
+    while (!stats.ws_connected && Clock::now() < wait_ws) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if (!stats.ws_connected) std::fprintf(stderr, "warning: WebSocket not connected, delivery will read 0\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // SUBSCRIBE 由 Hub 處理
+
+    auto begin = Clock::now();
+    for (auto& c : cameras) c->start();
+
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+    auto next_report = begin;
+    while (Clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (opt.report <= 0 || opt.as_json || Clock::now() < next_report) continue;
+        next_report += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.report));
+        double t = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::fprintf(stderr, "[%6.1fs] sent=%llu received=%llu p50=%.0fus p99=%.0fus connects=%llu timeouts=%llu\n", t,
+                     (unsigned long long)stats.sent.load(), (unsigned long long)stats.received.load(),
+                     stats.latency.percentile(50), stats.latency.percentile(99),
+                     (unsigned long long)stats.connects.load(), (unsigned long long)stats.timeouts.load());
+    }
+    for (auto& c : cameras) c->stop();
+    double send_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.grace));
+    probe->stop();
+    guard.reset();
+    ioc.stop();
+    for (auto& t : threads) t.join();
+
+    uint64_t sent = stats.sent.load(), received = stats.received.load();
+    double delivery = sent ? 100.0 * (double)received / (double)sent : 0.0;
+    json out = {
+        {"cameras", opt.cameras}, {"rate_per_camera", opt.rate}, {"seconds", send_seconds},
+        {"sent", sent}, {"received", received}, {"delivery_pct", delivery},
+        {"sent_per_s", sent / send_seconds}, {"received_per_s", received / send_seconds},
+        {"latency_us", {{"p50", stats.latency.percentile(50)}, {"p90", stats.latency.percentile(90)},
+                        {"p99", stats.latency.percentile(99)}, {"p999", stats.latency.percentile(99.9)},
+                        {"max", stats.latency.max()}, {"mean", stats.latency.mean()}}},
+        {"duplicates", stats.duplicates.load()}, {"out_of_order", stats.out_of_order.load()},
+        {"unmapped", stats.unmapped.load()}, {"corrupt", stats.corrupt.load()},
+        {"writes", stats.writes.load()}, {"write_errors", stats.write_errors.load()},
+        {"connects", stats.connects.load()}, {"connect_failures", stats.connect_failures.load()},
+        {"churns", stats.churns.load()}, {"idle_gaps", stats.idle_gaps.load()},
+        {"timeouts", stats.timeouts.load()}, {"expected_timeouts", stats.expected_timeouts.load()}};
+
+    if (opt.as_json) {
+        std::printf("%s\n", out.dump(2).c_str());
+        return 0;
+    }
+    std::printf("cameras       %d x %.1f/s for %.1f s\n", opt.cameras, opt.rate, send_seconds);
+    std::printf("delivered     %llu / %llu (%.2f%%), %.0f/s\n", (unsigned long long)received,
+                (unsigned long long)sent, delivery, received / send_seconds);
+    std::printf("latency       p50=%.0f us p90=%.0f us p99=%.0f us p99.9=%.0f us max=%llu us\n",
+                stats.latency.percentile(50), stats.latency.percentile(90), stats.latency.percentile(99),
+                stats.latency.percentile(99.9), (unsigned long long)stats.latency.max());
+    std::printf("ordering      duplicates=%llu out_of_order=%llu unmapped=%llu corrupt=%llu\n",
+                (unsigned long long)stats.duplicates.load(), (unsigned long long)stats.out_of_order.load(),
+                (unsigned long long)stats.unmapped.load(), (unsigned long long)stats.corrupt.load());
+    std::printf("connections   connects=%llu failures=%llu churns=%llu write_errors=%llu\n",
+                (unsigned long long)stats.connects.load(), (unsigned long long)stats.connect_failures.load(),
+                (unsigned long long)stats.churns.load(), (unsigned long long)stats.write_errors.load());
+    std::printf("timeouts      received=%llu expected=%llu (idle gaps %llu)\n",
+                (unsigned long long)stats.timeouts.load(), (unsigned long long)stats.expected_timeouts.load(),
+                (unsigned long long)stats.idle_gaps.load());
+    return 0;
+}
\ No newline at end of file
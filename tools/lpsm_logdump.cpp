@@ -0,0 +1,208 @@
+// 二進位 Log 解碼 (LPSM_LOG_MODE=binary 產生的 logs/*.blog.gz)
+// 依檔名順序輸出，格式定義取自檔案內的 'F' 紀錄
+//
+//   lpsm_logdump [--json] [--module PLC] [--level warn] <file.blog.gz>...
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+#include <nlohmann/json.hpp>
+#include "core/BinLog.hpp"
+
+namespace {
+
+using json = nlohmann::json;
+
+const char* LEVEL_NAMES[] = {"trace", "debug", "info", "warn", "error", "critical", "off"};
+
+struct Format {
+    std::string fmt;
+    std::string where;
+};
+
+struct Options {
+    bool as_json = false;
+    int module = -1;
+    int min_level = 0;
+};
+
+bool read_exact(gzFile f, void* buf, unsigned n) {
+    return gzread(f, buf, n) == (int)n;
+}
+
+// 依 Tag 取出參數並轉成字串
+std::vector<std::string> decode_args(const BinLog::Record& r) {
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos < BinLog::ARG_BYTES && r.args[pos] != BinLog::END) {
+        uint8_t tag = r.args[pos++];
+        if (tag == BinLog::STR) {
+            if (pos >= BinLog::ARG_BYTES) break;
+            size_t len = r.args[pos++];
+            if (pos + len > BinLog::ARG_BYTES) break;
+            out.emplace_back((const char*)r.args + pos, len);
+            pos += len;
+            continue;
+        }
+        if (tag == BinLog::BOOL) {
+            if (pos + 1 > BinLog::ARG_BYTES) break;
+            out.emplace_back(r.args[pos++] ? "true" : "false");
+            continue;
+        }
+        if (pos + 8 > BinLog::ARG_BYTES) break;
+        char buf[32];
+        if (tag == BinLog::I64) {
+            int64_t v;
+            std::memcpy(&v, r.args + pos, 8);
+            std::snprintf(buf, sizeof(buf), "%lld", (long long)v);
+        } else if (tag == BinLog::U64) {
+            uint64_t v;
+            std::memcpy(&v, r.args + pos, 8);
+            std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+        } else if (tag == BinLog::F64) {
+            double v;
+            std::memcpy(&v, r.args + pos, 8);
+            std::snprintf(buf, sizeof(buf), "%g", v);
+        } else {
+            break;
+        }
+        pos += 8;
+        out.emplace_back(buf);
+    }
+    return out;
+}
+
+// "{}" / "{:...}" 依序代入參數，"{{" "}}" 為跳脫
+std::string render(const std::string& fmt, const std::vector<std::string>& args, bool truncated) {
+    std::string out;
+    size_t next = 0;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        char c = fmt[i];
+        if (c == '{' && i + 1 < fmt.size() && fmt[i + 1] == '{') { out += '{'; ++i; continue; }
+        if (c == '}' && i + 1 < fmt.size() && fmt[i + 1] == '}') { out += '}'; ++i; continue; }
+        if (c == '{') {
+            size_t end = fmt.find('}', i);
+            if (end == std::string::npos) { out.append(fmt, i, std::string::npos); break; }
+            out += next < args.size() ? args[next] : "<?>";
+            ++next;
+            i = end;
+            continue;
+        }
+        out += c;
+    }
+    if (truncated) out += " <truncated>";
+    return out;
+}
+
+std::string format_time(uint64_t ts_ns) {
+    std::time_t sec = (std::time_t)(ts_ns / 1000000000ULL);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&sec));
+    char out[48];
+    std::snprintf(out, sizeof(out), "%s.%06llu", buf, (unsigned long long)(ts_ns / 1000 % 1000000));
+    return out;
+}
+
+bool dump_file(const char* path, const Options& opt) {
+    gzFile f = gzopen(path, "rb");
+    if (!f) {
+        std::fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char magic[8];
+    if (!read_exact(f, magic, 8) || std::memcmp(magic, "LPSMBLG1", 8) != 0) {
+        std::fprintf(stderr, "%s: not a binary log\n", path);
+        gzclose(f);
+        return false;
+    }
+
+    std::unordered_map<uint16_t, Format> formats;
+    bool ok = true;
+    char kind;
+    while (read_exact(f, &kind, 1)) {
+        if (kind == 'F') {
+            uint16_t id, len;
+            uint8_t module_level[2];
+            Format def;
+            if (!read_exact(f, &id, 2) || !read_exact(f, module_level, 2) || !read_exact(f, &len, 2)) { ok = false; break; }
+            def.fmt.resize(len);
+            if (len && !read_exact(f, def.fmt.data(), len)) { ok = false; break; }
+            if (!read_exact(f, &len, 2)) { ok = false; break; }
+            def.where.resize(len);
+            if (len && !read_exact(f, def.where.data(), len)) { ok = false; break; }
+            formats[id] = std::move(def);
+        } else if (kind == 'R') {
+            BinLog::Record r;
+            if (!read_exact(f, &r, sizeof(r))) { ok = false; break; }
+            if (opt.module >= 0 && r.module != opt.module) continue;
+            if (r.level < opt.min_level) continue;
+
+            auto it = formats.find(r.fmt);
+            std::string fmt = it == formats.end() ? "<unknown format " + std::to_string(r.fmt) + ">" : it->second.fmt;
+            auto args = decode_args(r);
+            std::string message = render(fmt, args, r.truncated);
+            const char* level = r.level < 7 ? LEVEL_NAMES[r.level] : "?";
+            const char* module = r.module < (int)LogModule::COUNT ? BinLog::module_name((LogModule)r.module) : "?";
+
+            if (opt.as_json) {
+                json line = {{"ts_ns", r.ts_ns}, {"level", level}, {"module", module}, {"thread", r.thread},
+                             {"message", message}, {"args", args}};
+                if (it != formats.end()) line["where"] = it->second.where;
+                std::printf("%s\n", line.dump().c_str());
+            } else {
+                std::printf("[%s] [%s] [%s] [t%u] %s\n", format_time(r.ts_ns).c_str(), level, module, r.thread, message.c_str());
+            }
+        } else {
+            ok = false;
+            break;
+        }
+    }
+    // 寫檔中被強制結束時最後一筆可能不完整，只提示不視為錯誤
+    if (!ok) std::fprintf(stderr, "%s: truncated or corrupt record, stopped\n", path);
+    gzclose(f);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            opt.as_json = true;
+        } else if (std::strcmp(argv[i], "--module") == 0 && i + 1 < argc) {
+            LogModule m;
+            if (!BinLog::module_from_name(argv[++i], m)) {
+                std::fprintf(stderr, "unknown module %s\n", argv[i]);
+                return 2;
+            }
+            opt.module = (int)m;
+        } else if (std::strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            opt.min_level = -1;
+            for (int l = 0; l < 7; ++l) {
+                if (std::strcmp(name, LEVEL_NAMES[l]) == 0) opt.min_level = l;
+            }
+            if (opt.min_level < 0) {
+                std::fprintf(stderr, "unknown level %s\n", name);
+                return 2;
+            }
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "usage: lpsm_logdump [--json] [--module PLC] [--level warn] <file.blog.gz>...\n");
+        return 2;
+    }
+
+    int rc = 0;
+    for (const char* path : files) {
+        if (!dump_file(path, opt)) rc = 1;
+    }
+    return rc;
+}
\ No newline at end of file
@@ -0,0 +1,414 @@
+// 上傳中繼負載產生器 (UpstreamRelay / Aggregator 擴充測試)
+// 在同一個行程內模擬 N 個 Hub：每個 Hub 有自己的 StateStore 與推播序號 (取代 WsServer 的 WS 執行緒)，
+// 經由真正的 UpstreamRelay 以 loopback TCP 連到 Aggregator；Aggregator 的輸出接到計數用的 WsSink，
+// 量測條碼送達率 / 重複 / 順序、延遲 (Hub 推播 -> 彙總端重新發佈)、壓縮率與重新同步次數
+//
+//   lpsm_relayload [--hubs 8] [--cameras 4] [--rate 20] [--plc-hz 50] [--duration 20]
+//                  [--port 7070] [--flush-ms 50] [--churn-every 0] [--report 5] [--grace 2] [--json]
+//
+// 每個 Hub 每台相機每秒 --rate 個條碼 (camera/<role>，EVENT)，PLC 狀態每秒 --plc-hz 次 (STATE，同一批內合併)
+// --churn-every: 每 S 秒中斷一次各 Hub 的上傳連線 (各 Hub 錯開)，驗證重連後只補送遺漏的推播
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include "core/Latency.hpp"
+#include "server/Aggregator.hpp"
+#include "server/StateStore.hpp"
+#include "server/UpstreamRelay.hpp"
+
+namespace {
+
+namespace asio = boost::asio;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int hubs = 8;
+    int cameras = 4;         // 每個 Hub
+    double rate = 20.0;      // 每台相機每秒條碼數
+    double plc_hz = 50.0;    // 每個 Hub 每秒 PLC 狀態數
+    double duration = 20.0;  // 秒
+    int port = UpstreamProtocol::DEFAULT_PORT;
+    int flush_ms = 50;
+    double churn_every = 0;  // 0 = 不中斷
+    double report = 5;
+    double grace = 2;        // 停止送出後等待推播到齊的秒數
+    bool as_json = false;
+};
+
+std::string hub_name(int index) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "hub-%02d", index);
+    return buf;
+}
+
+std::string camera_role(int index) {
+    return (index % 2 == 0 ? "CAMERA_LEFT_" : "CAMERA_RIGHT_") + std::to_string(index / 2 + 1);
+}
+
+// 條碼：RL<hub>-<相機>-<序號>-<送出時間 ns>
+std::string make_barcode(int hub, int camera, uint64_t seq) {
+    char buf[80];
+    std::snprintf(buf, sizeof(buf), "RL%02d-%d-%llu-%llu", hub, camera, (unsigned long long)seq,
+                  (unsigned long long)trace_now_ns());
+    return buf;
+}
+
+bool parse_barcode(const std::string& s, int& hub, int& camera, uint64_t& seq, uint64_t& sent_ns) {
+    unsigned long long q = 0, t = 0;
+    return s.rfind("RL", 0) == 0 && std::sscanf(s.c_str() + 2, "%d-%d-%llu-%llu", &hub, &camera, &q, &t) == 4 &&
+           (seq = q, sent_ns = t, true);
+}
+
+// ---- 彙總端輸出：計數用的 WsSink (在 Aggregator 的 io 執行緒呼叫) ----
+class CountingSink : public WsSink {
+public:
+    explicit CountingSink(const Options& opt) : opt_(opt) {}
+
+    void publish(std::string topic, WsFrame frame, const TraceStamps&, Delivery) override {
+        uint64_t now = trace_now_ns();
+        json msg = frame.to_json();
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++frames_;
+        if (msg.value("type", "") == "control") {
+            std::string command = msg.value("command", "");
+            std::string hub = msg["payload"].value("hub", "");
+            if (command == "HUB_SNAPSHOT") {
+                ++snapshots_;
+                replay_budget_[hub] = opt_.cameras; // 快照內含各相機最後一筆條碼
+            } else if (command == "HUB_STATUS") {
+                (msg["payload"].value("online", false) ? online_events_ : offline_events_)++;
+            }
+            return;
+        }
+        if (msg.value("type", "") != "data" || !msg["payload"].is_string()) {
+            if (topic.find("/plc/") != std::string::npos) ++plc_states_;
+            return;
+        }
+
+        int hub = 0, camera = 0;
+        uint64_t seq = 0, sent_ns = 0;
+        if (!parse_barcode(msg["payload"].get<std::string>(), hub, camera, seq, sent_ns)) {
+            ++corrupt_;
+            return;
+        }
+        std::string expected = hub_name(hub) + "/" + camera_role(camera);
+        if (msg.value("source", "") != expected || topic != Topics::hub(hub_name(hub), Topics::camera(camera_role(camera)))) ++misrouted_;
+
+        uint64_t key = ((uint64_t)hub << 48) | ((uint64_t)camera << 40) | seq;
+        if (!seen_.insert(key).second) {
+            int& budget = replay_budget_[hub_name(hub)];
+            if (budget > 0) { --budget; ++replayed_; }
+            else ++duplicates_;
+            return;
+        }
+        uint64_t& last = last_seq_[((uint64_t)hub << 8) | (uint64_t)camera];
+        if (seq < last) ++out_of_order_;
+        last = std::max(last, seq);
+        ++received_;
+        latency_.record_ns(sent_ns, now);
+    }
+
+    void complete_request(std::string, json) override {}
+
+    json to_json() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {{"frames", frames_}, {"received", received_}, {"duplicates", duplicates_}, {"snapshot_replays", replayed_},
+                {"out_of_order", out_of_order_}, {"misrouted", misrouted_}, {"corrupt", corrupt_},
+                {"plc_states", plc_states_}, {"snapshots", snapshots_},
+                {"hub_online_events", online_events_}, {"hub_offline_events", offline_events_}};
+    }
+
+    uint64_t received() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return received_;
+    }
+
+    LatencyHistogram& latency() { return latency_; }
+
+private:
+    const Options& opt_;
+    std::mutex mutex_;
+    uint64_t frames_ = 0, received_ = 0, duplicates_ = 0, replayed_ = 0, out_of_order_ = 0;
+    uint64_t misrouted_ = 0, corrupt_ = 0, plc_states_ = 0, snapshots_ = 0, online_events_ = 0, offline_events_ = 0;
+    std::unordered_set<uint64_t> seen_;
+    std::map<uint64_t, uint64_t> last_seq_;
+    std::map<std::string, int> replay_budget_;
+    LatencyHistogram latency_; // Hub 推播 -> 彙總端重新發佈 (us)
+};
+
+// ---- 模擬 Hub：代替 WsServer 編號、記錄 StateStore 並交給 UpstreamRelay ----
+// 推播與同步都在 hub_ioc (單一執行緒) 上，相當於 Hub 的 WS 執行緒
+class SimHub : public std::enable_shared_from_this<SimHub> {
+public:
+    SimHub(asio::io_context& hub_ioc, asio::io_context& relay_ioc, const Options& opt, int index, std::atomic<uint64_t>& sent)
+        : opt_(opt), index_(index), sent_(sent), ioc_(hub_ioc), timer_(hub_ioc) {
+        UpstreamRelay::Options ro;
+        ro.host = "127.0.0.1";
+        ro.port = opt.port;
+        ro.hub_id = hub_name(index);
+        ro.flush_ms = opt.flush_ms;
+        relay_ = std::make_shared<UpstreamRelay>(relay_ioc, ro);
+        sources_.push_back(Sources::id_of("PLC"));
+        for (int c = 0; c < opt.cameras; ++c) sources_.push_back(Sources::id_of(camera_role(c)));
+        next_seq_.assign(opt.cameras, 0);
+    }
+
+    const UpstreamRelay& relay() const { return *relay_; }
+
+    void start() {
+        std::weak_ptr<SimHub> weak = shared_from_this();
+        relay_->set_sync_handler([weak](uint64_t generation, int64_t since) {
+            if (auto self = weak.lock()) {
+                asio::post(self->ioc_, [self, generation, since] { self->sync(generation, since); });
+            }
+        });
+        relay_->start();
+        asio::post(ioc_, [self = shared_from_this()] {
+            auto now = Clock::now();
+            self->next_churn_ = now + seconds(self->opt_.churn_every * (0.5 + 0.5 * self->index_ / std::max(1, self->opt_.hubs)));
+            self->next_plc_ = now;
+            self->next_barcode_.assign(self->opt_.cameras, now);
+            self->tick();
+        });
+    }
+
+    void stop() {
+        asio::post(ioc_, [self = shared_from_this()] {
+            self->stopping_ = true;
+            self->timer_.cancel();
+        });
+    }
+
+    bool stop_relay(std::chrono::milliseconds timeout) { return relay_->stop(timeout); }
+
+    uint64_t churns() const { return churns_.load(); }
+
+private:
+    const Options& opt_;
+    int index_;
+    std::atomic<uint64_t>& sent_;
+    asio::io_context& ioc_;
+    asio::steady_timer timer_;
+    std::shared_ptr<UpstreamRelay> relay_;
+    StateStore state_;
+    uint32_t seq_ = 1;
+    bool stopping_ = false;
+    uint8_t plc_bits_ = 0;
+    std::vector<SourceId> sources_; // [0] = PLC，其餘為相機
+    std::vector<uint64_t> next_seq_;
+    std::vector<Clock::time_point> next_barcode_;
+    Clock::time_point next_plc_, next_churn_;
+    std::atomic<uint64_t> churns_{0};
+
+    static Clock::duration seconds(double s) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+    }
+
+    // 與 WsServer::drain_outbox 相同：編號 -> StateStore -> relay
+    void publish(const std::string& topic, Delivery delivery, WsFrame frame) {
+        auto shared = std::make_shared<WsFrame>(std::move(frame));
+        shared->set_seq(seq_++);
+        bool retain = delivery == Delivery::STATE || (shared->type() == FrameType::BARCODE && Topics::is_camera(topic));
+        state_.record(topic, delivery, retain, shared);
+        relay_->offer(topic, delivery, *shared);
+    }
+
+    // 與 WsServer::sync_relay 相同
+    void sync(uint64_t generation, int64_t since) {
+        std::vector<StateStore::Entry> entries;
+        bool resume = since >= 0 && state_.deltas_since((uint32_t)since, entries);
+        if (!resume) entries = state_.snapshot();
+        relay_->begin_stream(generation, !resume, state_.last_seq(), entries);
+    }
+
+    void tick() {
+        if (stopping_) return;
+        auto now = Clock::now();
+
+        if (opt_.churn_every > 0 && now >= next_churn_) {
+            next_churn_ = now + seconds(opt_.churn_every);
+            churns_.fetch_add(1);
+            // 不等待關閉完成：start 排在 stop 之後，連線關閉後立即重連
+            relay_->stop(std::chrono::milliseconds(0));
+            relay_->start();
+        }
+
+        auto next = now + std::chrono::seconds(1);
+        if (opt_.plc_hz > 0) {
+            if (now >= next_plc_) {
+                next_plc_ = std::max(next_plc_ + seconds(1.0 / opt_.plc_hz), now - std::chrono::seconds(1));
+                plc_bits_ = (uint8_t)((plc_bits_ + 1) & 0x1F);
+                publish(Topics::plc("local"), Delivery::STATE, WsFrame::plc_state(sources_[0], plc_bits_));
+            }
+            next = std::min(next, next_plc_);
+        }
+        for (int c = 0; c < opt_.cameras; ++c) {
+            if (now >= next_barcode_[c]) {
+                next_barcode_[c] = std::max(next_barcode_[c] + seconds(1.0 / opt_.rate), now - std::chrono::seconds(1));
+                publish(Topics::camera(camera_role(c)), Delivery::EVENT,
+                        WsFrame::data(sources_[c + 1], make_barcode(index_, c, ++next_seq_[c])));
+                sent_.fetch_add(1, std::memory_order_relaxed);
+            }
+            next = std::min(next, next_barcode_[c]);
+        }
+
+        timer_.expires_at(next);
+        timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+            if (!ec) self->tick();
+        });
+    }
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: lpsm_relayload [--hubs 8] [--cameras 4] [--rate 20] [--plc-hz 50] [--duration 20]\n"
+        "                      [--port 7070] [--flush-ms 50] [--churn-every 0] [--report 5] [--grace 2] [--json]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--json") opt.as_json = true;
+        else if (!has_value) { usage(); return 2; }
+        else if (a == "--hubs") opt.hubs = std::max(1, std::min(99, std::atoi(argv[++i])));
+        else if (a == "--cameras") opt.cameras = std::max(1, std::min(64, std::atoi(argv[++i])));
+        else if (a == "--rate") opt.rate = std::max(0.01, std::atof(argv[++i]));
+        else if (a == "--plc-hz") opt.plc_hz = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--duration") opt.duration = std::max(0.1, std::atof(argv[++i]));
+        else if (a == "--port") opt.port = std::atoi(argv[++i]);
+        else if (a == "--flush-ms") opt.flush_ms = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--churn-every") opt.churn_every = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--report") opt.report = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "--grace") opt.grace = std::max(0.0, std::atof(argv[++i]));
+        else { usage(); return 2; }
+    }
+    spdlog::set_level(spdlog::level::warn); // Relay / Aggregator 的連線 Log 只留警告
+
+    // 三個 io_context 各一條執行緒：彙總端、Hub 端上傳 (relay)、Hub 端推播 (取代 WS 執行緒)
+    asio::io_context agg_ioc, relay_ioc, hub_ioc;
+    auto agg_guard = asio::make_work_guard(agg_ioc);
+    auto relay_guard = asio::make_work_guard(relay_ioc);
+    auto hub_guard = asio::make_work_guard(hub_ioc);
+
+    auto sink = std::make_shared<CountingSink>(opt);
+    std::shared_ptr<Aggregator> aggregator;
+    try {
+        aggregator = std::make_shared<Aggregator>(agg_ioc, sink, opt.port);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "cannot listen on port %d: %s\n", opt.port, e.what());
+        return 1;
+    }
+
+    std::vector<std::thread> threads;
+    for (auto* ioc : {&agg_ioc, &relay_ioc, &hub_ioc}) threads.emplace_back([ioc] { ioc->run(); });
+
+    std::atomic<uint64_t> sent{0};
+    std::vector<std::shared_ptr<SimHub>> hubs;
+    for (int i = 0; i < opt.hubs; ++i) hubs.push_back(std::make_shared<SimHub>(hub_ioc, relay_ioc, opt, i, sent));
+
+    auto begin = Clock::now();
+    for (auto& h : hubs) h->start();
+
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+    auto next_report = begin;
+    while (Clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (opt.report <= 0 || opt.as_json || Clock::now() < next_report) continue;
+        next_report += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.report));
+        double t = std::chrono::duration<double>(Clock::now() - begin).count();
+        const auto& as = aggregator->stats();
+        std::fprintf(stderr, "[%6.1fs] sent=%llu received=%llu p50=%.0fus p99=%.0fus hubs_online=%llu batches=%llu\n", t,
+                     (unsigned long long)sent.load(), (unsigned long long)sink->received(),
+                     sink->latency().percentile(50), sink->latency().percentile(99),
+                     (unsigned long long)as.hubs_online.load(), (unsigned long long)as.batches.load());
+    }
+    for (auto& h : hubs) h->stop();
+    double send_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.grace));
+
+    for (auto& h : hubs) h->stop_relay(std::chrono::milliseconds(500));
+    aggregator->stop(std::chrono::milliseconds(500));
+    agg_guard.reset();
+    relay_guard.reset();
+    hub_guard.reset();
+    agg_ioc.stop();
+    relay_ioc.stop();
+    hub_ioc.stop();
+    for (auto& t : threads) t.join();
+
+    uint64_t total_sent = sent.load(), connects = 0, batches = 0, entries = 0, raw = 0, wire = 0;
+    uint64_t conflated = 0, snapshots = 0, resumes = 0, overflows = 0, churns = 0;
+    for (const auto& h : hubs) {
+        const auto& s = h->relay().stats();
+        connects += s.connects.load();
+        batches += s.batches.load();
+        entries += s.entries.load();
+        raw += s.raw_bytes.load();
+        wire += s.wire_bytes.load();
+        conflated += s.conflated.load();
+        snapshots += s.snapshots.load();
+        resumes += s.resumes.load();
+        overflows += s.overflows.load();
+        churns += h->churns();
+    }
+    const auto& as = aggregator->stats();
+    json sink_stats = sink->to_json();
+    uint64_t received = sink_stats["received"];
+    double delivery = total_sent ? 100.0 * (double)received / (double)total_sent : 0.0;
+    auto& lat = sink->latency();
+    json out = {
+        {"hubs", opt.hubs}, {"cameras_per_hub", opt.cameras}, {"rate_per_camera", opt.rate}, {"plc_hz", opt.plc_hz},
+        {"flush_ms", opt.flush_ms}, {"seconds", send_seconds},
+        {"sent", total_sent}, {"delivery_pct", delivery},
+        {"latency_us", {{"p50", lat.percentile(50)}, {"p90", lat.percentile(90)}, {"p99", lat.percentile(99)},
+                        {"p999", lat.percentile(99.9)}, {"max", lat.max()}, {"mean", lat.mean()}}},
+        {"sink", sink_stats},
+        {"relay", {{"connects", connects}, {"batches", batches}, {"entries", entries}, {"raw_bytes", raw},
+                   {"wire_bytes", wire}, {"compression_ratio", wire ? (double)raw / (double)wire : 0.0},
+                   {"conflated", conflated}, {"snapshots", snapshots}, {"resumes", resumes},
+                   {"overflows", overflows}, {"churns", churns}}},
+        {"aggregator", {{"batches", as.batches.load()}, {"entries", as.entries.load()}, {"duplicates", as.duplicates.load()},
+                        {"batch_gaps", as.batch_gaps.load()}, {"corrupt", as.corrupt.load()}, {"bytes", as.wire_bytes.load()}}}};
+
+    if (opt.as_json) {
+        std::printf("%s\n", out.dump(2).c_str());
+        return 0;
+    }
+    std::printf("hubs          %d x %d cameras x %.1f/s + PLC %.0f Hz for %.1f s (flush %d ms)\n", opt.hubs, opt.cameras,
+                opt.rate, opt.plc_hz, send_seconds, opt.flush_ms);
+    std::printf("delivered     %llu / %llu barcodes (%.2f%%)\n", (unsigned long long)received,
+                (unsigned long long)total_sent, delivery);
+    std::printf("latency       p50=%.0f us p90=%.0f us p99=%.0f us p99.9=%.0f us max=%llu us\n", lat.percentile(50),
+                lat.percentile(90), lat.percentile(99), lat.percentile(99.9), (unsigned long long)lat.max());
+    std::printf("ordering      duplicates=%llu snapshot_replays=%llu out_of_order=%llu misrouted=%llu corrupt=%llu\n",
+                (unsigned long long)sink_stats["duplicates"], (unsigned long long)sink_stats["snapshot_replays"],
+                (unsigned long long)sink_stats["out_of_order"], (unsigned long long)sink_stats["misrouted"],
+                (unsigned long long)sink_stats["corrupt"]);
+    std::printf("relay         batches=%llu entries=%llu conflated=%llu raw=%llu B wire=%llu B (%.1fx)\n",
+                (unsigned long long)batches, (unsigned long long)entries, (unsigned long long)conflated,
+                (unsigned long long)raw, (unsigned long long)wire, wire ? (double)raw / (double)wire : 0.0);
+    std::printf("sync          connects=%llu churns=%llu snapshots=%llu resumes=%llu overflows=%llu\n",
+                (unsigned long long)connects, (unsigned long long)churns, (unsigned long long)snapshots,
+                (unsigned long long)resumes, (unsigned long long)overflows);
+    std::printf("aggregator    batches=%llu entries=%llu duplicates=%llu batch_gaps=%llu corrupt=%llu\n",
+                (unsigned long long)as.batches.load(), (unsigned long long)as.entries.load(),
+                (unsigned long long)as.duplicates.load(), (unsigned long long)as.batch_gaps.load(),
+                (unsigned long long)as.corrupt.load());
+    return 0;
+}
\ No newline at end of file
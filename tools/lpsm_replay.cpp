@@ -0,0 +1,167 @@
+// Bus 擷取重播 (LPSM_CAPTURE_DIR 錄下的 *.lcap)
+// 依序把每則訊息餵給 Controller::process，PLC / WS 改接 Stub：
+//   - PLC 寫入立即以 OK 回呼，並記錄寫入序列
+//   - WS 推播只做 JSON 編碼並累計雜湊 (同一份擷取重播多次應得到相同 digest)
+// 預設盡快重播 (吞吐量回歸測試)；--pace 依原始 Controller 取出時間間隔重播 (--speed 調整倍率)
+//
+//   lpsm_replay [--pace] [--speed 2.0] [--loops N] [--json] <capture.lcap>...
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/Capture.hpp"
+#include "logic/Controller.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// FNV-1a：依序累計，順序或內容不同都會改變結果
+struct Digest {
+    uint64_t value = 1469598103934665603ULL;
+    void add(const std::string& s) {
+        for (unsigned char c : s) { value ^= c; value *= 1099511628211ULL; }
+        value ^= 0xFF; value *= 1099511628211ULL; // 分隔
+    }
+};
+
+class StubPlc : public PlcSink {
+public:
+    uint64_t writes = 0;
+    uint64_t resets = 0;
+    Digest digest;
+
+    void reset_safe_signals() override {
+        ++resets;
+        digest.add("RESET");
+    }
+
+    void write_pulse_pair(int addr1, bool val1, int addr2, bool val2, uint64_t, WriteCallback on_done) override {
+        ++writes;
+        digest.add("W" + std::to_string(addr1) + "=" + std::to_string(val1) + "," + std::to_string(addr2) + "=" + std::to_string(val2));
+        if (on_done) on_done({PlcWriteResult::OK});
+    }
+};
+
+class StubWs : public WsSink {
+public:
+    uint64_t published = 0;
+    uint64_t bytes = 0;
+    uint64_t acks = 0;
+    Digest digest;
+
+    void publish(std::string topic, WsFrame frame, const TraceStamps&, Delivery) override {
+        ++published;
+        // 時間戳 (ts_us) 只在二進位格式，文字內容可重現
+        const std::string& text = frame.text();
+        bytes += text.size();
+        digest.add(topic);
+        digest.add(text);
+    }
+
+    void complete_request(std::string request_id, json result) override {
+        ++acks;
+        digest.add("ACK " + request_id + " " + result.dump());
+    }
+};
+
+struct Options {
+    bool pace = false;
+    double speed = 1.0;
+    int loops = 1;
+    bool as_json = false;
+    std::vector<std::string> files;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--pace") == 0) opt.pace = true;
+        else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) opt.speed = std::max(0.01, std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--loops") == 0 && i + 1 < argc) opt.loops = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--json") == 0) opt.as_json = true;
+        else opt.files.push_back(argv[i]);
+    }
+    if (opt.files.empty()) {
+        std::fprintf(stderr, "usage: lpsm_replay [--pace] [--speed 2.0] [--loops N] [--json] <capture.lcap>...\n");
+        return 2;
+    }
+    std::sort(opt.files.begin(), opt.files.end()); // 分段檔名含時間
+    spdlog::set_level(spdlog::level::warn);        // 重播時不輸出每筆 info Log
+
+    // 先全部讀進記憶體，量測時不含檔案 I/O 與 CBOR 解碼
+    std::vector<CaptureReader::Event> events;
+    for (const auto& path : opt.files) {
+        CaptureReader reader;
+        if (!reader.open(path)) {
+            std::fprintf(stderr, "cannot read capture %s\n", path.c_str());
+            return 1;
+        }
+        CaptureReader::Event ev;
+        while (reader.next(ev)) events.push_back(ev);
+        if (reader.truncated()) std::fprintf(stderr, "%s: last record incomplete, ignored\n", path.c_str());
+    }
+
+    auto plc = std::make_shared<StubPlc>();
+    auto ws = std::make_shared<StubWs>();
+    auto bus = std::make_shared<MessageBus>(); // Controller 建構需要，重播不經過 Bus
+    std::string cache_file = "replay_offline_data.json"; // 離線快取指令寫到獨立檔案
+    std::remove(cache_file.c_str());
+    Controller controller(bus, plc, ws, cache_file);
+
+    uint64_t messages = 0;
+    auto begin = Clock::now();
+    for (int loop = 0; loop < opt.loops; ++loop) {
+        uint64_t first_deq = 0;
+        auto loop_begin = Clock::now();
+        for (const auto& ev : events) {
+            if (ev.kind == CaptureReader::Kind::CONFIG) {
+                Config::publish(ev.config);
+                continue;
+            }
+            Message msg = ev.msg;
+            if (opt.pace) {
+                if (first_deq == 0) first_deq = msg.trace.deq;
+                auto offset = std::chrono::nanoseconds((uint64_t)((double)(msg.trace.deq - first_deq) / opt.speed));
+                std::this_thread::sleep_until(loop_begin + offset);
+            }
+            // 時間戳改為本次重播的時間，延遲統計才有意義
+            uint64_t now = trace_now_ns();
+            msg.trace = TraceStamps{now, now, now, 0};
+            controller.process(msg);
+            ++messages;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::remove(cache_file.c_str());
+
+    char plc_digest[20], ws_digest[20];
+    std::snprintf(plc_digest, sizeof(plc_digest), "%016llx", (unsigned long long)plc->digest.value);
+    std::snprintf(ws_digest, sizeof(ws_digest), "%016llx", (unsigned long long)ws->digest.value);
+    double rate = seconds > 0 ? messages / seconds : 0.0;
+    auto& controller_hist = Latency::stage(Stage::CONTROLLER);
+
+    if (opt.as_json) {
+        json out = {{"messages", messages}, {"seconds", seconds}, {"msgs_per_s", rate},
+                    {"controller_p50_us", controller_hist.percentile(50)}, {"controller_p99_us", controller_hist.percentile(99)},
+                    {"plc_writes", plc->writes}, {"plc_resets", plc->resets},
+                    {"ws_published", ws->published}, {"ws_bytes", ws->bytes}, {"ws_acks", ws->acks},
+                    {"plc_digest", plc_digest}, {"ws_digest", ws_digest}};
+        std::printf("%s\n", out.dump(2).c_str());
+        return 0;
+    }
+
+    std::printf("messages      %llu in %.3f s (%.0f msg/s)%s\n", (unsigned long long)messages, seconds, rate,
+                opt.pace ? " [paced]" : "");
+    std::printf("controller    p50=%.0f us p99=%.0f us\n", controller_hist.percentile(50), controller_hist.percentile(99));
+    std::printf("plc           writes=%llu resets=%llu digest=%s\n", (unsigned long long)plc->writes,
+                (unsigned long long)plc->resets, plc_digest);
+    std::printf("ws            published=%llu bytes=%llu acks=%llu digest=%s\n", (unsigned long long)ws->published,
+                (unsigned long long)ws->bytes, (unsigned long long)ws->acks, ws_digest);
+    return 0;
+}
\ No newline at end of file